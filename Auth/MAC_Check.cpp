@@ -105,9 +105,24 @@ void MAC_Check<T>::GetValues(vector<T>& values)
 }
 
 
+template<class T>
+void MAC_Check<T>::PackOpened()
+{
+  for (int i = 0; i < popen_cnt; i++)
+    {
+      check_macs.push_back(macs[i]);
+      check_vals.push_back(vals[i]);
+    }
+  macs.erase(macs.begin(), macs.begin() + popen_cnt);
+  vals.erase(vals.begin(), vals.begin() + popen_cnt);
+  popen_cnt = 0;
+}
+
+
 template<class T>
 void MAC_Check<T>::CheckIfNeeded(const Player& P)
 {
+  PackOpened();
   if (WaitingForCheck() >= POPEN_MAX)
     Check(P);
 }
@@ -116,9 +131,8 @@ void MAC_Check<T>::CheckIfNeeded(const Player& P)
 template <class T>
 void MAC_Check<T>::AddToCheck(const T& mac, const T& value, const Player& P)
 {
-  macs.push_back(mac);
-  vals.push_back(value);
-  popen_cnt++;
+  check_macs.push_back(mac);
+  check_vals.push_back(value);
   CheckIfNeeded(P);
 }
 
@@ -131,6 +145,16 @@ void MAC_Check<T>::Check(const Player& P)
     return;
 
   //cerr << "In MAC Check : " << popen_cnt << endl;
+  PackOpened();
+  CheckValues(check_macs, check_vals, P);
+  check_macs.clear();
+  check_vals.clear();
+}
+
+template<class T>
+void MAC_Check<T>::CheckValues(PackedStore<T>& macs, PackedStore<T>& vals,
+    const Player& P)
+{
   octet seed[SEED_SIZE];
   this->timers[SEED].start();
   Create_Random_Seed(seed,P,SEED_SIZE);
@@ -143,16 +167,18 @@ void MAC_Check<T>::Check(const Player& P)
   a.assign_zero();
   gami.assign_zero();
   vector<T> tau(P.num_players());
-  for (int i=0; i<popen_cnt; i++)
+  PackedReader<T> mac_reader(macs), val_reader(vals);
+  T mac, val;
+  for (long long i=0; i<vals.size(); i++)
     { h.almost_randomize(G);
-      temp.mul(h,vals[i]);
+      val_reader.get(val);
+      temp.mul(h,val);
       a.add(a,temp);
       
-      temp.mul(h,macs[i]);
+      mac_reader.get(mac);
+      temp.mul(h,mac);
       gami.add(gami,temp);
     }
-  vals.erase(vals.begin(), vals.begin() + popen_cnt);
-  macs.erase(macs.begin(), macs.begin() + popen_cnt);
   temp.mul(alphai,a);
   tau[P.my_num()].sub(gami,temp);
 
@@ -168,8 +194,6 @@ void MAC_Check<T>::Check(const Player& P)
   for (int i=0; i<P.num_players(); i++)
     { t.add(t,tau[i]); }
   if (!t.is_zero()) { throw mac_fail(); }
-
-  popen_cnt=0;
 }
 
 template<class T>
@@ -194,6 +218,110 @@ void Separate_MAC_Check<T>::Check(const Player& P)
 }
 
 
+template<class T>
+void* run_background_check_thread(void* MC)
+{
+  ((Background_MAC_Check<T>*) MC)->run();
+  return 0;
+}
+
+template<class T>
+Background_MAC_Check<T>::Background_MAC_Check(const T& ai, Names& Nms,
+    int thread_num, int batch_size, int max_pending, int opening_sum,
+    int max_broadcast) :
+    Separate_MAC_Check<T>(ai, Nms, thread_num, opening_sum, max_broadcast),
+    batch_size(batch_size), max_pending(max(max_pending, batch_size)),
+    pending(0), failed(false)
+{
+  pthread_create(&thread, 0, run_background_check_thread<T>, this);
+}
+
+template<class T>
+Background_MAC_Check<T>::~Background_MAC_Check()
+{
+  // stopping the queue drops anything not checked yet
+  WaitForPending(0);
+  batches.stop();
+  pthread_join(thread, 0);
+}
+
+template<class T>
+void Background_MAC_Check<T>::CheckIfNeeded(const Player& P)
+{
+  (void)P;
+  this->PackOpened();
+  if (this->check_vals.size() >= batch_size)
+    HandOff();
+}
+
+template<class T>
+void Background_MAC_Check<T>::HandOff()
+{
+  this->PackOpened();
+  int n = this->check_vals.size();
+  if (n == 0)
+    return;
+
+  Batch* batch = new Batch;
+  batch->macs.swap(this->check_macs);
+  batch->vals.swap(this->check_vals);
+
+  if (WaitForPending(max_pending - n))
+    {
+      delete batch;
+      throw mac_fail();
+    }
+  signal.lock();
+  pending += n;
+  signal.unlock();
+  batches.push(batch);
+}
+
+template<class T>
+bool Background_MAC_Check<T>::WaitForPending(int limit)
+{
+  signal.lock();
+  while (pending > max(limit, 0))
+    signal.wait();
+  bool res = failed;
+  signal.unlock();
+  return res;
+}
+
+template<class T>
+void Background_MAC_Check<T>::Check(const Player& P)
+{
+  (void)P;
+  HandOff();
+  if (WaitForPending(0))
+    throw mac_fail();
+}
+
+template<class T>
+void Background_MAC_Check<T>::run()
+{
+  Batch* batch = 0;
+  while (batches.pop(batch))
+    {
+      bool res = false;
+      try
+        {
+          this->CheckValues(batch->macs, batch->vals, this->check_player);
+        }
+      catch (mac_fail&)
+        {
+          res = true;
+        }
+      signal.lock();
+      pending -= batch->vals.size();
+      failed |= res;
+      signal.broadcast();
+      signal.unlock();
+      delete batch;
+    }
+}
+
+
 template<class T>
 void* run_summer_thread(void* summer)
 {
@@ -318,6 +446,7 @@ void Direct_MAC_Check<T>::POpen_Begin(vector<T>& values,const vector<Share<T> >&
 {
   values.resize(S.size());
   this->os.reset_write_head();
+  this->os.reserve(S.size() * T::size());
   for (unsigned int i=0; i<S.size(); i++)
     S[i].get_share().pack(this->os);
   this->timers[SEND].start();
@@ -376,13 +505,14 @@ template<class T, int t>
 void passing_add_openings(vector<T>& values, octetStream& os)
 {
   octetStream new_os;
+  new_os.reserve(values.size() * T::size());
   for (unsigned int i=0; i<values.size(); i++)
     {
       T tmp;
       tmp.unpack(os);
       (tmp + values[i]).pack(new_os);
     }
-  os = new_os;
+  os.swap(new_os);
 }
 
 template<class T>
@@ -390,6 +520,7 @@ void Passing_MAC_Check<T>::POpen_Begin(vector<T>& values,const vector<Share<T> >
 {
   values.resize(S.size());
   this->os.reset_write_head();
+  this->os.reserve(S.size() * T::size());
   for (unsigned int i=0; i<S.size(); i++)
     {
       S[i].get_share().pack(this->os);
@@ -427,15 +558,18 @@ template class MAC_Check<gfp>;
 template class Direct_MAC_Check<gfp>;
 template class Parallel_MAC_Check<gfp>;
 template class Passing_MAC_Check<gfp>;
+template class Background_MAC_Check<gfp>;
 
 template class MAC_Check<gf2n>;
 template class Direct_MAC_Check<gf2n>;
 template class Parallel_MAC_Check<gf2n>;
 template class Passing_MAC_Check<gf2n>;
+template class Background_MAC_Check<gf2n>;
 
 #ifdef USE_GF2N_LONG
 template class MAC_Check<gf2n_short>;
 template class Direct_MAC_Check<gf2n_short>;
 template class Parallel_MAC_Check<gf2n_short>;
 template class Passing_MAC_Check<gf2n_short>;
+template class Background_MAC_Check<gf2n_short>;
 #endif
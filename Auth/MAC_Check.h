@@ -13,7 +13,9 @@ using namespace std;
 #include "Networking/Player.h"
 #include "Networking/ServerSocket.h"
 #include "Auth/Summer.h"
+#include "Auth/PackedStore.h"
 #include "Tools/time-func.h"
+#include "Tools/Signal.h"
 
 
 /* The MAX number of things we will partially open before running
@@ -67,15 +69,25 @@ class MAC_Check : public TreeSum<T>
   vector<T> macs;
   vector<T> vals;
 
+  /* Completed openings waiting for the check */
+  PackedStore<T> check_macs;
+  PackedStore<T> check_vals;
+
   /* MAC Share */
   T alphai;
 
   void AddToMacs(const vector< Share<T> >& shares);
   void AddToValues(vector<T>& values);
   void GetValues(vector<T>& values);
-  void CheckIfNeeded(const Player& P);
-  int WaitingForCheck()
-    { return max(macs.size(), vals.size()); }
+  // Moves completed openings to the packed store
+  void PackOpened();
+  virtual void CheckIfNeeded(const Player& P);
+  long long WaitingForCheck()
+    { return check_vals.size() + max(macs.size(), vals.size()); }
+
+  // Random linear combination and commit-open over all entries
+  void CheckValues(PackedStore<T>& macs, PackedStore<T>& vals,
+      const Player& P);
 
   public:
 
@@ -109,10 +121,10 @@ template<class T, int t>
 template<class T>
 class Separate_MAC_Check: public MAC_Check<T>
 {
+protected:
   // Different channel for checks
   Player check_player;
 
-protected:
   // No sense to expose this
   Separate_MAC_Check(const T& ai, Names& Nms, int thread_num, int opening_sum=10, int max_broadcast=10, int send_player=0);
   virtual ~Separate_MAC_Check() {};
@@ -147,6 +159,47 @@ public:
 };
 
 
+/*
+ * Hands completed batches of openings to a background thread, which
+ * checks them on its own channel in the order they were completed.
+ * The online thread only waits when more than max_pending values are
+ * waiting for the check and in Check(), which drains the queue.
+ * A failure is reported by the next call after it has been found.
+ */
+template<class T>
+class Background_MAC_Check: public Separate_MAC_Check<T>
+{
+  struct Batch
+  {
+    PackedStore<T> macs, vals;
+  };
+
+  int batch_size, max_pending;
+
+  pthread_t thread;
+  WaitQueue<Batch*> batches;
+
+  // Protects pending and failed
+  Signal signal;
+  int pending;
+  bool failed;
+
+  void HandOff();
+  // Returns whether a check has failed
+  bool WaitForPending(int limit);
+  void CheckIfNeeded(const Player& P);
+
+public:
+  Background_MAC_Check(const T& ai, Names& Nms, int thread_num,
+      int batch_size, int max_pending, int opening_sum=10, int max_broadcast=10);
+  ~Background_MAC_Check();
+
+  void Check(const Player& P);
+
+  void run();
+};
+
+
 template<class T>
 class Direct_MAC_Check: public Separate_MAC_Check<T>
 {
@@ -269,8 +322,7 @@ void TreeSum<T>::start(vector<T>& values, const Player& P)
         break;
       if (my_relative_num >= sum_players && my_relative_num < last_sum_players)
         {
-          for (unsigned int i=0; i<values.size(); i++)
-            { values[i].pack(os); }
+          os.pack(values);
           int receiver = positive_modulo(base_player + my_relative_num % sum_players, P.num_players());
           timers[SEND].start();
           P.send_to(receiver,os,true);
@@ -291,8 +343,7 @@ void TreeSum<T>::start(vector<T>& values, const Player& P)
   if (P.my_num() == base_player)
     {
       os.reset_write_head();
-      for (unsigned int i=0; i<values.size(); i++)
-        { values[i].pack(os); }
+      os.pack(values);
       timers[BCAST].start();
       for (int i = 1; i < max_broadcast && i < P.num_players(); i++)
         {
@@ -338,8 +389,7 @@ void TreeSum<T>::ReceiveValues(vector<T>& values, const Player& P, int sender)
   timers[RECV_SUM].start();
   P.receive_player(sender, os, true);
   timers[RECV_SUM].stop();
-  for (unsigned int i = 0; i < values.size(); i++)
-    values[i].unpack(os);
+  os.unpack(values);
   AddToValues(values);
 }
 
@@ -0,0 +1,135 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * PackedStore.cpp
+ *
+ */
+
+#include "Auth/PackedStore.h"
+#include "Exceptions/Exceptions.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+
+size_t PackedSegments::max_memory = 0;
+
+void PackedSegments::set_max_memory(size_t bytes)
+{
+  // the segment being filled always stays in memory
+  if (bytes and bytes < SEGMENT_SIZE)
+    {
+      cerr << "Warning: raising the memory limit for the MAC check to "
+          << SEGMENT_SIZE << " bytes per store" << endl;
+      bytes = SEGMENT_SIZE;
+    }
+  max_memory = bytes;
+}
+
+PackedSegments::PackedSegments() :
+    in_memory(0), spill_fd(-1), spill_end(0), read_segment(0), read_pos(0),
+    n_entries(0), packed(max_memory != 0)
+{
+}
+
+PackedSegments::~PackedSegments()
+{
+  if (spill_fd >= 0)
+    close(spill_fd);
+}
+
+void PackedSegments::seal()
+{
+  segments.push_back({});
+  segments.back().swap(current);
+  in_memory += segments.back().get_length();
+  while (max_memory and in_memory > max_memory and not segments.empty())
+    spill();
+}
+
+void PackedSegments::spill()
+{
+  if (spill_fd < 0)
+    {
+      const char* dir = getenv("TMPDIR");
+      string name = string(dir ? dir : "/tmp") + "/spdz-mac-check-XXXXXX";
+      spill_fd = mkstemp(&name[0]);
+      if (spill_fd < 0)
+        throw file_error(name);
+      // only needed while open
+      unlink(name.c_str());
+    }
+
+  octetStream& segment = segments.front();
+  size_t length = segment.get_length();
+  if (pwrite(spill_fd, segment.get_data(), length, spill_end) != (ssize_t)length)
+    throw file_error("spilling MAC check data");
+  spill_end += length;
+  spilled.push_back(length);
+  in_memory -= length;
+  segments.pop_front();
+}
+
+void PackedSegments::clear()
+{
+  segments.clear();
+  in_memory = 0;
+  spilled.clear();
+  if (spill_fd >= 0 and ftruncate(spill_fd, 0) != 0)
+    throw file_error("spilled MAC check data");
+  spill_end = 0;
+  current.reset_write_head();
+  read_buffer.clear();
+  file_buffer.clear();
+  file_buffer.shrink_to_fit();
+  n_entries = 0;
+}
+
+void PackedSegments::swap(PackedSegments& other)
+{
+  std::swap(segments, other.segments);
+  std::swap(in_memory, other.in_memory);
+  std::swap(spilled, other.spilled);
+  std::swap(spill_fd, other.spill_fd);
+  std::swap(spill_end, other.spill_end);
+  std::swap(read_segment, other.read_segment);
+  std::swap(read_pos, other.read_pos);
+  read_buffer.swap(other.read_buffer);
+  file_buffer.swap(other.file_buffer);
+  current.swap(other.current);
+  std::swap(n_entries, other.n_entries);
+  std::swap(packed, other.packed);
+}
+
+void PackedSegments::start_reading()
+{
+  read_segment = 0;
+  read_pos = 0;
+  for (auto& segment : segments)
+    segment.reset_read_head();
+  current.reset_read_head();
+}
+
+octetStream* PackedSegments::next_segment()
+{
+  size_t i = read_segment++;
+  if (i < spilled.size())
+    {
+      size_t length = spilled[i];
+      file_buffer.resize(length);
+      if (pread(spill_fd, file_buffer.data(), length, read_pos)
+          != (ssize_t)length)
+        throw file_error("spilled MAC check data");
+      read_pos += length;
+      read_buffer.reset_write_head();
+      read_buffer.append(file_buffer.data(), length);
+      return &read_buffer;
+    }
+  i -= spilled.size();
+  if (i < segments.size())
+    return &segments[i];
+  else if (i == segments.size())
+    return &current;
+  else
+    return 0;
+}
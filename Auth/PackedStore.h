@@ -0,0 +1,151 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * PackedStore.h
+ *
+ */
+
+#ifndef AUTH_PACKEDSTORE_H_
+#define AUTH_PACKEDSTORE_H_
+
+#include "Tools/octetStream.h"
+
+#include <deque>
+#include <vector>
+#include <string>
+using namespace std;
+
+/*
+ * Append-only store for values waiting for the MAC check. With a memory
+ * limit, values are packed to T::size() bytes each and collected in
+ * segments, and the oldest sealed segments are written to an unlinked
+ * temporary file once more than the limit is held. Reading streams all
+ * segments back in the order they were added. Without a limit, values
+ * are kept as they are.
+ */
+
+class PackedSegments
+{
+  static size_t max_memory;
+
+  deque<octetStream> segments;
+  size_t in_memory;
+
+  // sizes of the segments in the spill file
+  deque<size_t> spilled;
+  int spill_fd;
+  long long spill_end;
+
+  size_t read_segment;
+  long long read_pos;
+  octetStream read_buffer;
+  vector<octet> file_buffer;
+
+  PackedSegments(const PackedSegments&);
+  PackedSegments& operator=(const PackedSegments&);
+
+  void seal();
+  void spill();
+
+protected:
+  static const size_t SEGMENT_SIZE = 1 << 20;
+
+  octetStream current;
+  long long n_entries;
+  // set from the memory limit at construction
+  bool packed;
+
+  void added()
+    {
+      n_entries++;
+      if (current.get_length() >= SEGMENT_SIZE)
+        seal();
+    }
+
+public:
+  // 0 for no limit, applies to every store created afterwards
+  static void set_max_memory(size_t bytes);
+
+  PackedSegments();
+  ~PackedSegments();
+
+  long long size() const { return n_entries; }
+  bool is_packed() const { return packed; }
+  // bytes held in memory, without the read buffer
+  size_t memory_usage() const { return in_memory + current.get_length(); }
+  long long spilled_bytes() const { return spill_end; }
+
+  void clear();
+  void swap(PackedSegments& other);
+
+  // Segments in order, 0 at the end
+  void start_reading();
+  octetStream* next_segment();
+};
+
+template<class T>
+class PackedStore : public PackedSegments
+{
+  vector<T> values;
+
+public:
+  void push_back(const T& x)
+    {
+      if (packed)
+        {
+          x.pack(current);
+          added();
+        }
+      else
+        {
+          values.push_back(x);
+          n_entries++;
+        }
+    }
+
+  // only without packing
+  const T& operator[](long long i) const { return values[i]; }
+
+  void clear()
+    {
+      PackedSegments::clear();
+      values.clear();
+    }
+  void swap(PackedStore<T>& other)
+    {
+      PackedSegments::swap(other);
+      values.swap(other.values);
+    }
+};
+
+/*
+ * Reads a store value by value.
+ */
+template<class T>
+class PackedReader
+{
+  PackedStore<T>& store;
+  octetStream* segment;
+  long long index;
+
+public:
+  PackedReader(PackedStore<T>& store) : store(store), index(0)
+    {
+      store.start_reading();
+      segment = store.next_segment();
+    }
+
+  void get(T& x)
+    {
+      if (not store.is_packed())
+        {
+          x = store[index++];
+          return;
+        }
+      while (segment->done())
+        segment = store.next_segment();
+      x.unpack(*segment);
+    }
+};
+
+#endif /* AUTH_PACKEDSTORE_H_ */
@@ -10,6 +10,7 @@
 #include "Math/Share.h"
 #include "Auth/fake-stuff.h"
 #include "Tools/ezOptionParser.h"
+#include "Tools/PrepFile.h"
 #include "Exceptions/Exceptions.h"
 
 #include "Math/Setup.h"
@@ -178,6 +179,31 @@ void check_inputs(const T& key,int N,vector<Data_Files*>& dataF)
   }
 }
 
+bool check_checksums(int N)
+{
+  bool ok = true;
+  for (int field_type = 0; field_type < N_DATA_FIELD_TYPE; field_type++)
+    for (int dtype = 0; dtype < N_DTYPE; dtype++)
+      if (Data_Files::implemented[field_type][dtype])
+        for (int i = 0; i < N; i++)
+          {
+            stringstream filename;
+            filename << PREP_DATA_PREFIX << Data_Files::dtype_names[dtype]
+                << "-" << Data_Files::field_names[field_type] << "-P" << i;
+            try
+              {
+                if (PrepFileHeader::verify(filename.str()))
+                  cout << "Checksum of " << filename.str() << " OK" << endl;
+              }
+            catch (exception& e)
+              {
+                cout << e.what() << endl;
+                ok = false;
+              }
+          }
+  return ok;
+}
+
 int main(int argc, const char** argv)
 {
   ez::ezOptionParser opt;
@@ -282,6 +308,8 @@ int main(int argc, const char** argv)
   cout << "--------------\n";
   cout << "Final Keys :\t p: " << keyp << "\n\t\t 2: " << key2 << endl;
 
+  bool checksums_ok = check_checksums(N);
+
   vector<Data_Files*> dataF(N);
   for (int i = 0; i < N; i++)
     dataF[i] = new Data_Files(i, N, PREP_DATA_PREFIX);
@@ -297,4 +325,10 @@ int main(int argc, const char** argv)
   check_tuples(keyp, N, dataF, DATA_INVERSE);
   for (int i = 0; i < N; i++)
     delete dataF[i];
+
+  if (not checksums_ok)
+    {
+      cerr << "Some files failed the checksum test" << endl;
+      return 1;
+    }
 }
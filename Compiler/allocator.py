@@ -583,6 +583,9 @@ class Merger:
                 keep_order(instr, n, instr.args[0])
             elif isinstance(instr, StackInstruction):
                 keep_order(instr, n, StackInstruction)
+            elif isinstance(instr, (e_startmult_class, e_stopmult_class)):
+                # a stop collects the oldest pending start
+                keep_order(instr, n, e_startmult_class)
 
             if not G.pred[n]:
                 self.sources.append(n)
@@ -1316,6 +1316,21 @@ class e_mult(base.VarArgsInstruction):
     code = base.opcodes['E_MULT']
     arg_format = tools.cycle(['sw', 's', 's'])
 
+@base.vectorize
+class e_startmult(base.VarArgsInstruction):
+    """ Start mult of secret register pairs $s_j, s_k$ without waiting. """
+    __slots__ = []
+    code = base.opcodes['E_STARTMULT']
+    arg_format = tools.cycle(['s', 's'])
+
+@base.vectorize
+class e_stopmult(base.VarArgsInstruction, base.DoNotEliminateInstruction):
+    """ Wait for the oldest started mult not stopped yet (FIFO) and store
+    the products in $s_i$. Starts and stops are kept in program order. """
+    __slots__ = []
+    code = base.opcodes['E_STOPMULT']
+    arg_format = tools.cycle(['sw'])
+
 ##
 ## 2G END
 ##
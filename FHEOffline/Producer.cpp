@@ -250,6 +250,12 @@ string Producer<FD>::open_file(ofstream& outf, int my_num, int thread_num,
         clear, dir);
 }
 
+template<class FD>
+string Producer<FD>::output_filename(int my_num)
+{
+    return prep_filename<T>(data_type(), my_num, output_thread, false, dir);
+}
+
 template <class FD>
 void Producer<FD>::clear_file(int my_num, int thread_num, bool initial)
 {
@@ -566,6 +572,9 @@ void gf2nBitProducer::run(const Player& P, const FHE_PK& pk,
         if (write_output)
             a.output(outf, false);
     }
+    // make it visible to a streaming consumer
+    if (write_output)
+        outf.flush();
 }
 
 template <class FD>
@@ -46,6 +46,8 @@ public:
   virtual string open_file(ofstream& outf, int my_num, int thread_num, bool initial,
       bool clear);
   virtual void clear_file(int my_num, int thread_num = 0, bool initial = true);
+  // File holding the checked output
+  string output_filename(int my_num);
 
   virtual void run(const Player& P, const FHE_PK& pk,
       const Ciphertext& calpha, EncCommitBase<T, FD, S>& EC,
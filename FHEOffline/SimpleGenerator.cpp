@@ -9,6 +9,7 @@
 #include "FHEOffline/SimpleMachine.h"
 #include "FHEOffline/Sacrificing.h"
 #include "Auth/MAC_Check.h"
+#include "Tools/PrepStream.h"
 
 template <template <class> class T, class FD>
 SimpleGenerator<T,FD>::SimpleGenerator(const Names& N, const PartSetup<FD>& setup,
@@ -58,13 +59,26 @@ void SimpleGenerator<T,FD>::run()
     timers["MC init"].start();
     MAC_Check<typename FD::T> MC(setup.alphai);
     timers["MC init"].stop();
+    // inputs go to one file per player, so they are not streamed
+    PrepStreamWriter stream;
+    if (machine.output and machine.stream_ahead and not machine.produce_inputs)
+        stream.open(producer->output_filename(P.my_num()), machine.stream_ahead);
     while (total < machine.nTriplesPerThread)
     {
         producer->run(P, setup.pk, setup.calpha, EC, dd, setup.alphai);
         producer->sacrifice(P, MC);
         total += producer->num_slots();
+        if (stream.is_open())
+        {
+            // the consumer might use the output straight away
+            MC.Check(P);
+            timers["Streaming"].start();
+            stream.wait();
+            timers["Streaming"].stop();
+        }
     }
     MC.Check(P);
+    stream.finish();
     timer.stop();
     timers["Thread"] = timer;
     timers.insert(producer->timers.begin(), producer->timers.end());
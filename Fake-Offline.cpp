@@ -13,6 +13,7 @@
 #include "Tools/mkpath.h"
 #include "Tools/ezOptionParser.h"
 #include "Tools/benchmarking.h"
+#include "Tools/PrepFile.h"
 
 #include <sstream>
 #include <fstream>
@@ -21,6 +22,22 @@ using namespace std;
 
 string prep_data_prefix;
 
+// MAC key shares of all players for the headers
+vector<gfp> key_shares_p;
+vector<gf2n> key_shares_2;
+
+const gfp& key_share(const gfp&, int player) { return key_shares_p.at(player); }
+const gf2n& key_share(const gf2n&, int player) { return key_shares_2.at(player); }
+
+/* Opens the file of player i for tuples of tuple_size shares */
+template<class T>
+void open_prep_file(PrepFileWriter& outf,const string& filename,int i,int tuple_size)
+{
+  cout << "Opening " << filename << endl;
+  uint64_t mac_key_id = PrepFileHeader::get_mac_key_id(key_share(T(), i));
+  outf.open(filename, PrepFileHeader::create<T>(tuple_size * Share<T>::size(), mac_key_id));
+}
+
 /* N      = Number players
  * ntrip  = Number triples needed
  * str    = "2" or "p"
@@ -31,16 +48,14 @@ void make_mult_triples(const T& key,int N,int ntrip,const string& str,bool zero)
   PRNG G;
   G.ReSeed();
 
-  ofstream* outf=new ofstream[N];
+  PrepFileWriter* outf=new PrepFileWriter[N];
   T a,b,c;
   vector<Share<T> > Sa(N),Sb(N),Sc(N);
   /* Generate Triples */
   for (int i=0; i<N; i++)
     { stringstream filename;
       filename << prep_data_prefix << "Triples-" << str << "-P" << i;
-      cout << "Opening " << filename.str() << endl;
-      outf[i].open(filename.str().c_str(),ios::out | ios::binary);
-      if (outf[i].fail()) { throw file_error(filename.str().c_str()); }
+      open_prep_file<T>(outf[i], filename.str(), i, 3);
     }
   for (int i=0; i<ntrip; i++)
     {
@@ -53,9 +68,9 @@ void make_mult_triples(const T& key,int N,int ntrip,const string& str,bool zero)
       c.mul(a,b);
       make_share(Sc,c,N,key,G);
       for (int j=0; j<N; j++)
-        { Sa[j].output(outf[j],false);
-          Sb[j].output(outf[j],false);
-          Sc[j].output(outf[j],false);
+        { outf[j].write(Sa[j]);
+          outf[j].write(Sb[j]);
+          outf[j].write(Sc[j]);
         }
     }
   for (int i=0; i<N; i++)
@@ -68,7 +83,7 @@ void make_bit_triples(const gf2n& key,int N,int ntrip,Dtype dtype,bool zero)
   PRNG G;
   G.ReSeed();
 
-  ofstream* outf=new ofstream[N];
+  PrepFileWriter* outf=new PrepFileWriter[N];
   gf2n a,b,c, one;
   one.assign_one();
   vector<Share<gf2n> > Sa(N),Sb(N),Sc(N);
@@ -76,9 +91,7 @@ void make_bit_triples(const gf2n& key,int N,int ntrip,Dtype dtype,bool zero)
   for (int i=0; i<N; i++)
     { stringstream filename;
       filename << prep_data_prefix << Data_Files::dtype_names[dtype] << "-2-P" << i;
-      cout << "Opening " << filename.str() << endl;
-      outf[i].open(filename.str().c_str(),ios::out | ios::binary);
-      if (outf[i].fail()) { throw file_error(filename.str().c_str()); }
+      open_prep_file<gf2n>(outf[i], filename.str(), i, 3);
     }
   for (int i=0; i<ntrip; i++)
     {
@@ -94,9 +107,9 @@ void make_bit_triples(const gf2n& key,int N,int ntrip,Dtype dtype,bool zero)
       c.mul(a,b);
       make_share(Sc,c,N,key,G);
       for (int j=0; j<N; j++)
-        { Sa[j].output(outf[j],false);
-          Sb[j].output(outf[j],false);
-          Sc[j].output(outf[j],false);
+        { outf[j].write(Sa[j]);
+          outf[j].write(Sb[j]);
+          outf[j].write(Sc[j]);
         }
     }
   for (int i=0; i<N; i++)
@@ -115,16 +128,14 @@ void make_square_tuples(const T& key,int N,int ntrip,const string& str,bool zero
   PRNG G;
   G.ReSeed();
 
-  ofstream* outf=new ofstream[N];
+  PrepFileWriter* outf=new PrepFileWriter[N];
   T a,c;
   vector<Share<T> > Sa(N),Sc(N);
   /* Generate Squares */
   for (int i=0; i<N; i++)
     { stringstream filename;
       filename << prep_data_prefix << "Squares-" << str << "-P" << i;
-      cout << "Opening " << filename.str() << endl;
-      outf[i].open(filename.str().c_str(),ios::out | ios::binary);
-      if (outf[i].fail()) { throw file_error(filename.str().c_str()); }
+      open_prep_file<T>(outf[i], filename.str(), i, 2);
     }
   for (int i=0; i<ntrip; i++)
     {
@@ -134,8 +145,8 @@ void make_square_tuples(const T& key,int N,int ntrip,const string& str,bool zero
       c.mul(a,a);
       make_share(Sc,c,N,key,G);
       for (int j=0; j<N; j++)
-        { Sa[j].output(outf[j],false);
-          Sc[j].output(outf[j],false);
+        { outf[j].write(Sa[j]);
+          outf[j].write(Sc[j]);
         }
     }
   for (int i=0; i<N; i++)
@@ -153,23 +164,21 @@ void make_bits(const T& key,int N,int ntrip,const string& str,bool zero)
   PRNG G;
   G.ReSeed();
 
-  ofstream* outf=new ofstream[N];
+  PrepFileWriter* outf=new PrepFileWriter[N];
   T a;
   vector<Share<T> > Sa(N);
   /* Generate Bits */
   for (int i=0; i<N; i++)
     { stringstream filename;
       filename << prep_data_prefix << "Bits-" << str << "-P" << i;
-      cout << "Opening " << filename.str() << endl;
-      outf[i].open(filename.str().c_str(),ios::out | ios::binary);
-      if (outf[i].fail()) { throw file_error(filename.str().c_str()); }
+      open_prep_file<T>(outf[i], filename.str(), i, 1);
     }
   for (int i=0; i<ntrip; i++)
     { if ((G.get_uchar()&1)==0 || zero) { a.assign_zero(); }
       else                       { a.assign_one();  }
       make_share(Sa,a,N,key,G);
       for (int j=0; j<N; j++)
-        { Sa[j].output(outf[j],false); }
+        { outf[j].write(Sa[j]); }
     }
   for (int i=0; i<N; i++)
     { outf[i].close(); }
@@ -228,16 +237,14 @@ void make_inverse(const T& key,int N,int ntrip,bool zero)
   PRNG G;
   G.ReSeed();
 
-  ofstream* outf=new ofstream[N];
+  PrepFileWriter* outf=new PrepFileWriter[N];
   T a,b;
   vector<Share<T> > Sa(N),Sb(N);
   /* Generate Triples */
   for (int i=0; i<N; i++)
     { stringstream filename;
       filename << prep_data_prefix << "Inverses-" << T::type_char() << "-P" << i;
-      cout << "Opening " << filename.str() << endl;
-      outf[i].open(filename.str().c_str(),ios::out | ios::binary);
-      if (outf[i].fail()) { throw file_error(filename.str().c_str()); }
+      open_prep_file<T>(outf[i], filename.str(), i, 2);
     }
   for (int i=0; i<ntrip; i++)
     {
@@ -252,8 +259,8 @@ void make_inverse(const T& key,int N,int ntrip,bool zero)
       b=a; b.invert();
       make_share(Sb,b,N,key,G);
       for (int j=0; j<N; j++)
-        { Sa[j].output(outf[j],false); 
-          Sb[j].output(outf[j],false); 
+        { outf[j].write(Sa[j]); 
+          outf[j].write(Sb[j]); 
         }
     }
   for (int i=0; i<N; i++)
@@ -534,6 +541,8 @@ int main(int argc, const char** argv)
       cout << " Key " << i << "\t p: " << pp << "\n\t 2: " << p2 << endl;
       keyp.add(pp);
       key2.add(p2);
+      key_shares_p.push_back(pp);
+      key_shares_2.push_back(p2);
     }
   cout << "--------------\n";
   cout << "Final Keys :\t p: " << keyp << "\n\t\t 2: " << key2 << endl;
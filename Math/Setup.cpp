@@ -144,7 +144,8 @@ void write_online_setup(ofstream& outf, string dirname, const bigint& p, int lg2
   // LWE parameters
   outf << abs(lg2) << endl;
 
-  gfp::init_field(p, true);
+  // data for the online phase, see read_setup()
+  gfp::init_field(p, true, true);
   gf2n::init_field(lg2);
 }
 
@@ -177,7 +178,8 @@ void read_setup(const string& dir_prefix)
 
   inpf.close();
 
-  gfp::init_field(p);
+  // Mersenne primes use the faster reduction in the plain representation
+  gfp::init_field(p, true, true);
   gf2n::init_field(lg2);
 }
 
@@ -90,21 +90,6 @@ T combine(const vector< Share<T> >& S)
 
 
 
-template<class T>
-inline void Share<T>::pack(octetStream& os) const
-{
-  a.pack(os);
-  mac.pack(os);
-}
-
-template<class T>
-inline void Share<T>::unpack(octetStream& os)
-{
-  a.unpack(os);
-  mac.unpack(os);
-}
-
-
 template<class T>
 bool check_macs(const vector< Share<T> >& S,const T& key)
 {
@@ -118,6 +103,37 @@ bool check_macs(const vector< Share<T> >& S,const T& key)
   return true;
 }
 
+template <>
+void Share<gfp>::add(Share<gfp>* ans,const Share<gfp>* x,const Share<gfp>* y,int n)
+{
+  gfp::add(&ans->a, &x->a, &y->a, 2 * n);
+}
+
+template <>
+void Share<gfp>::sub(Share<gfp>* ans,const Share<gfp>* x,const Share<gfp>* y,int n)
+{
+  gfp::sub(&ans->a, &x->a, &y->a, 2 * n);
+}
+
+template <>
+void Share<gf2n>::add(Share<gf2n>* ans,const Share<gf2n>* x,const Share<gf2n>* y,int n)
+{
+  gf2n::add(&ans->a, &x->a, &y->a, 2 * n);
+}
+
+template <>
+void Share<gf2n>::sub(Share<gf2n>* ans,const Share<gf2n>* x,const Share<gf2n>* y,int n)
+{
+  gf2n::add(&ans->a, &x->a, &y->a, 2 * n);
+}
+
+template<class T>
+void Share<T>::add(Share<T>* ans,const Share<T>* x,const T* y,int n,bool playerone,const T& alphai)
+{
+  for (int i = 0; i < n; i++)
+    ans[i].add(x[i],y[i],playerone,alphai);
+}
+
 template class Share<gf2n>;
 template class Share<gfp>;
 template gf2n combine(const vector< Share<gf2n> >& S);
@@ -70,6 +70,12 @@ class Share
    void sub(const Share<T>& S1,const Share<T>& S2);
    void add(const Share<T>& S1) { add(*this,S1); }
 
+   // Element-wise operations on n consecutive shares
+   static void add(Share<T>* ans,const Share<T>* x,const Share<T>* y,int n);
+   static void sub(Share<T>* ans,const Share<T>* x,const Share<T>* y,int n);
+   static void mul(Share<T>* ans,const Share<T>* x,const T* y,int n);
+   static void add(Share<T>* ans,const Share<T>* x,const T* y,int n,bool playerone,const T& alphai);
+
    Share<T> operator+(const Share<T>& x) const
    { Share<T> res; res.add(*this, x); return res; }
    template <class U>
@@ -96,8 +102,10 @@ class Share
 
    friend ostream& operator<<(ostream& s, const Share<T>& x) { x.output(s, true); return s; }
 
-   void pack(octetStream& os) const;
-   void unpack(octetStream& os);
+   void pack(octetStream& os) const
+     { a.pack(os); mac.pack(os); }
+   void unpack(octetStream& os)
+     { a.unpack(os); mac.unpack(os); }
 
     /* Takes a vector of shares, one from each player and
      * determines the shared value
@@ -116,6 +124,16 @@ class Share
 template <>
 void Share<gf2n>::mul_by_bit(const Share<gf2n>& S,const gf2n& aa);
 
+// shares of gfp are consecutive gfp values, see gfp::add
+template <>
+void Share<gfp>::add(Share<gfp>* ans,const Share<gfp>* x,const Share<gfp>* y,int n);
+template <>
+void Share<gfp>::sub(Share<gfp>* ans,const Share<gfp>* x,const Share<gfp>* y,int n);
+template <>
+void Share<gf2n>::add(Share<gf2n>* ans,const Share<gf2n>* x,const Share<gf2n>* y,int n);
+template <>
+void Share<gf2n>::sub(Share<gf2n>* ans,const Share<gf2n>* x,const Share<gf2n>* y,int n);
+
 template <class T>
 Share<T> operator*(const T& y, const Share<T>& x) { Share<T> res; res.mul(x, y); return res; }
 
@@ -133,6 +151,27 @@ inline void Share<T>::mul(const Share<T>& S,const T& aa)
   mac.mul(S.mac,aa);
 }
 
+template<class T>
+inline void Share<T>::add(Share<T>* ans,const Share<T>* x,const Share<T>* y,int n)
+{
+  for (int i = 0; i < n; i++)
+    ans[i].add(x[i],y[i]);
+}
+
+template<class T>
+inline void Share<T>::sub(Share<T>* ans,const Share<T>* x,const Share<T>* y,int n)
+{
+  for (int i = 0; i < n; i++)
+    ans[i].sub(x[i],y[i]);
+}
+
+template<class T>
+inline void Share<T>::mul(Share<T>* ans,const Share<T>* x,const T* y,int n)
+{
+  for (int i = 0; i < n; i++)
+    ans[i].mul(x[i],y[i]);
+}
+
 template<class T>
 inline void Share<T>::assign(const T& aa, int my_num, const T& alphai)
 {
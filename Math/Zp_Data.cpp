@@ -4,7 +4,7 @@
 #include "Zp_Data.h"
 
 
-void Zp_Data::init(const bigint& p,bool mont)
+void Zp_Data::init(const bigint& p,bool mont,bool use_mersenne)
 { pr=p;
   mask=(1<<((mpz_sizeinbase(pr.get_mpz_t(),2)-1)%(8*sizeof(mp_limb_t))))-1;
 
@@ -12,6 +12,16 @@ void Zp_Data::init(const bigint& p,bool mont)
   t=mpz_size(pr.get_mpz_t());
   if (t>MAX_MOD_SZ)
     throw max_mod_sz_too_small(t);
+
+  // Mersenne primes use shift-and-add reduction on the plain representation
+  mersenne=0;
+  bigint p1=pr+1;
+  int k=mpz_sizeinbase(p1.get_mpz_t(),2)-1;
+  if (use_mersenne && t<=2 && mpz_popcount(p1.get_mpz_t())==1 && k%(8*sizeof(mp_limb_t))!=0)
+    { mersenne=k;
+      montgomery=false;
+    }
+
   if (montgomery)
     { inline_mpn_zero(R,MAX_MOD_SZ);
       inline_mpn_zero(R2,MAX_MOD_SZ);
@@ -47,6 +57,7 @@ void Zp_Data::assign(const Zp_Data& Zp)
 
   montgomery=Zp.montgomery;
   t=Zp.t;
+  mersenne=Zp.mersenne;
   mpn_copyi(R,Zp.R,t);
   mpn_copyi(R2,Zp.R2,t);
   mpn_copyi(R3,Zp.R3,t);
@@ -92,6 +103,28 @@ void Zp_Data::Mont_Mult(mp_limb_t* z,const mp_limb_t* x,const mp_limb_t* y) cons
 }
 
 
+void Zp_Data::to_canonical(mp_limb_t* z,const mp_limb_t* x) const
+{
+  if (montgomery)
+    { mp_limb_t one[MAX_MOD_SZ];
+      inline_mpn_zero(one,MAX_MOD_SZ);
+      one[0]=1;
+      Mont_Mult(z,x,one);
+    }
+  else
+    { inline_mpn_copyi(z,x,t); }
+}
+
+
+void Zp_Data::from_canonical(mp_limb_t* z,const mp_limb_t* x) const
+{
+  if (montgomery)
+    { Mont_Mult(z,x,R2); }
+  else
+    { inline_mpn_copyi(z,x,t); }
+}
+
+
 
 ostream& operator<<(ostream& s,const Zp_Data& ZpD)
 {
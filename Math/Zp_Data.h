@@ -35,8 +35,10 @@ class Zp_Data
   // extra limb needed for Montgomery multiplication
   mp_limb_t   prA[MAX_MOD_SZ+1];
   int         t;           // More Montgomery data
+  int         mersenne;    // k if pr=2^k-1 with k<64*t and asked for, zero otherwise
 
   void Mont_Mult(mp_limb_t* z,const mp_limb_t* x,const mp_limb_t* y) const;
+  void Mersenne_Mult(mp_limb_t* z,const mp_limb_t* x,const mp_limb_t* y) const;
 
   public:
 
@@ -44,19 +46,27 @@ class Zp_Data
   mp_limb_t    mask;
 
   void assign(const Zp_Data& Zp);
-  void init(const bigint& p,bool mont=true);
+  // With mersenne, primes 2^k-1 use shift-and-add reduction on the
+  // plain representation instead of Montgomery arithmetic
+  void init(const bigint& p,bool mont=true,bool mersenne=false);
   int get_t() const { return t; }
+  int get_mersenne() const { return mersenne; }
+  bool get_montgomery() const { return montgomery; }
   const mp_limb_t* get_prA() const { return prA; }
 
+  // Convert the t limbs of one value from/to the plain residue, z==x allowed
+  void to_canonical(mp_limb_t* z,const mp_limb_t* x) const;
+  void from_canonical(mp_limb_t* z,const mp_limb_t* x) const;
+
   void pack(octetStream& o) const;
   void unpack(octetStream& o);
 
   // This one does nothing, needed so as to make vectors of Zp_Data
-  Zp_Data() : montgomery(0), pi(0), mask(0) { t=1; }
+  Zp_Data() : montgomery(0), pi(0), mersenne(0), mask(0) { t=1; }
 
   // The main init funciton
-  Zp_Data(const bigint& p,bool mont=true)
-    { init(p,mont); }
+  Zp_Data(const bigint& p,bool mont=true,bool mersenne=false)
+    { init(p,mont,mersenne); }
 
   Zp_Data(const Zp_Data& Zp) { assign(Zp); }
   Zp_Data& operator=(const Zp_Data& Zp) 
@@ -70,6 +80,10 @@ class Zp_Data
   void Add(mp_limb_t* ans,const mp_limb_t* x,const mp_limb_t* y) const;
   void Sub(mp_limb_t* ans,const mp_limb_t* x,const mp_limb_t* y) const;
 
+  // Reduction modulo a Mersenne prime 2^k-1 with k<64 of a value below 2^(k+1)
+  static mp_limb_t Mersenne_Reduce(mp_limb_t x,int k);
+  static mp_limb_t Mersenne_Mult(mp_limb_t x,mp_limb_t y,int k);
+
   __m128i get_random128(PRNG& G);
 
   bool operator!=(const Zp_Data& other) const;
@@ -109,6 +123,15 @@ inline void Zp_Data::Add<0>(mp_limb_t* ans,const mp_limb_t* x,const mp_limb_t* y
     { mpn_sub_n(ans,ans,prA,t); }
 }
 
+template<>
+inline void Zp_Data::Add<1>(mp_limb_t* ans,const mp_limb_t* x,const mp_limb_t* y) const
+{
+  mp_limb_t c = x[0] + y[0];
+  if (c < x[0] || c >= prA[0])
+    c -= prA[0];
+  ans[0] = c;
+}
+
 template<>
 inline void Zp_Data::Add<2>(mp_limb_t* ans,const mp_limb_t* x,const mp_limb_t* y) const
 {
@@ -132,6 +155,8 @@ inline void Zp_Data::Add(mp_limb_t* ans,const mp_limb_t* x,const mp_limb_t* y) c
 {
   if (t == 2)
     return Add<2>(ans, x, y);
+  else if (t == 1)
+    return Add<1>(ans, x, y);
   else
     return Add<0>(ans, x, y);
 }
@@ -143,4 +168,47 @@ inline void Zp_Data::Sub(mp_limb_t* ans,const mp_limb_t* x,const mp_limb_t* y) c
     mpn_add_n(ans,ans,prA,t);
 }
 
+inline mp_limb_t Zp_Data::Mersenne_Reduce(mp_limb_t x,int k)
+{
+  mp_limb_t p = (mp_limb_t(1) << k) - 1;
+  x = (x & p) + (x >> k);
+  return x >= p ? x - p : x;
+}
+
+inline mp_limb_t Zp_Data::Mersenne_Mult(mp_limb_t x,mp_limb_t y,int k)
+{
+  // x*y = hi*2^k + lo = hi + lo mod 2^k-1
+  __uint128_t xy = (__uint128_t)x * y;
+  mp_limb_t p = (mp_limb_t(1) << k) - 1;
+  return Mersenne_Reduce(((mp_limb_t)xy & p) + (mp_limb_t)(xy >> k), k);
+}
+
+inline void Zp_Data::Mersenne_Mult(mp_limb_t* z,const mp_limb_t* x,const mp_limb_t* y) const
+{
+  if (t == 1)
+    {
+      z[0] = Mersenne_Mult(x[0], y[0], mersenne);
+      return;
+    }
+
+  // two limbs, 64<k<128: schoolbook product in four limbs r[0..3]
+  __uint128_t p00 = (__uint128_t)x[0] * y[0], p01 = (__uint128_t)x[0] * y[1];
+  __uint128_t p10 = (__uint128_t)x[1] * y[0], p11 = (__uint128_t)x[1] * y[1];
+  __uint128_t mid = (p00 >> 64) + (mp_limb_t)p01 + (mp_limb_t)p10;
+  __uint128_t high = (mid >> 64) + (p01 >> 64) + (p10 >> 64) + p11;
+  mp_limb_t r0 = p00, r1 = mid, r2 = high, r3 = high >> 64;
+
+  // split at bit k = 64+s and add the halves
+  int s = mersenne - 64;
+  __uint128_t pr128 = ((__uint128_t)1 << mersenne) - 1;
+  __uint128_t lo = ((__uint128_t)(r1 & ((mp_limb_t(1) << s) - 1)) << 64) | r0;
+  __uint128_t hi = ((__uint128_t)((r2 >> s) | (r3 << (64 - s))) << 64) | (r1 >> s) | (r2 << (64 - s));
+  __uint128_t res = lo + hi;
+  res = (res & pr128) + (res >> mersenne);
+  if (res >= pr128)
+    res -= pr128;
+  z[0] = res;
+  z[1] = res >> 64;
+}
+
 #endif
@@ -238,6 +238,27 @@ void gf2n_short::mul(const gf2n_short& x,const gf2n_short& y)
 }
 
 
+void gf2n_short::mul(gf2n_short* ans,const gf2n_short* x,const gf2n_short* y,int count)
+{
+  if (gf2n_short::useC)
+    {
+      for (int i = 0; i < count; i++)
+        ans[i].mul(x[i], y[i]);
+      return;
+    }
+
+  // as above, without the branch and the round trip through memory
+  for (int i = 0; i < count; i++)
+    {
+      __m128i zz = _mm_clmulepi64_si128(_mm_cvtsi64_si128(x[i].a),
+          _mm_cvtsi64_si128(y[i].a), 0);
+      word lo = _mm_cvtsi128_si64(zz);
+      word hi = _mm_cvtsi128_si64(_mm_unpackhi_epi64(zz, zz));
+      ans[i].reduce(hi, lo);
+    }
+}
+
+
 
 
 inline void sqr32(word x,word& ans)
@@ -132,6 +132,11 @@ class gf2n_short
   // = x * y
   void mul(const gf2n_short& x,const gf2n_short& y);
   void mul(const gf2n_short& x) { mul(*this,x); }
+
+  // Element-wise operations on count consecutive elements
+  static void add(gf2n_short* ans,const gf2n_short* x,const gf2n_short* y,int count)
+    { for (int i = 0; i < count; i++) ans[i].a = x[i].a ^ y[i].a; }
+  static void mul(gf2n_short* ans,const gf2n_short* x,const gf2n_short* y,int count);
   // x * y when one of x,y is a bit
   void mul_by_bit(const gf2n_short& x, const gf2n_short& y)   { a = x.a * y.a; }
 
@@ -176,6 +176,12 @@ class gf2n_long
   // = x * y
   gf2n_long& mul(const gf2n_long& x,const gf2n_long& y);
   void mul(const gf2n_long& x) { mul(*this,x); }
+
+  // Element-wise operations on count consecutive elements
+  static void add(gf2n_long* ans,const gf2n_long* x,const gf2n_long* y,int count)
+    { for (int i = 0; i < count; i++) ans[i].a = x[i].a ^ y[i].a; }
+  static void mul(gf2n_long* ans,const gf2n_long* x,const gf2n_long* y,int count)
+    { for (int i = 0; i < count; i++) ans[i].mul(x[i], y[i]); }
   // x * y when one of x,y is a bit
   void mul_by_bit(const gf2n_long& x, const gf2n_long& y)   { a = x.a.a * y.a.a; }
 
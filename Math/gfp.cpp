@@ -13,6 +13,79 @@ void gfp::almost_randomize(PRNG& G)
   a.x[t()-1]&=ZpD.mask;
 }
 
+void gfp::add(gfp* ans,const gfp* x,const gfp* y,int n)
+{
+  if (ZpD.get_mersenne() and t() == 1)
+    {
+      int k = ZpD.get_mersenne();
+      for (int i = 0; i < n; i++)
+        ans[i].a.x[0] = Zp_Data::Mersenne_Reduce(x[i].a.x[0] + y[i].a.x[0], k);
+    }
+  else if (t() == 1)
+    {
+      // same in Montgomery representation
+      mp_limb_t p = ZpD.get_prA()[0];
+      for (int i = 0; i < n; i++)
+        {
+          mp_limb_t xx = x[i].a.x[0], s = xx + y[i].a.x[0];
+          ans[i].a.x[0] = (s < xx or s >= p) ? s - p : s;
+        }
+    }
+  else
+    for (int i = 0; i < n; i++)
+      ans[i].add(x[i], y[i]);
+}
+
+void gfp::sub(gfp* ans,const gfp* x,const gfp* y,int n)
+{
+  if (ZpD.get_mersenne() and t() == 1)
+    {
+      int k = ZpD.get_mersenne();
+      mp_limb_t p = ZpD.get_prA()[0];
+      for (int i = 0; i < n; i++)
+        ans[i].a.x[0] = Zp_Data::Mersenne_Reduce(x[i].a.x[0] + p - y[i].a.x[0], k);
+    }
+  else if (t() == 1)
+    {
+      mp_limb_t p = ZpD.get_prA()[0];
+      for (int i = 0; i < n; i++)
+        {
+          mp_limb_t xx = x[i].a.x[0], yy = y[i].a.x[0];
+          ans[i].a.x[0] = xx < yy ? xx - yy + p : xx - yy;
+        }
+    }
+  else
+    for (int i = 0; i < n; i++)
+      ans[i].sub(x[i], y[i]);
+}
+
+void gfp::mul(gfp* ans,const gfp* x,const gfp* y,int n)
+{
+  if (ZpD.get_mersenne() and t() == 1)
+    {
+      int k = ZpD.get_mersenne();
+      for (int i = 0; i < n; i++)
+        ans[i].a.x[0] = Zp_Data::Mersenne_Mult(x[i].a.x[0], y[i].a.x[0], k);
+    }
+  else
+    for (int i = 0; i < n; i++)
+      ans[i].mul(x[i], y[i]);
+}
+
+void gfp::mul(gfp* ans,const gfp* x,const gfp& y,int n)
+{
+  if (ZpD.get_mersenne() and t() == 1)
+    {
+      int k = ZpD.get_mersenne();
+      mp_limb_t yy = y.a.x[0];
+      for (int i = 0; i < n; i++)
+        ans[i].a.x[0] = Zp_Data::Mersenne_Mult(x[i].a.x[0], yy, k);
+    }
+  else
+    for (int i = 0; i < n; i++)
+      ans[i].mul(x[i], y);
+}
+
 void gfp::AND(const gfp& x,const gfp& y)
 {
   bigint bi1,bi2;
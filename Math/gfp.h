@@ -32,8 +32,9 @@ class gfp
 
   typedef gfp value_type;
 
-  static void init_field(const bigint& p,bool mont=true)
-    { ZpD.init(p,mont); }
+  // mersenne: plain representation with faster reduction for 2^k-1
+  static void init_field(const bigint& p,bool mont=true,bool mersenne=false)
+    { ZpD.init(p,mont,mersenne); }
   static bigint pr()   
     { return ZpD.pr; }
   static int t()
@@ -127,6 +128,13 @@ class gfp
   void mul(const gfp& x) 
     { Mul(a,a,x.a,ZpD); }
 
+  // Element-wise operations on n consecutive elements, looping
+  // on single words for primes 2^k-1 with k<64
+  static void add(gfp* ans,const gfp* x,const gfp* y,int n);
+  static void sub(gfp* ans,const gfp* x,const gfp* y,int n);
+  static void mul(gfp* ans,const gfp* x,const gfp* y,int n);
+  static void mul(gfp* ans,const gfp* x,const gfp& y,int n);
+
   gfp operator+(const gfp& x) { gfp res; res.add(*this, x); return res; }
   gfp operator-(const gfp& x) { gfp res; res.sub(*this, x); return res; }
   gfp operator*(const gfp& x) { gfp res; res.mul(*this, x); return res; }
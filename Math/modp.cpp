@@ -147,7 +147,9 @@ void modp::convert_destroy(bigint& xx,
 
 void Sqr(modp& ans,const modp& x,const Zp_Data& ZpD)
 { 
-  if (ZpD.montgomery)
+  if (ZpD.mersenne)
+    { ZpD.Mersenne_Mult(ans.x,x.x,x.x); }
+  else if (ZpD.montgomery)
     { ZpD.Mont_Mult(ans.x,x.x,x.x); }
   else
     { //ans.x=(x.x*x.x)%ZpD.pr;
@@ -126,7 +126,9 @@ inline void Sub(modp& ans,const modp& x,const modp& y,const Zp_Data& ZpD)
 
 inline void Mul(modp& ans,const modp& x,const modp& y,const Zp_Data& ZpD)
 {
-  if (ZpD.montgomery)
+  if (ZpD.mersenne)
+    { ZpD.Mersenne_Mult(ans.x,x.x,y.x); }
+  else if (ZpD.montgomery)
     { ZpD.Mont_Mult(ans.x,x.x,y.x); }
   else
     { //ans.x=(x.x*y.x)%ZpD.pr;
@@ -0,0 +1,78 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * BroadcastHash.cpp
+ *
+ */
+
+#include "Networking/BroadcastHash.h"
+
+#include <stdint.h>
+#include <stdexcept>
+
+BroadcastHash::Type BroadcastHash::default_type = BroadcastHash::BLAKE2B_HASH;
+
+BroadcastHash::Type BroadcastHash::parse(const string& name)
+{
+  if (name == "sha1")
+    return SHA1_HASH;
+  else if (name == "blake2b")
+    return BLAKE2B_HASH;
+  else
+    throw runtime_error("unknown broadcast hash: " + name);
+}
+
+const char* BroadcastHash::name(Type type)
+{
+  switch (type)
+  {
+  case SHA1_HASH:
+    return "sha1";
+  case BLAKE2B_HASH:
+    return "blake2b";
+  default:
+    return "unknown";
+  }
+}
+
+BroadcastHash::BroadcastHash(Type type) : type(type)
+{
+  blake2b = (crypto_generichash_state*) (((uintptr_t) blake2b_buffer + 63)
+      & ~(uintptr_t) 63);
+  reset();
+}
+
+int BroadcastHash::size() const
+{
+  if (type == SHA1_HASH)
+    return HASH_SIZE;
+  else
+    return crypto_generichash_BYTES;
+}
+
+void BroadcastHash::update(const void* data, size_t length)
+{
+  if (type == SHA1_HASH)
+    blk_SHA1_Update(&sha1, data, length);
+  else
+    crypto_generichash_update(blake2b, (const unsigned char*) data, length);
+}
+
+void BroadcastHash::final(octetStream& os)
+{
+  octet hashVal[MAX_SIZE];
+  if (type == SHA1_HASH)
+    blk_SHA1_Final(hashVal, &sha1);
+  else
+    crypto_generichash_final(blake2b, hashVal, crypto_generichash_BYTES);
+  os.append(hashVal, size());
+  reset();
+}
+
+void BroadcastHash::reset()
+{
+  if (type == SHA1_HASH)
+    blk_SHA1_Init(&sha1);
+  else
+    crypto_generichash_init(blake2b, 0, 0, crypto_generichash_BYTES);
+}
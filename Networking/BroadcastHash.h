@@ -0,0 +1,64 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * BroadcastHash.h
+ *
+ */
+
+#ifndef NETWORKING_BROADCASTHASH_H_
+#define NETWORKING_BROADCASTHASH_H_
+
+#include "Tools/sha1.h"
+#include "Tools/octetStream.h"
+
+#include <sodium.h>
+#include <string>
+using namespace std;
+
+/*
+ * Incremental hash over all broadcast messages, compared by
+ * Player::Check_Broadcast. BLAKE2b (libsodium) is several times
+ * faster than the SHA-1 used before. All players have to use the
+ * same kind, otherwise the check fails.
+ */
+
+class BroadcastHash
+{
+public:
+  enum Type { SHA1_HASH, BLAKE2B_HASH };
+
+  static const int MAX_SIZE = crypto_generichash_BYTES;
+
+  static void set_default(Type type) { default_type = type; }
+  static Type get_default() { return default_type; }
+  // "sha1" or "blake2b", throws runtime_error otherwise
+  static Type parse(const string& name);
+  static const char* name(Type type);
+
+private:
+  static Type default_type;
+
+  Type type;
+  blk_SHA_CTX sha1;
+  // libsodium wants the state aligned to 64 bytes,
+  // which new does not guarantee, so it is placed in this buffer
+  unsigned char blake2b_buffer[sizeof(crypto_generichash_state) + 63];
+  crypto_generichash_state* blake2b;
+
+  BroadcastHash(const BroadcastHash&);
+  BroadcastHash& operator=(const BroadcastHash&);
+
+public:
+  BroadcastHash(Type type = default_type);
+
+  Type get_type() const { return type; }
+  int size() const;
+
+  void update(const void* data, size_t length);
+  void update(const octetStream& os) { update(os.get_data(), os.get_length()); }
+  // Append the digest to os and start again
+  void final(octetStream& os);
+  void reset();
+};
+
+#endif /* NETWORKING_BROADCASTHASH_H_ */
@@ -0,0 +1,266 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * ChannelMux.cpp
+ *
+ */
+
+#include "Networking/ChannelMux.h"
+#include "Networking/sockets.h"
+#include "Exceptions/Exceptions.h"
+
+#include <sodium.h>
+#include <errno.h>
+#include <string.h>
+#include <stdexcept>
+
+// buffers kept per connection for receiving
+#define MAX_RECYCLED 16
+// seconds to wait for the other end when starting and stopping
+#define MUX_TIMEOUT 300
+
+ChannelMux::Peer::Peer(ChannelMux* owner, int player, int socket) :
+    owner(owner), player(player), socket(socket), thread(0), token(0),
+    synchronized(socket < 0), finished(false), closed(false)
+{
+  pthread_mutex_init(&send_lock, 0);
+}
+
+ChannelMux::Peer::~Peer()
+{
+  pthread_mutex_destroy(&send_lock);
+}
+
+ChannelMux::ChannelMux(const vector<int>& sockets, int my_number) :
+    my_number(my_number), stopped(false), clean(true)
+{
+  peers.resize(sockets.size());
+  for (size_t i = 0; i < sockets.size(); i++)
+    peers[i] = new Peer(this, i, (int)i == my_number ? -1 : sockets[i]);
+
+  for (auto peer : peers)
+    if (peer->socket >= 0)
+      {
+        randombytes_buf(&peer->token, sizeof(peer->token));
+        send_frame(*peer, SYNC, (octet*)&peer->token, sizeof(peer->token));
+        pthread_create(&peer->thread, 0, run_thread, peer);
+      }
+
+  for (auto peer : peers)
+    {
+      peer->signal.lock();
+      while (not peer->synchronized and not peer->closed)
+        if (peer->signal.wait(MUX_TIMEOUT) == ETIMEDOUT)
+          break;
+      bool synchronized = peer->synchronized;
+      string error = peer->error;
+      peer->signal.unlock();
+      if (not synchronized)
+        throw runtime_error("cannot synchronize with player "
+            + to_string(peer->player) + (error.empty() ? "" : ": " + error));
+    }
+  cerr << "Multiplexing all threads over one connection per player" << endl;
+}
+
+ChannelMux::~ChannelMux()
+{
+  if (not stopped)
+    stop();
+  for (auto peer : peers)
+    delete peer;
+}
+
+void* ChannelMux::run_thread(void* peer)
+{
+  ((Peer*)peer)->owner->run(*(Peer*)peer);
+  return 0;
+}
+
+void ChannelMux::send_frame(Peer& peer, int channel, const octet* data,
+    size_t length)
+{
+  if (length >> 32)
+    throw runtime_error("message too long for multiplexing");
+  octet header[8];
+  encode_length(header, (uint32_t)channel, 4);
+  encode_length(header + 4, length, 4);
+  pthread_mutex_lock(&peer.send_lock);
+  ::send(peer.socket, header, sizeof(header), data, length);
+  pthread_mutex_unlock(&peer.send_lock);
+}
+
+bool ChannelMux::read_all(int socket, octet* data, size_t length)
+{
+  size_t done = 0;
+  while (done < length)
+    {
+      ssize_t n = recv(socket, data + done, length - done, 0);
+      if (n == 0)
+        {
+          if (done == 0)
+            return false;
+          throw runtime_error("connection closed in the middle of a frame");
+        }
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          throw runtime_error(string("receiving error: ") + strerror(errno));
+        }
+      done += n;
+    }
+  return true;
+}
+
+void ChannelMux::run(Peer& peer)
+{
+  try
+    {
+      octet header[8];
+      while (read_all(peer.socket, header, sizeof(header)))
+        {
+          int channel = (int)(uint32_t)decode_length(header, 4);
+          size_t length = decode_length(header + 4, 4);
+
+          octetStream buffer;
+          peer.signal.lock();
+          if (not peer.recycled.empty())
+            {
+              buffer.swap(peer.recycled.front());
+              peer.recycled.pop_front();
+            }
+          peer.signal.unlock();
+          buffer.reset_write_head();
+          buffer.resize(length);
+          if (length > 0 and not read_all(peer.socket, buffer.data, length))
+            throw runtime_error("connection closed in the middle of a frame");
+          buffer.len = length;
+
+          if (channel == SYNC)
+            {
+              send_frame(peer, ACK, buffer.data, length);
+              continue;
+            }
+
+          peer.signal.lock();
+          if (channel == ACK)
+            {
+              if (length == sizeof(peer.token)
+                  and memcmp(buffer.data, &peer.token, length) == 0)
+                peer.synchronized = true;
+            }
+          else if (channel == FIN)
+            peer.finished = peer.synchronized;
+          // anything before the answer to our token is from an earlier job
+          else if (peer.synchronized)
+            {
+              deque<octetStream>& queue = peer.channels[channel];
+              queue.emplace_back();
+              queue.back().swap(buffer);
+            }
+          if (buffer.get_max_length() > 0
+              and peer.recycled.size() < MAX_RECYCLED)
+            {
+              peer.recycled.emplace_back();
+              peer.recycled.back().swap(buffer);
+            }
+          bool finished = peer.finished;
+          peer.signal.broadcast();
+          peer.signal.unlock();
+
+          // leave everything after for the next job
+          if (finished)
+            break;
+        }
+    }
+  catch (exception& e)
+    {
+      peer.signal.lock();
+      peer.error = e.what();
+      peer.signal.unlock();
+    }
+  peer.signal.lock();
+  peer.closed = true;
+  peer.signal.broadcast();
+  peer.signal.unlock();
+}
+
+void ChannelMux::send(int player, int channel, const octetStream& o)
+{
+  if (channel < 0)
+    throw runtime_error("invalid channel " + to_string(channel));
+  Peer& peer = *peers[player];
+  if (player == my_number)
+    {
+      peer.signal.lock();
+      peer.channels[channel].push_back(o);
+      peer.signal.broadcast();
+      peer.signal.unlock();
+    }
+  else
+    send_frame(peer, channel, o.get_data(), o.get_length());
+}
+
+void ChannelMux::receive(int player, int channel, octetStream& o)
+{
+  Peer& peer = *peers[player];
+  peer.signal.lock();
+  deque<octetStream>& queue = peer.channels[channel];
+  while (queue.empty() and not peer.closed)
+    peer.signal.wait();
+  if (queue.empty())
+    {
+      string error = peer.error;
+      peer.signal.unlock();
+      throw runtime_error("connection to player " + to_string(player)
+          + " closed" + (error.empty() ? "" : ": " + error));
+    }
+  o.swap(queue.front());
+  if (player != my_number and peer.recycled.size() < MAX_RECYCLED)
+    {
+      peer.recycled.emplace_back();
+      peer.recycled.back().swap(queue.front());
+    }
+  queue.pop_front();
+  peer.signal.unlock();
+}
+
+bool ChannelMux::stop()
+{
+  stopped = true;
+  for (auto peer : peers)
+    if (peer->socket >= 0)
+      {
+        try
+          {
+            send_frame(*peer, FIN, 0, 0);
+          }
+        catch (exception& e)
+          {
+            clean = false;
+          }
+      }
+
+  for (auto peer : peers)
+    if (peer->socket >= 0)
+      {
+        peer->signal.lock();
+        while (not peer->finished and not peer->closed)
+          if (peer->signal.wait(MUX_TIMEOUT) == ETIMEDOUT)
+            break;
+        bool finished = peer->finished;
+        bool closed = peer->closed;
+        peer->signal.unlock();
+        if (not finished)
+          {
+            cerr << "Player " << peer->player
+                << " did not finish properly" << endl;
+            clean = false;
+          }
+        // stuck in receiving
+        if (not finished and not closed)
+          pthread_cancel(peer->thread);
+        pthread_join(peer->thread, 0);
+      }
+  return clean;
+}
@@ -0,0 +1,92 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * ChannelMux.h
+ *
+ */
+
+#ifndef NETWORKING_CHANNELMUX_H_
+#define NETWORKING_CHANNELMUX_H_
+
+#include "Tools/octetStream.h"
+#include "Tools/Signal.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+using namespace std;
+
+/*
+ * Carries the communication of all threads over one connection per
+ * pair of players. Every message is framed with the channel number of
+ * the sending thread, and one thread per connection sorts incoming
+ * messages into queues by channel, so that threads never wait for each
+ * other when receiving.
+ *
+ * The connections can come from connection-broker.x and be used by
+ * several jobs one after the other. Therefore, both ends first agree
+ * on a fresh token and drop everything received before the answer to
+ * their own token, and both ends announce the end of their job before
+ * letting go of the connections.
+ */
+
+class ChannelMux
+{
+  struct Peer
+  {
+    ChannelMux* owner;
+    int player;
+    int socket;
+    pthread_t thread;
+    pthread_mutex_t send_lock;
+    // protects everything below
+    Signal signal;
+    map<int, deque<octetStream> > channels;
+    // buffers of consumed messages for the receiving thread
+    deque<octetStream> recycled;
+    uint64_t token;
+    bool synchronized, finished, closed;
+    string error;
+
+    Peer(ChannelMux* owner, int player, int socket);
+    ~Peer();
+  };
+
+  int my_number;
+  vector<Peer*> peers;
+  bool stopped, clean;
+
+  static void* run_thread(void* peer);
+
+  void send_frame(Peer& peer, int channel, const octet* data, size_t length);
+  void run(Peer& peer);
+  bool read_all(int socket, octet* data, size_t length);
+
+public:
+  // control frames, not available as channels
+  static const int SYNC = -1;
+  static const int ACK = -2;
+  static const int FIN = -3;
+
+  // one connected socket per player, ignored for myself
+  ChannelMux(const vector<int>& sockets, int my_number);
+  ~ChannelMux();
+
+  int my_num() const { return my_number; }
+  int num_players() const { return peers.size(); }
+
+  void send(int player, int channel, const octetStream& o);
+  // swaps the received message into o
+  void receive(int player, int channel, octetStream& o);
+
+  /* Tell all players that this job is done and wait for them to do
+   * the same, so that nothing is left on the connections.
+   * Returns whether this was successful.
+   */
+  bool stop();
+};
+
+#endif /* NETWORKING_CHANNELMUX_H_ */
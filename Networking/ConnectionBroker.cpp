@@ -0,0 +1,202 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * ConnectionBroker.cpp
+ *
+ */
+
+#include "Networking/ConnectionBroker.h"
+#include "Exceptions/Exceptions.h"
+
+#include <sys/un.h>
+#include <sstream>
+#include <stdexcept>
+
+// sent by a job that stopped its ChannelMux properly
+#define JOB_CLEAN 'F'
+#define JOB_UNCLEAN 'X'
+
+string ConnectionBroker::default_path(int portnum_base, int player)
+{
+  stringstream ss;
+  ss << "/tmp/spdz-broker-" << portnum_base << "-" << player;
+  return ss.str();
+}
+
+ConnectionBroker::~ConnectionBroker()
+{
+  if (job_socket >= 0)
+    close(job_socket);
+  for (auto socket : sockets)
+    if (socket >= 0)
+      close(socket);
+}
+
+void ConnectionBroker::connect(const Names& N)
+{
+  int nplayers = N.num_players();
+  int my_num = N.my_num();
+  if (N.server == 0)
+    throw runtime_error("need server socket for connecting players");
+  sockets.resize(nplayers, -1);
+  for (int i = my_num + 1; i < nplayers; i++)
+    {
+      int id = ID_BASE + i * nplayers + my_num;
+      fprintf(stderr, "Setting up shared connection to %s:%d with id 0x%x\n",
+          N.names[i].c_str(), N.ports[i], id);
+      set_up_client_socket(sockets[i], N.names[i].c_str(), N.ports[i]);
+      send(sockets[i], (octet*)&id, sizeof(id));
+    }
+  for (int i = 0; i < my_num; i++)
+    {
+      int id = ID_BASE + my_num * nplayers + i;
+      fprintf(stderr, "Waiting for shared connection with id 0x%x\n", id);
+      sockets[i] = N.server->get_connection_socket(id);
+      // not all systems pass it on to accepted sockets
+      int one = 1;
+      if (setsockopt(sockets[i], IPPROTO_TCP, TCP_NODELAY, (char*)&one,
+          sizeof(int)) < 0)
+        error("set_up_socket:setsockopt");
+    }
+}
+
+void ConnectionBroker::fetch(const string& path, Names& N, int player)
+{
+  sockaddr_un address;
+  if (path.size() >= sizeof(address.sun_path))
+    throw runtime_error("path too long: " + path);
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path.c_str());
+  job_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (job_socket < 0)
+    error("broker:socket");
+  if (::connect(job_socket, (sockaddr*)&address, sizeof(address)) < 0)
+    throw runtime_error("cannot connect to connection-broker.x at " + path
+        + ": " + strerror(errno));
+  cerr << "Waiting for connections from " << path << endl;
+
+  // my number and the number of players, then the sockets
+  int info[2];
+  vector<char> control(CMSG_SPACE(sizeof(int) * 1024));
+  iovec iov = { info, sizeof(info) };
+  msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control.data();
+  message.msg_controllen = control.size();
+  if (recvmsg(job_socket, &message, MSG_WAITALL) != sizeof(info))
+    throw runtime_error("no connections from connection-broker.x");
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+  int nplayers = info[1];
+  if (info[0] != player)
+    throw runtime_error("connection-broker.x runs for player "
+        + to_string(info[0]) + ", not " + to_string(player));
+  if (nplayers < 2 or nplayers > 1024 or cmsg == 0
+      or cmsg->cmsg_type != SCM_RIGHTS
+      or cmsg->cmsg_len != CMSG_LEN(sizeof(int) * (nplayers - 1)))
+    throw runtime_error("invalid message from connection-broker.x");
+
+  int* fds = (int*)CMSG_DATA(cmsg);
+  sockets.resize(nplayers, -1);
+  for (int i = 0, j = 0; i < nplayers; i++)
+    if (i != player)
+      sockets[i] = fds[j++];
+
+  N.player_no = player;
+  N.nplayers = nplayers;
+  N.names.resize(nplayers, "connection-broker");
+  N.server = 0;
+  cerr << "Got connections to " << nplayers - 1 << " players from " << path
+      << endl;
+}
+
+void ConnectionBroker::release(bool clean)
+{
+  if (job_socket < 0)
+    return;
+  octet status = clean ? JOB_CLEAN : JOB_UNCLEAN;
+  if (::send(job_socket, &status, 1, MSG_NOSIGNAL) != 1)
+    cerr << "Could not release connections" << endl;
+  close(job_socket);
+  job_socket = -1;
+}
+
+void ConnectionBroker::serve(const string& path, const Names& N)
+{
+  connect(N);
+
+  sockaddr_un address;
+  if (path.size() >= sizeof(address.sun_path))
+    throw runtime_error("path too long: " + path);
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path.c_str());
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+    error("broker:socket");
+  // left over from an earlier run
+  unlink(path.c_str());
+  if (bind(listener, (sockaddr*)&address, sizeof(address)) < 0)
+    throw file_error(path);
+  if (listen(listener, 16) < 0)
+    error("broker:listen");
+
+  int info[2] = { N.my_num(), N.num_players() };
+  vector<int> fds;
+  for (int i = 0; i < N.num_players(); i++)
+    if (i != N.my_num())
+      fds.push_back(sockets[i]);
+  vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+
+  for (int n_jobs = 0; ; n_jobs++)
+    {
+      cerr << "Waiting for job on " << path << endl;
+      int job = accept(listener, 0, 0);
+      if (job < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          error("broker:accept");
+        }
+
+      iovec iov = { info, sizeof(info) };
+      msghdr message;
+      memset(&message, 0, sizeof(message));
+      message.msg_iov = &iov;
+      message.msg_iovlen = 1;
+      message.msg_control = control.data();
+      message.msg_controllen = control.size();
+      cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+      memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+      if (sendmsg(job, &message, MSG_NOSIGNAL) != sizeof(info))
+        {
+          cerr << "Could not hand over connections" << endl;
+          close(job);
+          continue;
+        }
+      cerr << "Handed connections to job " << n_jobs << endl;
+
+      // the job keeps the connection open until it is done
+      octet status = 0;
+      ssize_t res;
+      while ((res = recv(job, &status, 1, 0)) < 0 and errno == EINTR)
+        ;
+      close(job);
+      if (res != 1 or status != JOB_CLEAN)
+        {
+          cerr << "Job " << n_jobs << " did not finish cleanly, "
+              << "connections might be out of sync. "
+              << "Restart connection-broker.x for all players." << endl;
+          break;
+        }
+      cerr << "Job " << n_jobs << " finished" << endl;
+    }
+
+  close(listener);
+  unlink(path.c_str());
+}
@@ -0,0 +1,53 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * ConnectionBroker.h
+ *
+ */
+
+#ifndef NETWORKING_CONNECTIONBROKER_H_
+#define NETWORKING_CONNECTIONBROKER_H_
+
+#include "Networking/Player.h"
+
+#include <vector>
+#include <string>
+using namespace std;
+
+/*
+ * Sets up one connection to every other player, to be shared by all
+ * threads via ChannelMux. connection-broker.x keeps these connections
+ * open and hands them to one job after the other over a Unix domain
+ * socket, so that jobs neither contact Server.x nor connect to anyone.
+ */
+
+class ConnectionBroker
+{
+  // indexed by player, -1 for myself
+  vector<int> sockets;
+  // connection to connection-broker.x, held until the job is done
+  int job_socket;
+
+public:
+  // above all ids used for threads and MAC checks
+  static const int ID_BASE = 0x7fff << 16;
+
+  static string default_path(int portnum_base, int player);
+
+  ConnectionBroker() : job_socket(-1) {}
+  ~ConnectionBroker();
+
+  // connect using the server socket of N
+  void connect(const Names& N);
+  // get the connections from connection-broker.x and set up N accordingly
+  void fetch(const string& path, Names& N, int player);
+  // tell connection-broker.x whether the connections can be reused
+  void release(bool clean);
+
+  const vector<int>& get_sockets() const { return sockets; }
+
+  // for connection-broker.x, returns if a job did not finish cleanly
+  void serve(const string& path, const Names& N);
+};
+
+#endif /* NETWORKING_CONNECTIONBROKER_H_ */
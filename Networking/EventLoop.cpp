@@ -0,0 +1,341 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * EventLoop.cpp
+ *
+ */
+
+#include "Networking/EventLoop.h"
+#include "Networking/sockets.h"
+#include "Exceptions/Exceptions.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <limits.h>
+
+void* run_event_loop_thread(void* loop)
+{
+  ((EventLoop*)loop)->run();
+  return 0;
+}
+
+EventLoop::EventLoop(const vector<int>& sockets) :
+    thread(0), stopping(false), n_calls(0), n_messages(0)
+{
+  epoll_fd = epoll_create1(0);
+  if (epoll_fd < 0)
+    error("epoll_create1");
+  wake_fd = eventfd(0, EFD_NONBLOCK);
+  if (wake_fd < 0)
+    error("eventfd");
+
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = wake_fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) < 0)
+    error("epoll_ctl");
+
+  // only waiting for events while there are requests
+  for (int socket : sockets)
+    {
+      event.events = 0;
+      event.data.fd = socket;
+      if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket, &event) < 0)
+        error("epoll_ctl");
+      channels[socket];
+    }
+
+  pthread_create(&thread, 0, run_event_loop_thread, this);
+}
+
+EventLoop::~EventLoop()
+{
+  lock.lock();
+  stopping = true;
+  lock.unlock();
+  wake();
+  pthread_join(thread, 0);
+  close(wake_fd);
+  close(epoll_fd);
+}
+
+void EventLoop::wake()
+{
+  uint64_t one = 1;
+  if (write(wake_fd, &one, sizeof(one)) != sizeof(one))
+    error("waking up event loop");
+}
+
+void EventLoop::send(int socket, const octetStream& os, Callback callback)
+{
+  SendJob job;
+  job.os = &os;
+  encode_length(job.header, os.get_length(), LENGTH_SIZE);
+  job.done = 0;
+  job.callback = callback;
+  lock.lock();
+  new_sends.push_back({socket, job});
+  lock.unlock();
+  wake();
+}
+
+void EventLoop::receive(int socket, octetStream& os, Callback callback)
+{
+  ReceiveJob job;
+  job.os = &os;
+  job.done = 0;
+  job.callback = callback;
+  lock.lock();
+  new_receives.push_back({socket, job});
+  lock.unlock();
+  wake();
+}
+
+void EventLoop::run()
+{
+  const int max_events = 64;
+  epoll_event events[max_events];
+  while (true)
+    {
+      int n = epoll_wait(epoll_fd, events, max_events, -1);
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          else
+            error("epoll_wait");
+        }
+
+      bool woken = false;
+      for (int i = 0; i < n; i++)
+        {
+          int fd = events[i].data.fd;
+          if (fd == wake_fd)
+            {
+              uint64_t count;
+              if (read(wake_fd, &count, sizeof(count)) < 0 and errno != EAGAIN)
+                error("event loop wake-up");
+              woken = true;
+            }
+          else
+            {
+              Channel& channel = channels[fd];
+              if (events[i].events & (EPOLLHUP | EPOLLERR))
+                channel.closed = true;
+              progress(fd, channel);
+            }
+        }
+
+      if (woken and take_requests())
+        return;
+    }
+}
+
+bool EventLoop::take_requests()
+{
+  vector< pair<int, SendJob> > sends;
+  vector< pair<int, ReceiveJob> > receives;
+  lock.lock();
+  sends.swap(new_sends);
+  receives.swap(new_receives);
+  bool res = stopping;
+  lock.unlock();
+
+  for (auto& request : sends)
+    channels[request.first].sends.push_back(request.second);
+  for (auto& request : receives)
+    channels[request.first].receives.push_back(request.second);
+  // try right away, waiting for epoll only if the socket is busy
+  for (auto& request : sends)
+    progress(request.first, channels[request.first]);
+  for (auto& request : receives)
+    progress(request.first, channels[request.first]);
+  return res;
+}
+
+void EventLoop::progress(int socket, Channel& channel)
+{
+  if (channel.error)
+    fail(channel, channel.error);
+  else
+    {
+      progress_send(socket, channel);
+      progress_receive(socket, channel);
+    }
+  update_events(socket, channel);
+}
+
+void EventLoop::progress_send(int socket, Channel& channel)
+{
+  while (not channel.sends.empty() and not channel.error)
+    {
+      iovec iov[IOV_MAX];
+      size_t n_iov = 0;
+      for (auto& job : channel.sends)
+        {
+          if (n_iov + 2 > IOV_MAX)
+            break;
+          size_t length = job.os->get_length();
+          if (job.done < LENGTH_SIZE)
+            {
+              iov[n_iov++] = {job.header + job.done, LENGTH_SIZE - job.done};
+              if (length > 0)
+                iov[n_iov++] = {job.os->get_data(), length};
+            }
+          else
+            iov[n_iov++] = {job.os->get_data() + job.done - LENGTH_SIZE,
+                LENGTH_SIZE + length - job.done};
+        }
+
+      msghdr msg = {};
+      msg.msg_iov = iov;
+      msg.msg_iovlen = n_iov;
+      ssize_t res = sendmsg(socket, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (res < 0)
+        {
+          if (errno == EAGAIN or errno == EWOULDBLOCK)
+            return;
+          else if (errno == EINTR)
+            continue;
+          fail(channel, "sending");
+          return;
+        }
+      n_calls++;
+      sent_amount += res;
+      sent_counter++;
+
+      size_t left = res;
+      while (not channel.sends.empty())
+        {
+          SendJob& job = channel.sends.front();
+          size_t total = LENGTH_SIZE + job.os->get_length();
+          size_t step = min(left, total - job.done);
+          job.done += step;
+          left -= step;
+          if (job.done < total)
+            break;
+          Callback callback = job.callback;
+          channel.sends.pop_front();
+          n_messages++;
+          callback(0);
+        }
+    }
+}
+
+void EventLoop::progress_receive(int socket, Channel& channel)
+{
+  while (not channel.receives.empty() and not channel.error)
+    {
+      ReceiveJob& job = channel.receives.front();
+      octetStream& os = *job.os;
+      ssize_t res;
+      if (job.done < LENGTH_SIZE)
+        res = recv(socket, job.header + job.done, LENGTH_SIZE - job.done,
+            MSG_DONTWAIT);
+      else
+        res = recv(socket, os.data + job.done - LENGTH_SIZE,
+            LENGTH_SIZE + os.len - job.done, MSG_DONTWAIT);
+
+      if (res < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          else if (errno != EAGAIN and errno != EWOULDBLOCK)
+            fail(channel, "receiving");
+          else if (channel.closed)
+            fail(channel, "connection closed");
+          return;
+        }
+      else if (res == 0)
+        {
+          fail(channel, "connection closed");
+          return;
+        }
+
+      bool had_length = job.done >= LENGTH_SIZE;
+      job.done += res;
+      if (not had_length and job.done == LENGTH_SIZE)
+        {
+          size_t length = decode_length(job.header, LENGTH_SIZE);
+          os.reset_write_head();
+          os.resize(length);
+          os.len = length;
+        }
+
+      if (job.done == LENGTH_SIZE + os.len)
+        {
+          Callback callback = job.callback;
+          channel.receives.pop_front();
+          callback(0);
+        }
+    }
+}
+
+void EventLoop::update_events(int socket, Channel& channel)
+{
+  uint32_t events = 0;
+  if (not channel.sends.empty())
+    events |= EPOLLOUT;
+  if (not channel.receives.empty())
+    events |= EPOLLIN;
+  // hang-ups are reported regardless, stop listening after one
+  if (channel.closed and events == 0)
+    events = EPOLLET;
+  if (events != channel.events)
+    {
+      epoll_event event = {};
+      event.events = events;
+      event.data.fd = socket;
+      if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, socket, &event) < 0)
+        error("epoll_ctl");
+      channel.events = events;
+    }
+}
+
+void EventLoop::fail(Channel& channel, const char* error)
+{
+  channel.error = error;
+  while (not channel.sends.empty())
+    {
+      Callback callback = channel.sends.front().callback;
+      channel.sends.pop_front();
+      callback(error);
+    }
+  while (not channel.receives.empty())
+    {
+      Callback callback = channel.receives.front().callback;
+      channel.receives.pop_front();
+      callback(error);
+    }
+}
+
+EventLoop::Callback EventWaiter::expect()
+{
+  signal.lock();
+  pending++;
+  signal.unlock();
+  return [this](const char* error) { done(error); };
+}
+
+void EventWaiter::done(const char* error)
+{
+  signal.lock();
+  pending--;
+  if (error and this->error.empty())
+    this->error = error;
+  signal.broadcast();
+  signal.unlock();
+}
+
+void EventWaiter::wait()
+{
+  signal.lock();
+  while (pending > 0)
+    signal.wait();
+  string res = error;
+  error.clear();
+  signal.unlock();
+  if (not res.empty())
+    throw runtime_error("Communication error: " + res);
+}
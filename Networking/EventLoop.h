@@ -0,0 +1,124 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * EventLoop.h
+ *
+ */
+
+#ifndef NETWORKING_EVENTLOOP_H_
+#define NETWORKING_EVENTLOOP_H_
+
+#include "Tools/octetStream.h"
+#include "Tools/Lock.h"
+#include "Tools/Signal.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <vector>
+#include <string>
+#include <functional>
+using namespace std;
+
+/*
+ * Drives the communication on a set of sockets from a single thread
+ * using epoll. Messages have the same format as with
+ * octetStream::Send/Receive. Data is sent from and received into
+ * the octetStream buffers directly, and all messages queued for a
+ * socket go out in one sendmsg() call. Requests on a socket complete
+ * in order, and the callback runs on the I/O thread with 0 or an
+ * error message.
+ */
+
+class EventLoop
+{
+public:
+  typedef function<void(const char*)> Callback;
+
+private:
+  struct SendJob
+  {
+    const octetStream* os;
+    octet header[LENGTH_SIZE];
+    size_t done;
+    Callback callback;
+  };
+
+  struct ReceiveJob
+  {
+    octetStream* os;
+    octet header[LENGTH_SIZE];
+    size_t done;
+    Callback callback;
+  };
+
+  struct Channel
+  {
+    deque<SendJob> sends;
+    deque<ReceiveJob> receives;
+    uint32_t events;
+    bool closed;
+    const char* error;
+    Channel() : events(0), closed(false), error(0) {}
+  };
+
+  int epoll_fd, wake_fd;
+  pthread_t thread;
+
+  // only used by the I/O thread once running
+  map<int, Channel> channels;
+
+  // Protects the following
+  Lock lock;
+  vector< pair<int, SendJob> > new_sends;
+  vector< pair<int, ReceiveJob> > new_receives;
+  bool stopping;
+
+  // prevent copying
+  EventLoop(const EventLoop& other);
+
+  void wake();
+  bool take_requests();
+  void progress(int socket, Channel& channel);
+  void progress_send(int socket, Channel& channel);
+  void progress_receive(int socket, Channel& channel);
+  void update_events(int socket, Channel& channel);
+  void fail(Channel& channel, const char* error);
+
+public:
+  // sendmsg() calls and messages sent,
+  // only valid while no requests are outstanding
+  size_t n_calls, n_messages;
+
+  EventLoop(const vector<int>& sockets);
+  ~EventLoop();
+
+  void run();
+
+  // os has to stay unchanged until the callback
+  void send(int socket, const octetStream& os, Callback callback);
+  void receive(int socket, octetStream& os, Callback callback);
+};
+
+/*
+ * Counts outstanding requests and waits for them.
+ */
+
+class EventWaiter
+{
+  Signal signal;
+  int pending;
+  string error;
+
+  void done(const char* error);
+
+public:
+  EventWaiter() : pending(0) {}
+
+  EventLoop::Callback expect();
+  // Throws if any request failed
+  void wait();
+};
+
+#endif /* NETWORKING_EVENTLOOP_H_ */
@@ -19,12 +19,21 @@ CommsecKeysPackage::CommsecKeysPackage(vector<public_signing_key> playerpubs,
     my_public_key = mypub;
 }
 
+const char* Names::SHARED_MEMORY_PREFIX = "shm://";
+
 void Names::init(int player,int pnb,int my_port,const char* servername)
 {
   player_no=player;
   portnum_base=pnb;
-  setup_names(servername, my_port);
   keys = NULL;
+  shared_memory = false;
+  if (strncmp(servername, SHARED_MEMORY_PREFIX,
+      strlen(SHARED_MEMORY_PREFIX)) == 0)
+    {
+      setup_shared_memory(servername);
+      return;
+    }
+  setup_names(servername, my_port);
   setup_server();
 }
 
@@ -47,6 +56,7 @@ void Names::init(int player,int pnb,vector<octet*> Nms)
       names[i]=(char*)Nms[i];
   }
   keys = NULL;
+  shared_memory = false;
   setup_server();
 }
 
@@ -64,6 +74,7 @@ void Names::init(int player, int pnb, const string& filename, int nplayers_wante
   nplayers = 0;
   portnum_base = pnb;
   keys = NULL;
+  shared_memory = false;
   string line;
   while (getline(hostsfile, line))
   {
@@ -138,6 +149,20 @@ void Names::setup_names(const char *servername, int my_port)
 }
 
 
+void Names::setup_shared_memory(const char *servername)
+{
+  nplayers = atoi(servername + strlen(SHARED_MEMORY_PREFIX));
+  if (nplayers < 2 or player_no < 0 or player_no >= nplayers)
+    throw runtime_error(string("need number of players in ")
+        + SHARED_MEMORY_PREFIX + "<players>, got " + servername);
+  shared_memory = true;
+  names.resize(nplayers, "localhost");
+  setup_ports();
+  server = 0;
+  cerr << "Using shared memory for " << nplayers << " players" << endl;
+}
+
+
 void Names::setup_server()
 {
   server = new ServerSocket(ports[player_no]);
@@ -155,6 +180,7 @@ Names::Names(const Names& other)
   names = other.names;
   ports = other.ports;
   keys = NULL;
+  shared_memory = other.shared_memory;
   server = 0;
 }
 
@@ -168,29 +194,61 @@ Names::~Names()
 
 
 Player::Player(const Names& Nms, int id) :
-        PlayerBase(Nms.my_num()), send_to_self_socket(-1)
+        PlayerBase(Nms.my_num()), send_to_self_socket(-1), coalesce(false),
+        n_buffered(0), n_flushes(0)
 {
+  if (Nms.shared_memory)
+    throw runtime_error("only ShmPlayer can use shared memory");
+  if (Nms.server == 0)
+    throw runtime_error("no server socket for setting up connections, "
+        "connections from connection-broker.x only work for the threads "
+        "running tapes");
   nplayers=Nms.nplayers;
   player_no=Nms.player_no;
   setup_sockets(Nms.names, Nms.ports, id, *Nms.server);
-  blk_SHA1_Init(&ctx);
+  send_buffers.resize(nplayers);
+}
+
+
+Player::Player(int my_num, int nplayers) :
+        PlayerBase(my_num), send_to_self_socket(-1), nplayers(nplayers),
+        coalesce(false), n_buffered(0), n_flushes(0)
+{
 }
 
 
 Player::~Player()
 {
+  flush();
+
   /* Close down the sockets */
-  for (int i=0; i<nplayers; i++)
+  for (size_t i=0; i<sockets.size(); i++)
     close_client_socket(sockets[i]);
 
   for (auto it = comm_stats.begin(); it != comm_stats.end(); it++)
     cout << it->first << " " << 1e-6 * it->second.data << " MB in "
-        << it->second.rounds << " rounds, taking " << it->second.timer.elapsed()
+        << it->second.rounds << " rounds and " << it->second.messages
+        << " messages, taking " << it->second.timer.elapsed()
         << " seconds" << endl;
+  if (n_flushes > 0)
+    cout << "Coalesced " << n_buffered << " messages into " << n_flushes
+        << " rounds, " << 1. * n_buffered / n_flushes << " per round" << endl;
 }
 
 
 
+void Player::get_comm_totals(size_t& data, size_t& rounds) const
+{
+  data = 0;
+  rounds = 0;
+  for (auto it = comm_stats.begin(); it != comm_stats.end(); it++)
+    {
+      data += it->second.data;
+      rounds += it->second.rounds;
+    }
+}
+
+
 // Set up nmachines client and server sockets to send data back and fro
 //   A machine is a server between it and player i if i<=my_number
 //   Can also communicate with myself, but only with send_to and receive_from
@@ -225,31 +283,80 @@ void Player::setup_sockets(const vector<string>& names,const vector<int>& ports,
         tv.tv_usec = 0;
         int fl = setsockopt(sockets[i], SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(struct timeval));
         if (fl<0) { error("set_up_socket:setsockopt");  }
+        // not all systems pass it on to accepted sockets
+        int one = 1;
+        fl = setsockopt(sockets[i], IPPROTO_TCP, TCP_NODELAY, (char*)&one, sizeof(int));
+        if (fl<0) { error("set_up_socket:setsockopt");  }
         socket_players[sockets[i]] = i;
     }
 }
 
 
+void Player::buffer_send(int player, const octetStream& o) const
+{
+  octetStream& buffer = send_buffers[player];
+  octet blen[LENGTH_SIZE];
+  encode_length(blen, o.get_length(), LENGTH_SIZE);
+  buffer.append(blen, LENGTH_SIZE);
+  n_buffered++;
+  // send large messages right away to avoid copying
+  if (o.get_length() > (1 << 16))
+    {
+      send(socket_to_send(player), buffer.get_data(), buffer.get_length(),
+          o.get_data(), o.get_length());
+      buffer.reset_write_head();
+      n_flushes++;
+    }
+  else
+    buffer.append(o.get_data(), o.get_length());
+}
+
+
+void Player::flush() const
+{
+  bool flushed = false;
+  for (int i = 0; i < (int)send_buffers.size(); i++)
+    {
+      octetStream& buffer = send_buffers[i];
+      if (buffer.get_length() > 0)
+        {
+          send(socket_to_send(i), buffer.get_data(), buffer.get_length());
+          buffer.reset_write_head();
+          flushed = true;
+        }
+    }
+  if (flushed)
+    n_flushes++;
+}
+
+
 void Player::send_to(int player,const octetStream& o,bool donthash) const
 { 
   TimeScope ts(comm_stats["Sending directly"].add(o));
-  int socket = socket_to_send(player);
-  o.Send(socket);
+  if (coalesce)
+    buffer_send(player, o);
+  else
+    o.Send(socket_to_send(player));
   if (!donthash)
-    { blk_SHA1_Update(&ctx,o.get_data(),o.get_length()); }
+    { hash.update(o); }
   sent += o.get_length();
 }
 
 
 void Player::send_all(const octetStream& o,bool donthash) const
 {
-  TimeScope ts(comm_stats["Sending to all"].add(o));
+  TimeScope ts(comm_stats["Sending to all"].add(o, nplayers - 1));
   for (int i=0; i<nplayers; i++)
      { if (i!=player_no)
-         { o.Send(sockets[i]); }
+         {
+           if (coalesce)
+             buffer_send(i, o);
+           else
+             o.Send(sockets[i]);
+         }
      }
   if (!donthash)
-    { blk_SHA1_Update(&ctx,o.get_data(),o.get_length()); }
+    { hash.update(o); }
   sent += o.get_length() * (num_players() - 1);
 }
 
@@ -257,16 +364,18 @@ void Player::send_all(const octetStream& o,bool donthash) const
 void Player::receive_player(int i,octetStream& o,bool donthash) const
 {
   TimeScope ts(timer);
+  flush();
   o.reset_write_head();
   o.Receive(sockets[i]);
   if (!donthash)
-    { blk_SHA1_Update(&ctx,o.get_data(),o.get_length()); }
+    { hash.update(o); }
 }
 
 
 void Player::exchange(int other, octetStream& o) const
 {
   TimeScope ts(comm_stats["Exchanging"].add(o));
+  flush();
   o.exchange(sockets[other], sockets[other]);
   sent += o.get_length();
 }
@@ -275,6 +384,7 @@ void Player::exchange(int other, octetStream& o) const
 void Player::pass_around(octetStream& o, int offset) const
 {
   TimeScope ts(comm_stats["Passing around"].add(o));
+  flush();
   o.exchange(sockets.at((my_num() + offset) % num_players()),
       sockets.at((my_num() + num_players() - offset) % num_players()));
   sent += o.get_length();
@@ -288,7 +398,8 @@ void Player::Broadcast_Receive(vector<octetStream>& o,bool donthash) const
 {
   if (o.size() != sockets.size())
     throw runtime_error("player numbers don't match");
-  TimeScope ts(comm_stats["Broadcasting"].add(o[player_no]));
+  TimeScope ts(comm_stats["Broadcasting"].add(o[player_no], nplayers - 1));
+  flush();
   for (int i=1; i<nplayers; i++)
     {
       int send_to = (my_num() + i) % num_players();
@@ -297,7 +408,7 @@ void Player::Broadcast_Receive(vector<octetStream>& o,bool donthash) const
     }
   if (!donthash)
     { for (int i=0; i<nplayers; i++)
-        { blk_SHA1_Update(&ctx,o[i].get_data(),o[i].get_length()); }
+        { hash.update(o[i]); }
     }
   sent += o[player_no].get_length() * (num_players() - 1);
 }
@@ -305,24 +416,33 @@ void Player::Broadcast_Receive(vector<octetStream>& o,bool donthash) const
 
 void Player::Check_Broadcast() const
 {
-  octet hashVal[HASH_SIZE];
   vector<octetStream> h(nplayers);
-  blk_SHA1_Final(hashVal,&ctx);
-  h[player_no].append(hashVal,HASH_SIZE);
+  hash.final(h[player_no]);
 
-  Broadcast_Receive(h,true);
+  if (coalesce)
+    {
+      // goes out together with anything else pending
+      for (int i=0; i<nplayers; i++)
+        if (i!=player_no)
+          buffer_send(i, h[player_no]);
+      for (int i=0; i<nplayers; i++)
+        if (i!=player_no)
+          receive_player(i, h[i], true);
+    }
+  else
+    Broadcast_Receive(h,true);
   for (int i=0; i<nplayers; i++)
     { if (i!=player_no)
         { if (!h[i].equals(h[player_no]))
 	    { throw broadcast_invalid(); }
         }
     }
-  blk_SHA1_Init(&ctx);
 }
 
 
 void Player::wait_for_available(vector<int>& players, vector<int>& result) const
 {
+  flush();
   fd_set rfds;
   FD_ZERO(&rfds);
   int highest = 0;
@@ -397,7 +517,7 @@ void ThreadPlayer::wait_receive(int i, octetStream& o, bool donthash) const
 {
   receivers[i]->wait(o);
   if (!donthash)
-    { blk_SHA1_Update(&ctx,o.get_data(),o.get_length()); }
+    { hash.update(o); }
 }
 
 void ThreadPlayer::receive_player(int i, octetStream& o, bool donthash) const
@@ -414,7 +534,7 @@ void ThreadPlayer::send_all(const octetStream& o,bool donthash) const
      }
 
   if (!donthash)
-    { blk_SHA1_Update(&ctx,o.get_data(),o.get_length()); }
+    { hash.update(o); }
 
   for (int i = 0; i < nplayers; i++)
     if (i != player_no)
@@ -422,6 +542,365 @@ void ThreadPlayer::send_all(const octetStream& o,bool donthash) const
 }
 
 
+AsyncPlayer::AsyncPlayer(const Names& Nms, int id_base) :
+    Player(Nms, id_base), receive_waiters(Nms.num_players())
+{
+  vector<int> all_sockets = sockets;
+  all_sockets.push_back(send_to_self_socket);
+  loop = new EventLoop(all_sockets);
+}
+
+AsyncPlayer::~AsyncPlayer()
+{
+  if (loop->n_calls > 0)
+    cerr << "Sent " << loop->n_messages << " messages in " << loop->n_calls
+        << " calls" << endl;
+  delete loop;
+}
+
+void AsyncPlayer::send_all(const octetStream& o, bool donthash) const
+{
+  TimeScope ts(comm_stats["Sending to all"].add(o, nplayers - 1));
+  for (int i = 0; i < nplayers; i++)
+    if (i != player_no)
+      loop->send(sockets[i], o, waiter.expect());
+  if (!donthash)
+    { hash.update(o); }
+  waiter.wait();
+  sent += o.get_length() * (num_players() - 1);
+}
+
+void AsyncPlayer::send_to(int player, const octetStream& o, bool donthash) const
+{
+  TimeScope ts(comm_stats["Sending directly"].add(o));
+  loop->send(socket_to_send(player), o, waiter.expect());
+  if (!donthash)
+    { hash.update(o); }
+  waiter.wait();
+  sent += o.get_length();
+}
+
+void AsyncPlayer::receive_player(int i, octetStream& o, bool donthash) const
+{
+  request_receive(i, o);
+  wait_receive(i, o, donthash);
+}
+
+void AsyncPlayer::request_receive(int i, octetStream& o) const
+{
+  loop->receive(sockets[i], o, receive_waiters[i].expect());
+}
+
+void AsyncPlayer::wait_receive(int i, octetStream& o, bool donthash) const
+{
+  TimeScope ts(timer);
+  receive_waiters[i].wait();
+  if (!donthash)
+    { hash.update(o); }
+}
+
+void AsyncPlayer::exchange(int other, octetStream& o) const
+{
+  TimeScope ts(comm_stats["Exchanging"].add(o));
+  loop->send(sockets[other], o, waiter.expect());
+  loop->receive(sockets[other], buffer, waiter.expect());
+  waiter.wait();
+  sent += o.get_length();
+  o.swap(buffer);
+}
+
+void AsyncPlayer::pass_around(octetStream& o, int offset) const
+{
+  TimeScope ts(comm_stats["Passing around"].add(o));
+  loop->send(sockets.at((my_num() + offset) % num_players()), o,
+      waiter.expect());
+  loop->receive(sockets.at((my_num() + num_players() - offset) % num_players()),
+      buffer, waiter.expect());
+  waiter.wait();
+  sent += o.get_length();
+  o.swap(buffer);
+}
+
+// No need to take turns because sending and receiving run concurrently
+void AsyncPlayer::Broadcast_Receive(vector<octetStream>& o, bool donthash) const
+{
+  if (o.size() != sockets.size())
+    throw runtime_error("player numbers don't match");
+  TimeScope ts(comm_stats["Broadcasting"].add(o[player_no], nplayers - 1));
+  for (int i = 0; i < nplayers; i++)
+    if (i != player_no)
+      {
+        loop->receive(sockets[i], o[i], waiter.expect());
+        loop->send(sockets[i], o[player_no], waiter.expect());
+      }
+  waiter.wait();
+  if (!donthash)
+    { for (int i=0; i<nplayers; i++)
+        { hash.update(o[i]); }
+    }
+  sent += o[player_no].get_length() * (num_players() - 1);
+}
+
+
+ShmPlayer::ShmPlayer(const Names& Nms, int id_base) :
+    Player(Nms.my_num(), Nms.num_players()), incoming(Nms.num_players()),
+    outgoing(Nms.num_players()), pending(Nms.num_players())
+{
+  if (not Nms.is_shared_memory())
+    throw runtime_error("ShmPlayer needs names for shared memory");
+  // create all incoming rings first so nobody waits for anybody else
+  for (int i = 0; i < nplayers; i++)
+    {
+      incoming[i] = new ShmRing;
+      incoming[i]->create(ring_name(Nms, id_base, i, player_no));
+    }
+  for (int i = 0; i < nplayers; i++)
+    {
+      string name = ring_name(Nms, id_base, player_no, i);
+      fprintf(stderr, "Attaching to shared memory %s\n", name.c_str());
+      outgoing[i] = new ShmRing;
+      outgoing[i]->attach(name);
+    }
+  for (int i = 0; i < nplayers; i++)
+    incoming[i]->wait_attached();
+}
+
+ShmPlayer::~ShmPlayer()
+{
+  // the other side might have stopped reading
+  try
+    {
+      ShmWaiter waiter("pending messages");
+      while (not progress())
+        waiter.wait();
+    }
+  catch (exception& e)
+    {
+      cerr << "Could not send all messages: " << e.what() << endl;
+    }
+  for (int i = 0; i < nplayers; i++)
+    {
+      delete incoming[i];
+      delete outgoing[i];
+    }
+}
+
+string ShmPlayer::ring_name(const Names& Nms, int id_base, int from, int to) const
+{
+  stringstream ss;
+  ss << "/spdz-" << Nms.get_portnum_base() << "-" << hex << id_base << dec
+      << "-" << from << "-" << to;
+  return ss.str();
+}
+
+void ShmPlayer::queue(int player, const octet* data, size_t length) const
+{
+  // the read head marks what has been written to the ring
+  octetStream& buffer = pending[player];
+  if (buffer.done())
+    {
+      buffer.reset_write_head();
+      size_t n = outgoing[player]->write(data, length);
+      data += n;
+      length -= n;
+    }
+  if (length > 0)
+    buffer.append(data, length);
+}
+
+bool ShmPlayer::progress() const
+{
+  bool done = true;
+  for (int i = 0; i < nplayers; i++)
+    {
+      octetStream& buffer = pending[i];
+      if (not buffer.done())
+        {
+          buffer.consume(outgoing[i]->write(buffer.get_data() + buffer.get_ptr(),
+              buffer.left()));
+          done &= buffer.done();
+        }
+    }
+  return done;
+}
+
+void ShmPlayer::send_message(int player, const octetStream& o) const
+{
+  octet blen[LENGTH_SIZE];
+  encode_length(blen, o.get_length(), LENGTH_SIZE);
+  queue(player, blen, LENGTH_SIZE);
+  queue(player, o.get_data(), o.get_length());
+  sent_amount += LENGTH_SIZE + o.get_length();
+  sent_counter++;
+}
+
+void ShmPlayer::receive_message(int player, octetStream& o) const
+{
+  ShmRing& ring = *incoming[player];
+  ShmWaiter waiter("shared memory");
+  octet blen[LENGTH_SIZE];
+  size_t received = 0;
+  while (received < LENGTH_SIZE)
+    {
+      size_t n = ring.read(blen + received, LENGTH_SIZE - received);
+      received += n;
+      if (n == 0)
+        {
+          progress();
+          waiter.wait();
+        }
+    }
+  size_t length = decode_length(blen, LENGTH_SIZE);
+  o.reset_write_head();
+  o.resize(length);
+  received = 0;
+  while (received < length)
+    {
+      size_t n = ring.read(o.data + received, length - received);
+      received += n;
+      if (n == 0)
+        {
+          progress();
+          waiter.wait();
+        }
+      else
+        waiter.reset();
+    }
+  o.len = length;
+}
+
+void ShmPlayer::send_all(const octetStream& o, bool donthash) const
+{
+  TimeScope ts(comm_stats["Sending to all"].add(o, nplayers - 1));
+  for (int i = 0; i < nplayers; i++)
+    if (i != player_no)
+      send_message(i, o);
+  if (!donthash)
+    { hash.update(o); }
+  sent += o.get_length() * (num_players() - 1);
+}
+
+void ShmPlayer::send_to(int player, const octetStream& o, bool donthash) const
+{
+  TimeScope ts(comm_stats["Sending directly"].add(o));
+  send_message(player, o);
+  if (!donthash)
+    { hash.update(o); }
+  sent += o.get_length();
+}
+
+void ShmPlayer::receive_player(int i, octetStream& o, bool donthash) const
+{
+  TimeScope ts(timer);
+  receive_message(i, o);
+  if (!donthash)
+    { hash.update(o); }
+}
+
+void ShmPlayer::exchange(int other, octetStream& o) const
+{
+  TimeScope ts(comm_stats["Exchanging"].add(o));
+  send_message(other, o);
+  receive_message(other, o);
+  sent += o.get_length();
+}
+
+void ShmPlayer::pass_around(octetStream& o, int offset) const
+{
+  TimeScope ts(comm_stats["Passing around"].add(o));
+  send_message((my_num() + offset) % num_players(), o);
+  receive_message((my_num() + num_players() - offset) % num_players(), o);
+  sent += o.get_length();
+}
+
+// No need to take turns because sending does not block
+void ShmPlayer::Broadcast_Receive(vector<octetStream>& o, bool donthash) const
+{
+  if ((int)o.size() != nplayers)
+    throw runtime_error("player numbers don't match");
+  TimeScope ts(comm_stats["Broadcasting"].add(o[player_no], nplayers - 1));
+  for (int i = 0; i < nplayers; i++)
+    if (i != player_no)
+      send_message(i, o[player_no]);
+  for (int i = 0; i < nplayers; i++)
+    if (i != player_no)
+      receive_message(i, o[i]);
+  if (!donthash)
+    { for (int i=0; i<nplayers; i++)
+        { hash.update(o[i]); }
+    }
+  sent += o[player_no].get_length() * (num_players() - 1);
+}
+
+
+ChannelPlayer::ChannelPlayer(ChannelMux& mux, int channel) :
+    Player(mux.my_num(), mux.num_players()), mux(mux), channel(channel)
+{
+}
+
+void ChannelPlayer::send_all(const octetStream& o, bool donthash) const
+{
+  TimeScope ts(comm_stats["Sending to all"].add(o, nplayers - 1));
+  for (int i = 0; i < nplayers; i++)
+    if (i != player_no)
+      mux.send(i, channel, o);
+  if (!donthash)
+    { hash.update(o); }
+  sent += o.get_length() * (num_players() - 1);
+}
+
+void ChannelPlayer::send_to(int player, const octetStream& o, bool donthash) const
+{
+  TimeScope ts(comm_stats["Sending directly"].add(o));
+  mux.send(player, channel, o);
+  if (!donthash)
+    { hash.update(o); }
+  sent += o.get_length();
+}
+
+void ChannelPlayer::receive_player(int i, octetStream& o, bool donthash) const
+{
+  TimeScope ts(timer);
+  mux.receive(i, channel, o);
+  if (!donthash)
+    { hash.update(o); }
+}
+
+void ChannelPlayer::exchange(int other, octetStream& o) const
+{
+  TimeScope ts(comm_stats["Exchanging"].add(o));
+  mux.send(other, channel, o);
+  mux.receive(other, channel, o);
+  sent += o.get_length();
+}
+
+void ChannelPlayer::pass_around(octetStream& o, int offset) const
+{
+  TimeScope ts(comm_stats["Passing around"].add(o));
+  mux.send((my_num() + offset) % num_players(), channel, o);
+  mux.receive((my_num() + num_players() - offset) % num_players(), channel, o);
+  sent += o.get_length();
+}
+
+// Sending does not block because the other side receives on a separate thread
+void ChannelPlayer::Broadcast_Receive(vector<octetStream>& o, bool donthash) const
+{
+  if ((int)o.size() != nplayers)
+    throw runtime_error("player numbers don't match");
+  TimeScope ts(comm_stats["Broadcasting"].add(o[player_no], nplayers - 1));
+  for (int i = 0; i < nplayers; i++)
+    if (i != player_no)
+      mux.send(i, channel, o[player_no]);
+  for (int i = 0; i < nplayers; i++)
+    if (i != player_no)
+      mux.receive(i, channel, o[i]);
+  if (!donthash)
+    { for (int i=0; i<nplayers; i++)
+        { hash.update(o[i]); }
+    }
+  sent += o[player_no].get_length() * (num_players() - 1);
+}
+
 TwoPartyPlayer::TwoPartyPlayer(const Names& Nms, int other_player, int id) :
         PlayerBase(Nms.my_num()), other_player(other_player)
 {
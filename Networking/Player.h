@@ -19,9 +19,12 @@ using namespace std;
 #include "Tools/octetStream.h"
 #include "Networking/sockets.h"
 #include "Networking/ServerSocket.h"
-#include "Tools/sha1.h"
+#include "Networking/BroadcastHash.h"
 #include "Networking/Receiver.h"
 #include "Networking/Sender.h"
+#include "Networking/EventLoop.h"
+#include "Networking/ShmRing.h"
+#include "Networking/ChannelMux.h"
 
 typedef vector<octet> public_signing_key;
 typedef vector<octet> secret_signing_key;
@@ -51,16 +54,22 @@ class Names
 
   CommsecKeysPackage *keys;
 
+  // parties on the same host using ShmPlayer
+  bool shared_memory;
+
   int default_port(int playerno) { return portnum_base + playerno; }
   void setup_ports();
 
   void setup_names(const char *servername, int my_port);
+  void setup_shared_memory(const char *servername);
 
   void setup_server();
 
   public:
 
   static const int DEFAULT_PORT = -1;
+  // host name prefix for ShmPlayer, followed by the number of players
+  static const char* SHARED_MEMORY_PREFIX;
 
   mutable ServerSocket* server;
 
@@ -80,7 +89,8 @@ class Names
     { init(player, pnb, hostsfile); }
   void set_keys( CommsecKeysPackage *keys );
 
-  Names() : nplayers(-1), portnum_base(-1), player_no(-1), keys(0), server(0) { ; }
+  Names() : nplayers(-1), portnum_base(-1), player_no(-1), keys(0),
+      shared_memory(false), server(0) { ; }
   Names(const Names& other);
   ~Names();
 
@@ -88,10 +98,12 @@ class Names
   int my_num() const { return player_no; }
   const string get_name(int i) const { return names[i]; }
   int get_portnum_base() const { return portnum_base; }
+  bool is_shared_memory() const { return shared_memory; }
 
   friend class PlayerBase;
   friend class Player;
   friend class TwoPartyPlayer;
+  friend class ConnectionBroker;
 };
 
 
@@ -118,10 +130,11 @@ public:
 
 struct CommStats
 {
-  size_t data, rounds;
+  size_t data, rounds, messages;
   Timer timer;
-  CommStats() : data(0), rounds(0) {}
-  Timer& add(const octetStream& os) { data += os.get_length(); rounds++; return timer; }
+  CommStats() : data(0), rounds(0), messages(0) {}
+  Timer& add(const octetStream& os, int n_messages = 1)
+    { data += os.get_length(); rounds++; messages += n_messages; return timer; }
 };
 
 class Player : public PlayerBase
@@ -134,7 +147,8 @@ protected:
 
   int nplayers;
 
-  mutable blk_SHA_CTX ctx;
+  // over everything not sent or received with donthash
+  mutable BroadcastHash hash;
 
   map<int,int> socket_players;
 
@@ -142,6 +156,18 @@ protected:
 
   mutable map<string,CommStats> comm_stats;
 
+  /* Messages waiting to be sent, one buffer per player.
+   * Only used if coalescing, and sent before anything else
+   * happens on the sockets. */
+  bool coalesce;
+  mutable vector<octetStream> send_buffers;
+  mutable size_t n_buffered, n_flushes;
+
+  void buffer_send(int player, const octetStream& o) const;
+
+  // for communication without sockets
+  Player(int my_num, int nplayers);
+
 public:
   // The offset is used for the multi-threaded call, to ensure different
   // portnum bases in each thread
@@ -153,15 +179,26 @@ public:
   int my_num() const { return player_no; }
   int socket(int i) const { return sockets[i]; }
 
+  // Sum of data and rounds over all kinds of communication so far
+  void get_comm_totals(size_t& data, size_t& rounds) const;
+
+  /* Hold back messages sent to a player until the next receiving,
+   * and then send them in one go. This saves system calls and
+   * packets if several messages go to the same player in a round.
+   * Only for the plain Player.
+   */
+  void set_coalescing(bool coalesce) { flush(); this->coalesce = coalesce; }
+  void flush() const;
+
   // Send/Receive data to/from player i 
   // 8-bit ints only (mainly for testing)
-  void send_int(int i,int a)  const    { send(sockets[i],a);    }
-  void receive_int(int i,int& a) const { receive(sockets[i],a); }
+  void send_int(int i,int a)  const    { flush(); send(sockets[i],a);    }
+  void receive_int(int i,int& a) const { flush(); receive(sockets[i],a); }
 
   // Send an octetStream to all other players 
   //   -- And corresponding receive
   virtual void send_all(const octetStream& o,bool donthash=false) const;
-  void send_to(int player,const octetStream& o,bool donthash=false) const;
+  virtual void send_to(int player,const octetStream& o,bool donthash=false) const;
   virtual void receive_player(int i,octetStream& o,bool donthash=false) const;
 
   // exchange data with minimal memory usage
@@ -175,10 +212,10 @@ public:
   /* Broadcast and Receive data to/from all players 
    *  - Assumes o[player_no] contains the thing broadcast by me
    */
-  void Broadcast_Receive(vector<octetStream>& o,bool donthash=false) const;
+  virtual void Broadcast_Receive(vector<octetStream>& o,bool donthash=false) const;
 
   /* Run Protocol To Verify Broadcast Is Correct
-   *     - Resets the blk_SHA_CTX at the same time
+   *     - Resets the hash at the same time
    */
   void Check_Broadcast() const;
 
@@ -208,6 +245,91 @@ public:
 };
 
 
+/* Multiplexes the communication with all players on one thread,
+ * so that sending and receiving to and from different players overlap
+ */
+class AsyncPlayer : public Player
+{
+  EventLoop* loop;
+  mutable EventWaiter waiter;
+  mutable vector<EventWaiter> receive_waiters;
+  mutable octetStream buffer;
+
+public:
+  AsyncPlayer(const Names& Nms,int id_base=0);
+  virtual ~AsyncPlayer();
+
+  void send_all(const octetStream& o,bool donthash=false) const;
+  void send_to(int player,const octetStream& o,bool donthash=false) const;
+  void receive_player(int i,octetStream& o,bool donthash=false) const;
+
+  void exchange(int other, octetStream& o) const;
+  void pass_around(octetStream& o, int offset = 1) const;
+
+  void Broadcast_Receive(vector<octetStream>& o,bool donthash=false) const;
+
+  void request_receive(int i, octetStream& o) const;
+  void wait_receive(int i, octetStream& o, bool donthash=false) const;
+};
+
+
+/* Communicates through shared memory rings instead of sockets, for
+ * parties on the same host using Names with host name shm://<players>.
+ * Data is copied straight between the rings and the octetStreams.
+ * Sending never blocks: whatever does not fit into a ring is kept
+ * back and written while waiting to receive.
+ */
+class ShmPlayer : public Player
+{
+  // incoming[i] from player i, outgoing[i] to player i
+  vector<ShmRing*> incoming, outgoing;
+  mutable vector<octetStream> pending;
+
+  string ring_name(const Names& Nms, int id_base, int from, int to) const;
+
+  void queue(int player, const octet* data, size_t length) const;
+  // write as much pending data as possible, true if all is written
+  bool progress() const;
+  void send_message(int player, const octetStream& o) const;
+  void receive_message(int player, octetStream& o) const;
+
+public:
+  ShmPlayer(const Names& Nms,int id_base=0);
+  virtual ~ShmPlayer();
+
+  void send_all(const octetStream& o,bool donthash=false) const;
+  void send_to(int player,const octetStream& o,bool donthash=false) const;
+  void receive_player(int i,octetStream& o,bool donthash=false) const;
+
+  void exchange(int other, octetStream& o) const;
+  void pass_around(octetStream& o, int offset = 1) const;
+
+  void Broadcast_Receive(vector<octetStream>& o,bool donthash=false) const;
+};
+
+
+/* Communicates over connections shared by all threads, using the
+ * thread number as channel. This avoids setting up a full mesh of
+ * connections per thread.
+ */
+class ChannelPlayer : public Player
+{
+  ChannelMux& mux;
+  int channel;
+
+public:
+  ChannelPlayer(ChannelMux& mux, int channel);
+
+  void send_all(const octetStream& o,bool donthash=false) const;
+  void send_to(int player,const octetStream& o,bool donthash=false) const;
+  void receive_player(int i,octetStream& o,bool donthash=false) const;
+
+  void exchange(int other, octetStream& o) const;
+  void pass_around(octetStream& o, int offset = 1) const;
+
+  void Broadcast_Receive(vector<octetStream>& o,bool donthash=false) const;
+};
+
 class TwoPartyPlayer : public PlayerBase
 {
 private:
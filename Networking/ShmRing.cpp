@@ -0,0 +1,153 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * ShmRing.cpp
+ *
+ */
+
+#include "Networking/ShmRing.h"
+#include "Exceptions/Exceptions.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <xmmintrin.h>
+#include <algorithm>
+#include <stdexcept>
+
+#define SHM_RING_MAGIC 0x53504452494e4731ULL
+
+struct ShmRing::Header
+{
+  uint64_t magic;
+  uint64_t capacity;
+  int attached;
+  // only ever increased, by the writer and the reader respectively,
+  // in separate cache lines to avoid false sharing
+  alignas(64) uint64_t written;
+  alignas(64) uint64_t read;
+};
+
+void ShmRing::map(int fd, size_t size)
+{
+  void* res = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (res == MAP_FAILED)
+    throw file_error(name);
+  header = (Header*)res;
+  buffer = (octet*)(header + 1);
+}
+
+void ShmRing::create(const string& name, size_t capacity)
+{
+  close();
+  // left over from a crashed run
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0)
+    throw file_error(name);
+  this->name = name;
+  if (ftruncate(fd, sizeof(Header) + capacity) != 0)
+    {
+      ::close(fd);
+      throw file_error(name);
+    }
+  map(fd, sizeof(Header) + capacity);
+  this->capacity = capacity;
+  // the rest is zero after ftruncate
+  header->capacity = capacity;
+  __atomic_store_n(&header->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+}
+
+void ShmRing::attach(const string& name)
+{
+  close();
+  ShmWaiter waiter(name.c_str());
+  while (true)
+    {
+      int fd = shm_open(name.c_str(), O_RDWR, 0);
+      struct stat s;
+      if (fd >= 0 and fstat(fd, &s) == 0
+          and s.st_size >= (off_t)sizeof(Header))
+        {
+          map(fd, s.st_size);
+          if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == SHM_RING_MAGIC
+              and sizeof(Header) + header->capacity == (size_t)s.st_size
+              and not __atomic_load_n(&header->attached, __ATOMIC_ACQUIRE))
+            break;
+          munmap(header, s.st_size);
+          header = 0;
+        }
+      else if (fd >= 0)
+        ::close(fd);
+      waiter.wait();
+    }
+  capacity = header->capacity;
+  __atomic_store_n(&header->attached, 1, __ATOMIC_RELEASE);
+}
+
+void ShmRing::wait_attached()
+{
+  ShmWaiter waiter(name.c_str());
+  while (not __atomic_load_n(&header->attached, __ATOMIC_ACQUIRE))
+    waiter.wait();
+  shm_unlink(name.c_str());
+  name.clear();
+}
+
+void ShmRing::close()
+{
+  if (header)
+    munmap(header, sizeof(Header) + capacity);
+  header = 0;
+  buffer = 0;
+  // only the creator keeps the name until the other end attached
+  if (name.size() and capacity)
+    shm_unlink(name.c_str());
+  name.clear();
+  capacity = 0;
+}
+
+size_t ShmRing::write(const octet* data, size_t length)
+{
+  uint64_t written = header->written;
+  uint64_t read = __atomic_load_n(&header->read, __ATOMIC_ACQUIRE);
+  size_t n = min(length, capacity - (size_t)(written - read));
+  size_t pos = written % capacity;
+  size_t first = min(n, capacity - pos);
+  memcpy(buffer + pos, data, first);
+  memcpy(buffer, data + first, n - first);
+  __atomic_store_n(&header->written, written + n, __ATOMIC_RELEASE);
+  return n;
+}
+
+size_t ShmRing::read(octet* data, size_t length)
+{
+  uint64_t read = header->read;
+  uint64_t written = __atomic_load_n(&header->written, __ATOMIC_ACQUIRE);
+  size_t n = min(length, (size_t)(written - read));
+  size_t pos = read % capacity;
+  size_t first = min(n, capacity - pos);
+  memcpy(data, buffer + pos, first);
+  memcpy(data + first, buffer, n - first);
+  __atomic_store_n(&header->read, read + n, __ATOMIC_RELEASE);
+  return n;
+}
+
+void ShmWaiter::wait()
+{
+  if (rounds < 1000)
+    _mm_pause();
+  else if (rounds < 2000)
+    sched_yield();
+  else
+    {
+      usleep(50);
+      slept_us += 50;
+      if (slept_us > 300000000LL)
+        throw runtime_error(string("timeout waiting for ") + what);
+    }
+  rounds++;
+}
@@ -0,0 +1,73 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * ShmRing.h
+ *
+ */
+
+#ifndef NETWORKING_SHMRING_H_
+#define NETWORKING_SHMRING_H_
+
+#include "Networking/data.h"
+
+#include <stdint.h>
+#include <string>
+using namespace std;
+
+/*
+ * Byte ring for one direction between two processes on the same host,
+ * kept in a POSIX shared memory segment. There is exactly one writer
+ * and one reader, which only synchronize through the two positions.
+ * The reading end creates the segment, and the writing end attaches
+ * to it by name. The name is removed once both ends have it mapped,
+ * so nothing is left behind unless a party crashes during the setup.
+ */
+
+class ShmRing
+{
+  struct Header;
+
+  Header* header;
+  octet* buffer;
+  size_t capacity;
+  string name;
+
+  void map(int fd, size_t size);
+
+public:
+  static const size_t DEFAULT_CAPACITY = 1 << 22;
+
+  ShmRing() : header(0), buffer(0), capacity(0) {}
+  ~ShmRing() { close(); }
+
+  // Reading end, does not block
+  void create(const string& name, size_t capacity = DEFAULT_CAPACITY);
+  // Writing end, waits until the reading end has created the segment
+  void attach(const string& name);
+  // Reading end, waits for the writing end and removes the name
+  void wait_attached();
+  void close();
+
+  // Copy as much as possible without blocking and return how much
+  size_t write(const octet* data, size_t length);
+  size_t read(octet* data, size_t length);
+};
+
+/*
+ * Backoff for waiting on another process: spin briefly, then yield,
+ * then sleep. Throws after five minutes like the socket timeout.
+ */
+
+class ShmWaiter
+{
+  int rounds;
+  long long slept_us;
+  const char* what;
+
+public:
+  ShmWaiter(const char* what) : rounds(0), slept_us(0), what(what) {}
+  void wait();
+  void reset() { rounds = 0; slept_us = 0; }
+};
+
+#endif /* NETWORKING_SHMRING_H_ */
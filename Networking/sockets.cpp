@@ -6,6 +6,7 @@
 #include "Tools/time-func.h"
 
 #include <iostream>
+#include <sys/uio.h>
 using namespace std;
 
 void error(const char *str)
@@ -185,6 +186,39 @@ void receive(int socket,int& a)
 }
 
 
+void send(int socket, const octet* header, size_t header_len,
+    const octet* msg, size_t len)
+{
+  iovec iov[2] = {{(void*)header, header_len}, {(void*)msg, len}};
+  iovec* next = iov;
+  int n_iov = 2;
+  while (n_iov > 0)
+    {
+      ssize_t j = writev(socket, next, n_iov);
+      if (j < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          error("Send error - 3 ");
+        }
+      while (n_iov > 0 and (size_t)j >= next->iov_len)
+        {
+          j -= next->iov_len;
+          next++;
+          n_iov--;
+        }
+      if (n_iov > 0)
+        {
+          next->iov_base = (octet*)next->iov_base + j;
+          next->iov_len -= j;
+        }
+    }
+
+  sent_amount += header_len + len;
+  sent_counter++;
+}
+
+
 void send(int socket, size_t a, size_t len)
 {
   octet blen[len];
@@ -43,6 +43,10 @@ void receive(int socket,int& a);
 void send(int socket, size_t a, size_t len);
 void receive(int socket, size_t& a, size_t len);
 
+// Send a header and a message in one go if possible
+void send(int socket, const octet* header, size_t header_len,
+    const octet* msg, size_t len);
+
 void send_ack(int socket);
 int get_ack(int socket);
 
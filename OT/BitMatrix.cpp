@@ -10,6 +10,7 @@
 #include <mpirxx.h>
 
 #include "BitMatrix.h"
+#include "BitTranspose.h"
 #include "Math/gf2n.h"
 #include "Math/gfp.h"
 
@@ -488,8 +489,7 @@ void BitMatrix::randomize(int row, PRNG& G)
 
 void BitMatrix::transpose()
 {
-    for (size_t i = 0; i < squares.size(); i++)
-        squares[i].transpose();
+    BitTranspose::transpose(squares.data(), squares.size());
 }
 
 void BitMatrix::check_transpose(BitMatrix& dual)
@@ -607,8 +607,7 @@ void BitMatrixSlice::conditional_add(BitVector& conditions, BitMatrix& other, bo
 
 void BitMatrixSlice::transpose()
 {
-    for (size_t i = start; i < end; i++)
-        bm.squares[i].transpose();
+    BitTranspose::transpose(bm.squares.data() + start, end - start);
 }
 
 template <class T>
@@ -0,0 +1,93 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * Throughput of the bit matrix transpose engines, on matrices of
+ * different numbers of 128x128 squares as used in OT extension.
+ * Every engine is checked against the plain square-by-square transpose.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include "OT/BitMatrix.h"
+#include "OT/BitTranspose.h"
+#include "Tools/time-func.h"
+#include "Tools/ezOptionParser.h"
+
+using namespace std;
+
+int main(int argc, const char** argv) {
+    ez::ezOptionParser opt;
+    opt.add(
+          "1024", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Megabytes to transpose per engine and matrix size (default: 1024)", // Help description.
+          "-m", // Flag token.
+          "--megabytes" // Flag token.
+    );
+    opt.add(
+          "8,64,8192", // Default.
+          0, // Required?
+          -1, // Number of args expected.
+          ',', // Delimiter if expecting multiple args.
+          "Matrix sizes in 128x128 squares (default: 8,64,8192)", // Help description.
+          "-s", // Flag token.
+          "--squares" // Flag token.
+    );
+    opt.parse(argc, argv);
+
+    int megabytes;
+    vector<int> sizes;
+    opt.get("--megabytes")->getInt(megabytes);
+    opt.get("--squares")->getInts(sizes);
+
+    PRNG G;
+    G.ReSeed();
+
+    cout << "best engine: " << BitTranspose::name(BitTranspose::best()) << endl;
+    cout << setw(8) << "engine" << setw(10) << "squares" << setw(10) << "GB/s"
+            << endl;
+    for (auto size : sizes)
+    {
+        if (size <= 0)
+        {
+            cerr << "Matrix sizes have to be positive" << endl;
+            return 1;
+        }
+        BitMatrix original(size * 128), expected(size * 128);
+        original.randomize(G);
+        expected = original;
+        BitTranspose::transpose(expected.squares.data(), size,
+                BitTranspose::SQUARE);
+
+        for (int i = 0; i < BitTranspose::N_ENGINES; i++)
+        {
+            BitTranspose::Engine engine = BitTranspose::Engine(i);
+            if (not BitTranspose::available(engine))
+                continue;
+
+            BitMatrix matrix = original;
+            BitTranspose::transpose(matrix.squares.data(), size, engine);
+            if (matrix != expected)
+            {
+                cerr << "Wrong transpose with " << BitTranspose::name(engine)
+                        << endl;
+                return 1;
+            }
+
+            long long total = (long long) megabytes << 20;
+            long long bytes = (long long) size * sizeof(square128);
+            long long rounds = max(1LL, total / bytes);
+            Timer timer;
+            timer.start();
+            for (long long j = 0; j < rounds; j++)
+                BitTranspose::transpose(matrix.squares.data(), size, engine);
+            timer.stop();
+            cout << setw(8) << BitTranspose::name(engine) << setw(10) << size
+                    << setw(10) << fixed << setprecision(2)
+                    << 1e-9 * rounds * bytes / timer.elapsed() << endl;
+        }
+    }
+}
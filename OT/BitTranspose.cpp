@@ -0,0 +1,167 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * BitTranspose.cpp
+ *
+ */
+
+#include <immintrin.h>
+
+#include "BitTranspose.h"
+#include "BitMatrix.h"
+
+/*
+ * Swapping the bits whose column has bit j set with the bits whose row
+ * has bit j set, for all j, transposes the square. Each level pairs
+ * rows r and r + j and exchanges a masked part of their 64-bit words.
+ */
+static const long long level_masks[] = {
+    0x00000000FFFFFFFFLL, 0x0000FFFF0000FFFFLL, 0x00FF00FF00FF00FFLL,
+    0x0F0F0F0F0F0F0F0FLL, 0x3333333333333333LL, 0x5555555555555555LL,
+};
+
+__attribute__((target("avx2")))
+static void transpose_avx2(square128* squares)
+{
+    __m256i rows[128];
+    for (int i = 0; i < 128; i++)
+        rows[i] = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(squares[0].rows[i]),
+                squares[1].rows[i], 1);
+
+    // 64-bit halves of each square
+    __m256i low = _mm256_set_epi64x(0, -1, 0, -1);
+    for (int i = 0; i < 64; i++)
+    {
+        __m256i x = rows[i], y = rows[i + 64];
+        __m256i t = _mm256_and_si256(
+                _mm256_xor_si256(_mm256_srli_si256(x, 8), y), low);
+        rows[i + 64] = _mm256_xor_si256(y, t);
+        rows[i] = _mm256_xor_si256(x, _mm256_slli_si256(t, 8));
+    }
+
+    for (int level = 0; level < 6; level++)
+    {
+        int j = 32 >> level;
+        __m256i mask = _mm256_set1_epi64x(level_masks[level]);
+        for (int i = 0; i < 128; i += 2 * j)
+            for (int k = i; k < i + j; k++)
+            {
+                __m256i x = rows[k], y = rows[k + j];
+                __m256i t = _mm256_and_si256(
+                        _mm256_xor_si256(_mm256_srli_epi64(x, j), y), mask);
+                rows[k + j] = _mm256_xor_si256(y, t);
+                rows[k] = _mm256_xor_si256(x, _mm256_slli_epi64(t, j));
+            }
+    }
+
+    for (int i = 0; i < 128; i++)
+    {
+        squares[0].rows[i] = _mm256_castsi256_si128(rows[i]);
+        squares[1].rows[i] = _mm256_extracti128_si256(rows[i], 1);
+    }
+}
+
+// the AVX-512 intrinsics of some GCC versions trigger false positives
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+static void transpose_avx512(square128* squares)
+{
+    __m512i rows[128];
+    for (int i = 0; i < 128; i++)
+    {
+        __m512i row = _mm512_castsi128_si512(squares[0].rows[i]);
+        row = _mm512_inserti32x4(row, squares[1].rows[i], 1);
+        row = _mm512_inserti32x4(row, squares[2].rows[i], 2);
+        rows[i] = _mm512_inserti32x4(row, squares[3].rows[i], 3);
+    }
+
+    // 64-bit halves of each square, the masks select the low or high half
+    for (int i = 0; i < 64; i++)
+    {
+        __m512i x = rows[i], y = rows[i + 64];
+        __m512i t = _mm512_maskz_xor_epi64(0x55,
+                _mm512_maskz_unpackhi_epi64(0x55, x, x), y);
+        rows[i + 64] = _mm512_xor_si512(y, t);
+        rows[i] = _mm512_xor_si512(x, _mm512_maskz_unpacklo_epi64(0xAA, t, t));
+    }
+
+    for (int level = 0; level < 6; level++)
+    {
+        int j = 32 >> level;
+        __m512i mask = _mm512_set1_epi64(level_masks[level]);
+        for (int i = 0; i < 128; i += 2 * j)
+            for (int k = i; k < i + j; k++)
+            {
+                __m512i x = rows[k], y = rows[k + j];
+                __m512i t = _mm512_and_si512(
+                        _mm512_xor_si512(_mm512_srli_epi64(x, j), y), mask);
+                rows[k + j] = _mm512_xor_si512(y, t);
+                rows[k] = _mm512_xor_si512(x, _mm512_slli_epi64(t, j));
+            }
+    }
+
+    for (int i = 0; i < 128; i++)
+        for (int k = 0; k < 4; k++)
+            squares[k].rows[i] = _mm512_extracti32x4_epi32(rows[i], k);
+}
+
+#pragma GCC diagnostic pop
+
+bool BitTranspose::available(Engine engine)
+{
+    switch (engine)
+    {
+    case SQUARE:
+        return true;
+    case AVX2:
+        return __builtin_cpu_supports("avx2");
+    case AVX512:
+        return __builtin_cpu_supports("avx512f") and available(AVX2);
+    default:
+        return false;
+    }
+}
+
+BitTranspose::Engine BitTranspose::best()
+{
+    static Engine best = available(AVX512) ? AVX512 :
+            (available(AVX2) ? AVX2 : SQUARE);
+    return best;
+}
+
+const char* BitTranspose::name(Engine engine)
+{
+    switch (engine)
+    {
+    case SQUARE:
+        return "square";
+    case AVX2:
+        return "avx2";
+    case AVX512:
+        return "avx512";
+    default:
+        return "unknown";
+    }
+}
+
+void BitTranspose::transpose(square128* squares, size_t n)
+{
+    transpose(squares, n, best());
+}
+
+void BitTranspose::transpose(square128* squares, size_t n, Engine engine)
+{
+    size_t i = 0;
+    if (engine == AVX512)
+        for (; i + 4 <= n; i += 4)
+            transpose_avx512(squares + i);
+    if (engine >= AVX2)
+        for (; i + 2 <= n; i += 2)
+            transpose_avx2(squares + i);
+    for (; i < n; i++)
+        squares[i].transpose();
+}
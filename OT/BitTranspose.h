@@ -0,0 +1,37 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * BitTranspose.h
+ *
+ */
+
+#ifndef OT_BITTRANSPOSE_H_
+#define OT_BITTRANSPOSE_H_
+
+#include <stddef.h>
+
+union square128;
+
+/*
+ * Transposes many 128x128 squares at once. The AVX2 and AVX-512
+ * engines keep the same row of two or four squares in one register and
+ * swap blocks of halving size (Eklundh), so that every instruction
+ * works on several squares. The squares are processed in groups that
+ * fit into L1 cache. The engine is chosen at runtime from what the CPU
+ * supports, independently of the compiler flags.
+ */
+
+class BitTranspose
+{
+public:
+    enum Engine { SQUARE, AVX2, AVX512, N_ENGINES };
+
+    static bool available(Engine engine);
+    static Engine best();
+    static const char* name(Engine engine);
+
+    static void transpose(square128* squares, size_t n);
+    static void transpose(square128* squares, size_t n, Engine engine);
+};
+
+#endif /* OT_BITTRANSPOSE_H_ */
@@ -13,6 +13,7 @@
 #include <sstream>
 #include <fstream>
 #include <math.h>
+#include <sodium.h>
 
 template <class T, int N>
 class Triple
@@ -65,13 +66,13 @@ public:
             }
     }
 
-    void output(ostream& outputStream, int n = N, bool human = false)
+    void output(PrepFileWriter& outputFile, int n = N)
     {
         for (int i = 0; i < n; i++)
         {
-            a[i].output(outputStream, human);
-            b.output(outputStream, human);
-            c[i].output(outputStream, human);
+            outputFile.write(a[i]);
+            outputFile.write(b);
+            outputFile.write(c[i]);
         }
     }
 };
@@ -106,7 +107,7 @@ public:
                 T value = triple.byIndex(l,j);
                 T mac = value * generator.machine.get_mac_key<T>();
                 for (int i = 0; i < generator.nparties-1; i++)
-                    mac += ot_multipliers[i]->macs[l][iTriple * repeat + j];
+                    mac += generator.get_multiplier(ot_multipliers, i, iTriple).macs[l][iTriple * repeat + j];
                 Share<T>& share = this->byIndex(l,j);
                 share.set_share(value);
                 share.set_mac(mac);
@@ -120,6 +121,30 @@ public:
     }
 };
 
+/*
+ * Every OT thread for the same pair of parties needs its own base OTs.
+ * Thread 0 keeps the keys, which seed its extension directly. The other
+ * threads replace every key by BLAKE2b keyed with it on a label and the
+ * thread number. This keeps the choice bits, and both parties can do it
+ * with the keys they know.
+ */
+static void derive_base_key(BitVector& key, int w)
+{
+    if (w == 0)
+        return;
+    if (key.size_bytes() < crypto_generichash_KEYBYTES_MIN
+            or key.size_bytes() > crypto_generichash_KEYBYTES_MAX)
+        throw runtime_error("base OT key length not supported");
+    string domain = "OT thread base key";
+    octetStream label;
+    label.append((const octet*)domain.data(), domain.size());
+    label.store(w);
+    vector<octet> derived(key.size_bytes());
+    crypto_generichash(derived.data(), derived.size(), label.get_data(),
+            label.get_length(), key.get_ptr(), key.size_bytes());
+    memcpy(key.get_ptr(), derived.data(), derived.size());
+}
+
 /*
  * Copies the relevant base OTs from setup
  * N.B. setup must not be stored as it will be used by other threads
@@ -139,6 +164,13 @@ NPartyTripleGenerator::NPartyTripleGenerator(OTTripleSetup& setup,
     field_size = 128;
     nAmplify = machine.amplify ? N_AMPLIFY : 1;
     nPreampTriplesPerLoop = nTriplesPerLoop * nAmplify;
+    nChunkTriples = min(machine.ot_chunk, nTriplesPerLoop);
+    nChunks = DIV_CEIL(nTriplesPerLoop, nChunkTriples);
+    // bits in GF(2^n) don't use chunks
+    if (machine.generateBits and not machine.primeField)
+        nOTThreads = 1;
+    else
+        nOTThreads = machine.ot_threads;
 
     int n = nparties;
     //baseReceiverInput = machines[0]->baseReceiverInput;
@@ -146,9 +178,9 @@ NPartyTripleGenerator::NPartyTripleGenerator(OTTripleSetup& setup,
     //baseReceiverOutputs.resize(n-1);
     nbase = setup.get_nbase();
     baseReceiverInput.resize(nbase);
-    baseReceiverOutputs.resize(n - 1);
-    baseSenderInputs.resize(n - 1);
-    players.resize(n-1);
+    baseReceiverOutputs.resize((n - 1) * nOTThreads);
+    baseSenderInputs.resize((n - 1) * nOTThreads);
+    players.resize((n - 1) * nOTThreads);
 
     gf2n_long::init_field(128);
 
@@ -166,16 +198,28 @@ NPartyTripleGenerator::NPartyTripleGenerator(OTTripleSetup& setup,
         {
             baseReceiverInput.set_bit(j, (unsigned int)setup.get_base_receiver_input(j));
         }
-        baseReceiverOutputs[i] = setup.baseOTs[i]->receiver_outputs;
-        baseSenderInputs[i] = setup.baseOTs[i]->sender_inputs;
+        for (int w = 0; w < nOTThreads; w++)
+        {
+            int k = i * nOTThreads + w;
+            baseReceiverOutputs[k] = setup.baseOTs[i]->receiver_outputs;
+            baseSenderInputs[k] = setup.baseOTs[i]->sender_inputs;
+            for (int j = 0; j < nbase; j++)
+            {
+                derive_base_key(baseReceiverOutputs[k][j], w);
+                for (int l = 0; l < 2; l++)
+                    derive_base_key(baseSenderInputs[k][j][l], w);
+            }
 
-        // new TwoPartyPlayer with unique id for each thread + pair of players
-        if (my_num < other_player)
-            id = (thread_num+1)*n*n + my_num*n + other_player;
-        else
-            id = (thread_num+1)*n*n + other_player*n + my_num;
-        players[i] = new TwoPartyPlayer(names, other_player, id);
-        cout << "Set up with player " << other_player << " in thread " << thread_num << " with id " << id << endl;
+            // new TwoPartyPlayer with unique id for each thread + pair of players
+            int base = (thread_num * nOTThreads + w + 1) * n * n;
+            if (my_num < other_player)
+                id = base + my_num*n + other_player;
+            else
+                id = base + other_player*n + my_num;
+            players[k] = new TwoPartyPlayer(names, other_player, id);
+            cout << "Set up with player " << other_player << " in thread " << thread_num
+                    << " for OT thread " << w << " with id " << id << endl;
+        }
     }
 
     pthread_mutex_init(&mutex, 0);
@@ -201,11 +245,11 @@ void* run_ot_thread(void* ptr)
 template<class T>
 void NPartyTripleGenerator::generate()
 {
-    vector< OTMultiplier<T>* > ot_multipliers(nparties-1);
+    vector< OTMultiplier<T>* > ot_multipliers((nparties-1) * nOTThreads);
 
     timers["Generator thread"].start();
 
-    for (int i = 0; i < nparties-1; i++)
+    for (size_t i = 0; i < ot_multipliers.size(); i++)
     {
         ot_multipliers[i] = new OTMultiplier<T>(*this, i);
         pthread_mutex_lock(&ot_multipliers[i]->mutex);
@@ -222,15 +266,27 @@ void NPartyTripleGenerator::generate()
     ss << T::type_char() << "-P" << my_num;
     if (thread_num != 0)
         ss << "-" << thread_num;
-    ofstream outputFile;
+    PrepFileWriter outputFile;
     if (machine.output)
-        outputFile.open(ss.str().c_str());
+    {
+        // bits and checked triples come with MACs, other triples without
+        int tuple_length = (machine.generateBits ? 1 : 3)
+                * (machine.check ? Share<T>::size() : T::size());
+        uint64_t mac_key_id = 0;
+        if (machine.check)
+            mac_key_id = PrepFileHeader::get_mac_key_id(machine.get_mac_key<T>());
+        outputFile.open(ss.str(), PrepFileHeader::create<T>(tuple_length, mac_key_id));
+    }
+    if (machine.output and machine.stream_ahead)
+        stream.open(ss.str(), machine.stream_ahead);
 
     if (machine.generateBits)
     	generateBits(ot_multipliers, outputFile);
     else
     	generateTriples(ot_multipliers, outputFile);
 
+    outputFile.close();
+    stream.finish();
     timers["Generator thread"].stop();
     if (machine.output)
         cout << "Written " << nTriples << " outputs to " << ss.str() << endl;
@@ -238,7 +294,7 @@ void NPartyTripleGenerator::generate()
         cout << "Generated " << nTriples << " outputs" << endl;
 
     // wait for threads to finish
-    for (int i = 0; i < nparties-1; i++)
+    for (size_t i = 0; i < ot_multipliers.size(); i++)
     {
         pthread_mutex_unlock(&ot_multipliers[i]->mutex);
         pthread_join(ot_multipliers[i]->thread, NULL);
@@ -252,7 +308,7 @@ void NPartyTripleGenerator::generate()
 
 template<>
 void NPartyTripleGenerator::generateBits(vector< OTMultiplier<gf2n>* >& ot_multipliers,
-		ofstream& outputFile)
+		PrepFileWriter& outputFile)
 {
     PRNG share_prg;
     share_prg.ReSeed();
@@ -305,23 +361,24 @@ void NPartyTripleGenerator::generateBits(vector< OTMultiplier<gf2n>* >& ot_multi
 
         if (machine.output)
             for (int j = 0; j < nTriplesPerLoop; j++)
-                bits[j].output(outputFile, false);
+                outputFile.write(bits[j]);
+        flush_output(outputFile);
 
-        for (int i = 0; i < nparties-1; i++)
+        for (size_t i = 0; i < ot_multipliers.size(); i++)
             pthread_cond_signal(&ot_multipliers[i]->ready);
    }
 }
 
 template<>
 void NPartyTripleGenerator::generateBits(vector< OTMultiplier<gfp>* >& ot_multipliers,
-		ofstream& outputFile)
+		PrepFileWriter& outputFile)
 {
 	generateTriples(ot_multipliers, outputFile);
 }
 
 template<class T>
 void NPartyTripleGenerator::generateTriples(vector< OTMultiplier<T>* >& ot_multipliers,
-    ofstream& outputFile)
+    PrepFileWriter& outputFile)
 {
 	PRNG share_prg;
 	share_prg.ReSeed();
@@ -352,37 +409,44 @@ void NPartyTripleGenerator::generateTriples(vector< OTMultiplier<T>* >& ot_multi
         for (int j = 0; j < 2; j++)
             valueBits[j].randomize_blocks<T>(share_prg);
 
-        timers["OTs"].start();
-        for (int i = 0; i < nparties-1; i++)
-            pthread_cond_wait(&ot_multipliers[i]->ready, &ot_multipliers[i]->mutex);
-        timers["OTs"].stop();
-
-        for (int j = 0; j < nPreampTriplesPerLoop; j++)
+        // consume the OTs chunk by chunk while the rest is being extended
+        release(ot_multipliers);
+        for (int l = 0; l < nChunks; l++)
         {
-            T a(valueBits[0].get_int128(j));
-            T b(valueBits[1].get_int128(j / nAmplify));
-            T c = a * b;
-            timers["Triple computation"].start();
-            for (int i = 0; i < nparties-1; i++)
-            {
-                c += ot_multipliers[i]->c_output[j];
-            }
-            timers["Triple computation"].stop();
-            if (machine.amplify)
-            {
-                preampTriples[j/nAmplify].a[j%nAmplify] = a;
-                preampTriples[j/nAmplify].b = b;
-                preampTriples[j/nAmplify].c[j%nAmplify] = c;
-            }
-            else if (machine.output)
+            timers["OTs"].start();
+            wait_for_chunk(ot_multipliers, k, l);
+            timers["OTs"].stop();
+
+            int begin, size;
+            get_chunk(l, begin, size);
+            for (int j = begin * nAmplify; j < (begin + size) * nAmplify; j++)
             {
-                timers["Writing"].start();
-                a.output(outputFile, false);
-                b.output(outputFile, false);
-                c.output(outputFile, false);
-                timers["Writing"].stop();
+                T a(valueBits[0].get_int128(j));
+                T b(valueBits[1].get_int128(j / nAmplify));
+                T c = a * b;
+                timers["Triple computation"].start();
+                for (int i = 0; i < nparties-1; i++)
+                {
+                    c += get_multiplier(ot_multipliers, i, j / nAmplify).c_output[j];
+                }
+                timers["Triple computation"].stop();
+                if (machine.amplify)
+                {
+                    preampTriples[j/nAmplify].a[j%nAmplify] = a;
+                    preampTriples[j/nAmplify].b = b;
+                    preampTriples[j/nAmplify].c[j%nAmplify] = c;
+                }
+                else if (machine.output)
+                {
+                    timers["Writing"].start();
+                    outputFile.write(a);
+                    outputFile.write(b);
+                    outputFile.write(c);
+                    timers["Writing"].stop();
+                }
             }
         }
+        wait_for_triples(ot_multipliers, k + 1);
 
         if (machine.amplify)
         {
@@ -410,18 +474,19 @@ void NPartyTripleGenerator::generateTriples(vector< OTMultiplier<T>* >& ot_multi
                 for (int iTriple = 0; iTriple < nTriplesPerLoop; iTriple++)
                     amplifiedTriples[iTriple].to(valueBits, iTriple);
 
-                for (int i = 0; i < nparties-1; i++)
+                for (size_t i = 0; i < ot_multipliers.size(); i++)
                     pthread_cond_signal(&ot_multipliers[i]->ready);
                 timers["Authentication OTs"].start();
-                for (int i = 0; i < nparties-1; i++)
-                    pthread_cond_wait(&ot_multipliers[i]->ready, &ot_multipliers[i]->mutex);
+                release(ot_multipliers);
+                wait_for_macs(ot_multipliers, k + 1);
                 timers["Authentication OTs"].stop();
 
                 for (int iTriple = 0; iTriple < nTriplesPerLoop; iTriple++)
                 {
-                    uncheckedTriples[iTriple].from(amplifiedTriples[iTriple], ot_multipliers, iTriple, *this);
-
-                    if (!machine.check and machine.output)
+                    // without checking there are only MACs for one a and c
+                    if (machine.check)
+                        uncheckedTriples[iTriple].from(amplifiedTriples[iTriple], ot_multipliers, iTriple, *this);
+                    else if (machine.output)
                     {
                         timers["Writing"].start();
                         amplifiedTriples[iTriple].output(outputFile);
@@ -458,14 +523,16 @@ void NPartyTripleGenerator::generateTriples(vector< OTMultiplier<T>* >& ot_multi
             }
         }
 
-        for (int i = 0; i < nparties-1; i++)
+        flush_output(outputFile);
+
+        for (size_t i = 0; i < ot_multipliers.size(); i++)
             pthread_cond_signal(&ot_multipliers[i]->ready);
     }
 }
 
 template<>
 void NPartyTripleGenerator::generateBitsFromTriples(
-        vector< ShareTriple<gfp,2> >& triples, MAC_Check<gfp>& MC, ofstream& outputFile)
+        vector< ShareTriple<gfp,2> >& triples, MAC_Check<gfp>& MC, PrepFileWriter& outputFile)
 {
     vector< Share<gfp> > a_plus_b(nTriplesPerLoop), a_squared(nTriplesPerLoop);
     for (int i = 0; i < nTriplesPerLoop; i++)
@@ -485,34 +552,103 @@ void NPartyTripleGenerator::generateBitsFromTriples(
             continue;
         Share<gfp> bit = (triples[i].a[0] / root + one) / gfp(2);
         if (machine.output)
-            bit.output(outputFile, false);
+            outputFile.write(bit);
     }
 }
 
 template<>
 void NPartyTripleGenerator::generateBitsFromTriples(
-        vector< ShareTriple<gf2n,2> >& triples, MAC_Check<gf2n>& MC, ofstream& outputFile)
+        vector< ShareTriple<gf2n,2> >& triples, MAC_Check<gf2n>& MC, PrepFileWriter& outputFile)
 {
     throw how_would_that_work();
     // warning gymnastics
     triples[0];
     MC.number();
-    outputFile << "";
+    outputFile.is_open();
 }
 
 template <class T>
 void NPartyTripleGenerator::start_progress(vector< OTMultiplier<T>* >& ot_multipliers)
 {
-    for (int i = 0; i < nparties-1; i++)
+    for (size_t i = 0; i < ot_multipliers.size(); i++)
         pthread_cond_wait(&ot_multipliers[i]->ready, &ot_multipliers[i]->mutex);
     lock();
     signal();
     wait();
     gettimeofday(&last_lap, 0);
-    for (int i = 0; i < nparties-1; i++)
+    for (size_t i = 0; i < ot_multipliers.size(); i++)
         pthread_cond_signal(&ot_multipliers[i]->ready);
 }
 
+/*
+ * The OT threads only run while the generator does not hold their
+ * mutex, so it releases all of them for the phases where they should
+ * run in parallel and then waits for their counters. Waiting for the
+ * end of a phase leaves the mutexes locked with all OT threads waiting
+ * to be signalled.
+ */
+template <class T>
+void NPartyTripleGenerator::release(vector< OTMultiplier<T>* >& ot_multipliers)
+{
+    for (size_t i = 0; i < ot_multipliers.size(); i++)
+        pthread_mutex_unlock(&ot_multipliers[i]->mutex);
+}
+
+/*
+ * Chunk l of every loop is done by OT thread l % nOTThreads, which
+ * counts the chunks it has finished over all loops.
+ */
+template <class T>
+void NPartyTripleGenerator::wait_for_chunk(vector< OTMultiplier<T>* >& ot_multipliers,
+        int loop, int chunk)
+{
+    int w = chunk % nOTThreads;
+    int n_chunks = loop * get_n_chunks(w) + chunk / nOTThreads + 1;
+    for (int i = 0; i < nparties-1; i++)
+    {
+        OTMultiplier<T>& multiplier = *ot_multipliers[i * nOTThreads + w];
+        pthread_mutex_lock(&multiplier.mutex);
+        while (multiplier.n_chunks_done < n_chunks)
+            pthread_cond_wait(&multiplier.ready, &multiplier.mutex);
+        pthread_mutex_unlock(&multiplier.mutex);
+    }
+}
+
+template <class T>
+void NPartyTripleGenerator::wait_for_triples(vector< OTMultiplier<T>* >& ot_multipliers,
+        int n_loops)
+{
+    for (size_t i = 0; i < ot_multipliers.size(); i++)
+    {
+        pthread_mutex_lock(&ot_multipliers[i]->mutex);
+        while (ot_multipliers[i]->n_triples_done < n_loops)
+            pthread_cond_wait(&ot_multipliers[i]->ready, &ot_multipliers[i]->mutex);
+    }
+}
+
+template <class T>
+void NPartyTripleGenerator::wait_for_macs(vector< OTMultiplier<T>* >& ot_multipliers,
+        int n_loops)
+{
+    for (size_t i = 0; i < ot_multipliers.size(); i++)
+    {
+        pthread_mutex_lock(&ot_multipliers[i]->mutex);
+        while (ot_multipliers[i]->n_macs_done < n_loops)
+            pthread_cond_wait(&ot_multipliers[i]->ready, &ot_multipliers[i]->mutex);
+    }
+}
+
+void NPartyTripleGenerator::get_chunk(int i, int& begin, int& size) const
+{
+    begin = i * nChunkTriples;
+    size = min(nChunkTriples, nTriplesPerLoop - begin);
+}
+
+int NPartyTripleGenerator::get_n_chunks(int ot_thread) const
+{
+    return DIV_CEIL(nChunks - ot_thread, nOTThreads);
+}
+
 void NPartyTripleGenerator::print_progress(int k)
 {
     if (thread_num == 0 && my_num == 0)
@@ -532,6 +668,16 @@ void NPartyTripleGenerator::print_progress(int k)
     }
 }
 
+void NPartyTripleGenerator::flush_output(PrepFileWriter& outputFile)
+{
+    if (not stream.is_open())
+        return;
+    timers["Streaming"].start();
+    outputFile.flush();
+    stream.wait();
+    timers["Streaming"].stop();
+}
+
 void NPartyTripleGenerator::lock()
 {
     pthread_mutex_lock(&mutex);
@@ -7,6 +7,8 @@
 #include "OT/BaseOT.h"
 #include "Tools/random.h"
 #include "Tools/time-func.h"
+#include "Tools/PrepStream.h"
+#include "Tools/PrepFile.h"
 #include "Math/gfp.h"
 #include "Auth/MAC_Check.h"
 
@@ -36,17 +38,29 @@ class NPartyTripleGenerator
     pthread_mutex_t mutex;
     pthread_cond_t ready;
 
+    // only open if streaming to the online phase
+    PrepStreamWriter stream;
+
     template <class T>
-    void generateTriples(vector< OTMultiplier<T>* >& ot_multipliers, ofstream& outputFile);
+    void generateTriples(vector< OTMultiplier<T>* >& ot_multipliers, PrepFileWriter& outputFile);
     template <class T>
-    void generateBits(vector< OTMultiplier<T>* >& ot_multipliers, ofstream& outputFile);
+    void generateBits(vector< OTMultiplier<T>* >& ot_multipliers, PrepFileWriter& outputFile);
     template <class T, int N>
     void generateBitsFromTriples(vector<ShareTriple<T, N> >& triples,
-            MAC_Check<T>& MC, ofstream& outputFile);
+            MAC_Check<T>& MC, PrepFileWriter& outputFile);
 
     template <class T>
     void start_progress(vector< OTMultiplier<T>* >& ot_multipliers);
+    template <class T>
+    void release(vector< OTMultiplier<T>* >& ot_multipliers);
+    template <class T>
+    void wait_for_chunk(vector< OTMultiplier<T>* >& ot_multipliers, int loop, int chunk);
+    template <class T>
+    void wait_for_triples(vector< OTMultiplier<T>* >& ot_multipliers, int n_loops);
+    template <class T>
+    void wait_for_macs(vector< OTMultiplier<T>* >& ot_multipliers, int n_loops);
     void print_progress(int k);
+    void flush_output(PrepFileWriter& outputFile);
 
 public:
     // TwoPartyPlayer's for OTs, n-party Player for sacrificing
@@ -63,6 +77,9 @@ public:
     int field_size;
     int nAmplify;
     int nPreampTriplesPerLoop;
+    int nChunkTriples;
+    int nChunks;
+    int nOTThreads;
     int repeat[3];
     int nparties;
 
@@ -75,6 +92,17 @@ public:
     template <class T>
     void generate();
 
+    void get_chunk(int i, int& begin, int& size) const;
+    int get_n_chunks(int ot_thread) const;
+
+    // the OT thread for another party that computed a triple
+    template <class T>
+    OTMultiplier<T>& get_multiplier(vector< OTMultiplier<T>* >& ot_multipliers,
+            int i, int iTriple) const
+    {
+        return *ot_multipliers[i * nOTThreads + (iTriple / nChunkTriples) % nOTThreads];
+    }
+
     void lock();
     void unlock();
     void signal();
@@ -265,28 +265,28 @@ template <class T>
 void OTExtensionWithMatrix::hash_outputs(int nOTs)
 {
     //cout << "Hashing... " << flush;
-    octetStream os, h_os(HASH_SIZE);
-    square128 tmp;
-    MMO mmo;
+    const MMO& mmo = MMO::fixed_key();
 #ifdef OTEXT_TIMER
     timeval startv, endv;
     gettimeofday(&startv, NULL);
 #endif
 
-    for (int i = 0; i < nOTs / 128; i++)
+    // all rows of a matrix are consecutive blocks
+    int n_squares = nOTs / 128;
+    if (ot_role & SENDER)
     {
-        if (ot_role & SENDER)
-        {
-            tmp = senderOutputMatrices[0].squares[i];
-            tmp ^= baseReceiverInput;
-            senderOutputMatrices[0].squares[i].hash_row_wise<T>(mmo, senderOutputMatrices[0].squares[i]);
-            senderOutputMatrices[1].squares[i].hash_row_wise<T>(mmo, tmp);
-        }
-        if (ot_role & RECEIVER)
+        for (int i = 0; i < n_squares; i++)
         {
-            receiverOutputMatrix.squares[i].hash_row_wise<T>(mmo, receiverOutputMatrix.squares[i]);
+            senderOutputMatrices[1].squares[i] = senderOutputMatrices[0].squares[i];
+            senderOutputMatrices[1].squares[i] ^= baseReceiverInput;
         }
+        for (int j = 0; j < 2; j++)
+            mmo.hashBlocks<T>(senderOutputMatrices[j].squares.data(),
+                    senderOutputMatrices[j].squares.data(), n_squares * 128);
     }
+    if (ot_role & RECEIVER)
+        mmo.hashBlocks<T>(receiverOutputMatrix.squares.data(),
+                receiverOutputMatrix.squares.data(), n_squares * 128);
     //cout << "done.\n";
 #ifdef OTEXT_TIMER
     gettimeofday(&endv, NULL);
@@ -297,17 +297,20 @@ void OTExtensionWithMatrix::hash_outputs(int nOTs)
 }
 
 template <class T>
-void OTExtensionWithMatrix::reduce_squares(unsigned int nTriples, vector<T>& output)
+void OTExtensionWithMatrix::reduce_squares(unsigned int nTriples, vector<T>& output,
+        unsigned int offset)
 {
     if (receiverOutputMatrix.squares.size() < nTriples)
         throw invalid_length();
-    output.resize(nTriples);
+    // streaming callers size the output beforehand and write it in chunks
+    if (output.size() < offset + nTriples)
+        output.resize(offset + nTriples);
     for (unsigned int j = 0; j < nTriples; j++)
     {
         T c1, c2;
         receiverOutputMatrix.squares[j].to(c1);
         senderOutputMatrices[0].squares[j].to(c2);
-        output[j] = c1 - c2;
+        output[offset + j] = c1 - c2;
     }
 }
 
@@ -461,6 +464,6 @@ template void OTExtensionWithMatrix::expand<gfp>(int start, int slice);
 template void OTExtensionWithMatrix::expand_transposed<gf2n>();
 template void OTExtensionWithMatrix::expand_transposed<gfp>();
 template void OTExtensionWithMatrix::reduce_squares(unsigned int nTriples,
-        vector<gf2n>& output);
+        vector<gf2n>& output, unsigned int offset);
 template void OTExtensionWithMatrix::reduce_squares(unsigned int nTriples,
-        vector<gfp>& output);
+        vector<gfp>& output, unsigned int offset);
@@ -48,7 +48,8 @@ public:
     void transpose(int start, int slice);
     void setup_for_correlation(vector<BitMatrix>& baseSenderOutputs, BitMatrix& baseReceiverOutput);
     template <class T>
-    void reduce_squares(unsigned int nTriples, vector<T>& output);
+    void reduce_squares(unsigned int nTriples, vector<T>& output,
+            unsigned int offset = 0);
 
     void print(BitVector& newReceiverInput, int i = 0);
     template <class T>
@@ -19,7 +19,10 @@ OTMultiplier<T>::OTMultiplier(NPartyTripleGenerator& generator,
                 generator.baseSenderInputs[thread_num],
                 generator.baseReceiverOutputs[thread_num], BOTH, !generator.machine.check)
 {
-    c_output.resize(generator.nTriplesPerLoop);
+    c_output.resize(generator.nPreampTriplesPerLoop);
+    n_chunks_done = 0;
+    n_triples_done = 0;
+    n_macs_done = 0;
     pthread_mutex_init(&mutex, 0);
     pthread_cond_init(&ready, 0);
     thread = 0;
@@ -32,6 +35,14 @@ OTMultiplier<T>::~OTMultiplier()
     pthread_cond_destroy(&ready);
 }
 
+// copy 128-bit blocks [start, start + n) of source
+static void get_blocks(BitVector& dest, const BitVector& source, int start, int n)
+{
+    dest.resize(n * 128);
+    for (int i = 0; i < n; i++)
+        dest.set_int128(i, source.get_int128(start + i));
+}
+
 template<class T>
 void OTMultiplier<T>::multiply()
 {
@@ -63,7 +74,10 @@ void OTMultiplier<T>::multiply()
 template<class T>
 void OTMultiplier<T>::multiplyForTriples(OTExtensionWithMatrix& auth_ot_ext)
 {
-    auth_ot_ext.resize(generator.nPreampTriplesPerLoop * generator.field_size);
+    int nAmplify = generator.nAmplify;
+    // OT threads for the same party take turns with the chunks
+    int first_chunk = thread_num % generator.nOTThreads;
+    int step = generator.nOTThreads;
 
     // dummy input for OT correlator
     vector<BitVector> _;
@@ -72,31 +86,46 @@ void OTMultiplier<T>::multiplyForTriples(OTExtensionWithMatrix& auth_ot_ext)
 
     OTExtensionWithMatrix otCorrelator(0, 0, 0, 0, generator.players[thread_num],
             ___, __, _, BOTH, true);
-    otCorrelator.resize(128 * generator.nPreampTriplesPerLoop);
+    otCorrelator.resize(128 * generator.nChunkTriples * nAmplify);
+    BitVector aBits, bBits, macBits;
 
-    rot_ext.resize(generator.field_size * generator.nPreampTriplesPerLoop + 2 * 128);
-    
     pthread_mutex_lock(&mutex);
     pthread_cond_signal(&ready);
     pthread_cond_wait(&ready, &mutex);
 
     for (int i = 0; i < generator.nloops; i++)
     {
-        BitVector aBits = generator.valueBits[0];
-        //timers["Extension"].start();
-        rot_ext.extend<T>(generator.field_size * generator.nPreampTriplesPerLoop, aBits);
-        //timers["Extension"].stop();
+        // the matrices only ever hold one chunk, and the generator
+        // uses the finished chunks while the next one is extended
+        for (int l = first_chunk; l < generator.nChunks; l += step)
+        {
+            int begin, size;
+            generator.get_chunk(l, begin, size);
+            int nPreamp = size * nAmplify;
+            pthread_mutex_unlock(&mutex);
 
-        //timers["Correlation"].start();
-        otCorrelator.baseReceiverInput = aBits;
-        otCorrelator.setup_for_correlation(rot_ext.senderOutputMatrices, rot_ext.receiverOutputMatrix);
-        otCorrelator.correlate<T>(0, generator.nPreampTriplesPerLoop, generator.valueBits[1], false, generator.nAmplify);
-        //timers["Correlation"].stop();
+            get_blocks(aBits, generator.valueBits[0], begin * nAmplify, nPreamp);
+            get_blocks(bBits, generator.valueBits[1], begin, size);
+            //timers["Extension"].start();
+            rot_ext.extend<T>(generator.field_size * nPreamp, aBits);
+            //timers["Extension"].stop();
 
-        //timers["Triple computation"].start();
+            //timers["Correlation"].start();
+            otCorrelator.baseReceiverInput = aBits;
+            otCorrelator.setup_for_correlation(rot_ext.senderOutputMatrices, rot_ext.receiverOutputMatrix);
+            otCorrelator.correlate<T>(0, nPreamp, bBits, false, nAmplify);
+            //timers["Correlation"].stop();
 
-        otCorrelator.reduce_squares(generator.nPreampTriplesPerLoop, c_output);
+            //timers["Triple computation"].start();
+
+            otCorrelator.reduce_squares(nPreamp, c_output, begin * nAmplify);
+
+            pthread_mutex_lock(&mutex);
+            n_chunks_done++;
+            pthread_cond_signal(&ready);
+        }
 
+        n_triples_done++;
         pthread_cond_signal(&ready);
         pthread_cond_wait(&ready, &mutex);
 
@@ -105,14 +134,24 @@ void OTMultiplier<T>::multiplyForTriples(OTExtensionWithMatrix& auth_ot_ext)
             macs.resize(3);
             for (int j = 0; j < 3; j++)
             {
-                int nValues = generator.nTriplesPerLoop;
+                int repeat = 1;
                 if (generator.machine.check && (j % 2 == 0))
-                    nValues *= 2;
-                auth_ot_ext.expand<T>(0, nValues);
-                auth_ot_ext.correlate<T>(0, nValues, generator.valueBits[j], true);
-                auth_ot_ext.reduce_squares(nValues, macs[j]);
+                    repeat = 2;
+                macs[j].resize(generator.nTriplesPerLoop * repeat);
+                for (int l = first_chunk; l < generator.nChunks; l += step)
+                {
+                    int begin, size;
+                    generator.get_chunk(l, begin, size);
+                    int nValues = size * repeat;
+                    get_blocks(macBits, generator.valueBits[j], begin * repeat, nValues);
+                    auth_ot_ext.resize(nValues * generator.field_size);
+                    auth_ot_ext.expand<T>(0, nValues);
+                    auth_ot_ext.correlate<T>(0, nValues, macBits, true);
+                    auth_ot_ext.reduce_squares(nValues, macs[j], begin * repeat);
+                }
             }
 
+            n_macs_done++;
             pthread_cond_signal(&ready);
             pthread_cond_wait(&ready, &mutex);
         }
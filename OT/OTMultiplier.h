@@ -28,6 +28,10 @@ public:
     //OTExtensionWithMatrix* auth_ot_ext;
     vector<T> c_output;
     vector< vector<T> > macs;
+    // progress over all loops, protected by mutex
+    int n_chunks_done;
+    int n_triples_done;
+    int n_macs_done;
 
     pthread_t thread;
     pthread_mutex_t mutex;
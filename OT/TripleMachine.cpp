@@ -91,10 +91,38 @@ TripleMachine::TripleMachine(int argc, const char** argv) :
         "-B", // Flag token.
         "--bits" // Flag token.
     );
+    opt.add(
+        "1024", // Default.
+        0, // Required?
+        1, // Number of args expected.
+        0, // Delimiter if expecting multiple args.
+        "Triples per chunk of correlated OTs, bounds the memory of OT extension (default: 1024)", // Help description.
+        "-C", // Flag token.
+        "--ot-chunk" // Flag token.
+    );
+    opt.add(
+        "1", // Default.
+        0, // Required?
+        1, // Number of args expected.
+        0, // Delimiter if expecting multiple args.
+        "Threads with separate connections for the OTs with every other party (default: 1)", // Help description.
+        "-T", // Flag token.
+        "--ot-threads" // Flag token.
+    );
 
     parse_options(argc, argv);
 
     opt.get("-l")->getInt(nloops);
+    opt.get("-C")->getInt(ot_chunk);
+    if (ot_chunk <= 0)
+        throw runtime_error("OT chunk size has to be positive");
+    // every chunk runs its own extension with correlation check
+    if (ot_chunk < 128)
+        cerr << "Warning: OT chunks of " << ot_chunk << " triples spend most "
+                "of the time on the extension overhead" << endl;
+    opt.get("-T")->getInt(ot_threads);
+    if (ot_threads <= 0)
+        throw runtime_error("number of OT threads has to be positive");
     generateBits = opt.get("-B")->isSet;
     check = opt.get("-c")->isSet || generateBits;
     generateMACs = opt.get("-m")->isSet || check;
@@ -139,6 +167,7 @@ void TripleMachine::run()
     // do the base OTs
     OTTripleSetup setup(N[0], true);
     setup.setup();
+    check_ot_parameters(setup);
     setup.close_connections();
 
     vector<NPartyTripleGenerator*> generators(nthreads);
@@ -200,6 +229,28 @@ void TripleMachine::run()
         output_mac_keys();
 }
 
+void TripleMachine::check_ot_parameters(OTTripleSetup& setup)
+{
+    // chunks and OT threads determine what is sent to every other party
+    for (size_t i = 0; i < setup.players.size(); i++)
+    {
+        octetStream os;
+        os.store(ot_chunk);
+        os.store(ot_threads);
+        setup.players[i]->exchange(os);
+        int other_chunk, other_threads;
+        os.get(other_chunk);
+        os.get(other_threads);
+        if (other_chunk != ot_chunk or other_threads != ot_threads)
+            throw runtime_error("player "
+                    + to_string(setup.players[i]->other_player_num())
+                    + " uses " + to_string(other_chunk)
+                    + " triples per OT chunk and " + to_string(other_threads)
+                    + " OT threads instead of " + to_string(ot_chunk)
+                    + " and " + to_string(ot_threads));
+    }
+}
+
 void TripleMachine::output_mac_keys()
 {
     stringstream ss;
@@ -12,6 +12,8 @@
 #include "Math/gfp.h"
 #include "Tools/OfflineMachineBase.h"
 
+class OTTripleSetup;
+
 class TripleMachine : public OfflineMachineBase
 {
     gf2n mac_key2;
@@ -19,6 +21,8 @@ class TripleMachine : public OfflineMachineBase
 
 public:
     int nloops;
+    int ot_chunk;
+    int ot_threads;
     string prep_data_dir;
     bool generateMACs;
     bool amplify;
@@ -30,6 +34,8 @@ public:
 
     TripleMachine(int argc, const char** argv);
     void run();
+    // the OT options have to agree between all parties
+    void check_ot_parameters(OTTripleSetup& setup);
 
     template <class T>
     T get_mac_key();
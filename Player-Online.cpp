@@ -1,6 +1,7 @@
 // (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
 
 #include "Processor/Machine.h"
+#include "Networking/ConnectionBroker.h"
 #include "Math/Setup.h"
 #include "Tools/ezOptionParser.h"
 #include "Tools/Config.h"
@@ -59,7 +60,9 @@ int main(int argc, const char** argv)
           0, // Required?
           1, // Number of args expected.
           0, // Delimiter if expecting multiple args.
-          "Host where Server.x is running to coordinate startup (default: localhost). Ignored if --ip-file-name is used.", // Help description.
+          "Host where Server.x is running to coordinate startup (default: localhost). "
+          "shm://<number of players> for parties on this host communicating through shared memory without Server.x "
+          "(not with --direct, --parallel, or --check-batch). Ignored if --ip-file-name is used.", // Help description.
           "-h", // Flag token.
           "--hostname" // Flag token.
     );
@@ -79,7 +82,9 @@ int main(int argc, const char** argv)
           0, // Delimiter if expecting multiple args.
           "Where to obtain memory, new|old|empty (default: empty)\n\t"
             "new: copy from Player-Memory-P<i> file\n\t"
-            "old: reuse previous memory in Memory-P<i>\n\t"
+            "old: reuse previous memory in Memory-P<i>, which stores the raw representation "
+            "(plain for Mersenne primes, Montgomery otherwise), so files for "
+            "Mersenne primes written by older versions cannot be reused\n\t"
             "empty: create new empty memory", // Help description.
           "-m", // Flag token.
           "--memory" // Flag token.
@@ -138,6 +143,162 @@ int main(int argc, const char** argv)
           "-c", // Flag token.
           "--player-to-player-commsec" // Flag token.
     );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Print per-instruction cost (count, time, communication) at the end", // Help description.
+          "--profile" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Profile as with --profile and also write it as JSON to the given file", // Help description.
+          "--profile-json" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Execute every instruction through the opcode switch instead of pre-decoded handlers (for comparison)", // Help description.
+          "--switch-dispatch" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Map preprocessing data into memory instead of reading it, and prune it by recording the offset used", // Help description.
+          "--mmap-prep" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Wait for preprocessing data from an offline phase running at the same time with --stream", // Help description.
+          "--stream-prep" // Flag token.
+    );
+    opt.add(
+          "0", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Run at most this many tapes at once, in the order they are started (default: 0 for no limit). "
+          "Compile with more threads than this to balance uneven tapes.", // Help description.
+          "--max-running" // Flag token.
+    );
+    opt.add(
+          "1000", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Number of tuples claimed at once by threads with unknown offline data usage (default: 1000)", // Help description.
+          "--prep-chunk" // Flag token.
+    );
+    opt.add(
+          "10000", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Maximum number of tuples of one type fetched from the extension library at once (default: 10000). "
+          "Fetching starts small and doubles with every refill up to this.", // Help description.
+          "--ext-prefetch" // Flag token.
+    );
+    opt.add(
+          "0", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Check MACs in batches of this many openings on a background thread (default: 0 for checking at the end of every tape). "
+          "Not used with --direct or --parallel.", // Help description.
+          "--check-batch" // Flag token.
+    );
+    opt.add(
+          "0", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Maximum number of opened values waiting for the background MAC check (default: four batches)", // Help description.
+          "--check-pending" // Flag token.
+    );
+    opt.add(
+          "0", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Megabytes of opened values kept in memory per batch until the MAC check, "
+          "the rest goes to a temporary file in $TMPDIR (default: 0 for no limit). "
+          "There is one batch per thread and field, or with --check-batch one for every pending batch.", // Help description.
+          "--check-memory" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Send and receive to and from all players at once on one thread using epoll, instead of one player at a time", // Help description.
+          "--event-loop" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Hold back messages until receiving and send all messages for the same player at once "
+          "(only with single-threaded receiving)", // Help description.
+          "--coalesce" // Flag token.
+    );
+    opt.add(
+          "blake2b", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Hash for checking the consistency of broadcasts, sha1 or blake2b (default: blake2b). "
+          "All players have to use the same.", // Help description.
+          "--broadcast-hash" // Flag token.
+    );
+    opt.add(
+          "1", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Compare the broadcast hashes after every this many tapes in each thread "
+          "(default: 1, 0 for only at the end). Higher values save rounds but detect inconsistencies later.", // Help description.
+          "--broadcast-check" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Share one connection per player between all threads instead of "
+          "connecting every thread separately (not with shm://)", // Help description.
+          "--mux" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          0, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Take shared connections from a running connection-broker.x instead of "
+          "connecting (implies --mux, ignores --hostname and --ip-file-name, "
+          "not with --direct, --parallel, or --check-batch)", // Help description.
+          "--broker" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Unix domain socket of connection-broker.x, implies --broker "
+          "(default: /tmp/spdz-broker-<port number base>-<playernum>)", // Help description.
+          "--broker-socket" // Flag token.
+    );
 
     opt.parse(argc, argv);
 
@@ -184,8 +345,10 @@ int main(int argc, const char** argv)
       return 1;
     }
 
-    string memtype, hostname, ipFileName;
-    int lg2, lgp, pnbase, opening_sum, max_broadcast;
+    string memtype, hostname, ipFileName, profile_json, broadcast_hash;
+    string broker_socket;
+    int lg2, lgp, pnbase, opening_sum, max_broadcast, max_running, prep_chunk, ext_prefetch;
+    int check_batch, check_pending, check_memory, broadcast_check;
     int p2pcommsec;
     int my_port;
 
@@ -197,7 +360,19 @@ int main(int argc, const char** argv)
     opt.get("--ip-file-name")->getString(ipFileName);
     opt.get("--opening-sum")->getInt(opening_sum);
     opt.get("--max-broadcast")->getInt(max_broadcast);
+    opt.get("--max-running")->getInt(max_running);
+    opt.get("--prep-chunk")->getInt(prep_chunk);
+    opt.get("--ext-prefetch")->getInt(ext_prefetch);
+    opt.get("--check-batch")->getInt(check_batch);
+    opt.get("--check-pending")->getInt(check_pending);
+    opt.get("--check-memory")->getInt(check_memory);
+    opt.get("--broadcast-hash")->getString(broadcast_hash);
+    opt.get("--broadcast-check")->getInt(broadcast_check);
     opt.get("--player-to-player-commsec")->getInt(p2pcommsec);
+    opt.get("--profile-json")->getString(profile_json);
+    opt.get("--broker-socket")->getString(broker_socket);
+    if (opt.get("--broker")->isSet and broker_socket.empty())
+      broker_socket = ConnectionBroker::default_path(pnbase, playerno);
 
     ez::OptionGroup* mp_opt = opt.get("--my-port");
     if (mp_opt->isSet)
@@ -219,7 +394,13 @@ int main(int argc, const char** argv)
     }
 
     Names playerNames;
-    if (ipFileName.size() > 0) {
+    ConnectionBroker broker;
+    if (broker_socket.size() > 0) {
+      if (opt.get("--direct")->isSet or opt.get("--parallel")->isSet or check_batch)
+        throw runtime_error("--direct, --parallel, and --check-batch need "
+            "their own connections, not available with --broker");
+      broker.fetch(broker_socket, playerNames, playerno);
+    } else if (ipFileName.size() > 0) {
       if (my_port != Names::DEFAULT_PORT)
         throw runtime_error("cannot set port number when using IP file");
       playerNames.init(playerno, pnbase, ipFileName);
@@ -227,6 +408,19 @@ int main(int argc, const char** argv)
       playerNames.init(playerno, pnbase, my_port, hostname.c_str());
     }
     playerNames.set_keys(keys);
+    if (playerNames.is_shared_memory() and (opt.get("--direct")->isSet
+        or opt.get("--parallel")->isSet or check_batch))
+      throw runtime_error("--direct, --parallel, and --check-batch need "
+          "their own connections, not available with shared memory");
+
+    ChannelMux* mux = 0;
+    if (broker_socket.size() > 0 or opt.get("--mux")->isSet) {
+      if (playerNames.is_shared_memory())
+        throw runtime_error("cannot share connections with shared memory");
+      if (broker_socket.empty())
+        broker.connect(playerNames);
+      mux = new ChannelMux(broker.get_sockets(), playerno);
+    }
         
 #ifndef INSECURE
     try
@@ -234,7 +428,23 @@ int main(int argc, const char** argv)
     {
         Machine(playerno, playerNames, progname, memtype, lgp, lg2,
                 opt.get("--direct")->isSet, opening_sum, opt.get("--parallel")->isSet,
-                opt.get("--threads")->isSet, max_broadcast).run();
+                opt.get("--threads")->isSet, max_broadcast,
+                opt.get("--profile")->isSet, profile_json,
+                opt.get("--switch-dispatch")->isSet,
+                opt.get("--mmap-prep")->isSet,
+                opt.get("--stream-prep")->isSet, max_running, prep_chunk,
+                check_batch, check_pending, check_memory,
+                opt.get("--event-loop")->isSet,
+                opt.get("--coalesce")->isSet,
+                BroadcastHash::parse(broadcast_hash), broadcast_check, mux,
+                ext_prefetch).run();
+
+        if (mux) {
+            // the connections can only be reused if nothing is left on them
+            bool clean = mux->stop();
+            delete mux;
+            broker.release(clean);
+        }
 
         cerr << "Command line:";
         for (int i = 0; i < argc; i++)
@@ -9,22 +9,222 @@
 #include "Processor/InputTuple.h"
 #include "Processor/Data_Files.h"
 
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 bool BufferBase::rewind = false;
+bool BufferBase::use_mmap = false;
+bool BufferBase::streaming = false;
 
 
 void BufferBase::setup(ifstream* f, int length, string filename,
-        const char* type, const char* field)
+        const PrepFileHeader& expected, const char* type, const char* field)
 {
     file = f;
     tuple_length = length;
     data_type = type;
     field_type = field;
     this->filename = filename;
+    this->expected = expected;
+    data_start = 0;
+    // only preprocessing data comes with a header
+    header_checked = not expected.is_valid();
+    header_error.clear();
+    if (not streaming and not header_checked)
+        read_header();
+    read_start_offset();
+    if (streaming)
+    {
+        consumed.open(filename);
+        stream_pos = start_offset;
+        return;
+    }
+    if (use_mmap and header_error.empty())
+        map_file();
+    if (start_offset)
+        file->seekg(start_offset);
+}
+
+/*
+ * Files with a header are checked when opening, but problems only count
+ * when actually reading from the file. Without a header, the data starts
+ * at the beginning as before.
+ */
+void BufferBase::read_header()
+{
+    PrepFileHeader header;
+    if (not header.read(*file))
+    {
+        if (expected.requires_header() and file->peek() != EOF)
+            header_error = missing_header_error();
+        return;
+    }
+    data_start = PrepFileHeader::SIZE;
+    try
+    {
+        header.check(expected, filename);
+        struct stat s;
+        if (stat(filename.c_str(), &s) == 0)
+            header.check_size(s.st_size, filename);
+        if (not header.sealed)
+            cerr << filename << " has not been sealed, "
+                    << "maybe its producer has not finished" << endl;
+    }
+    catch (runtime_error& e)
+    {
+        header_error = e.what();
+    }
+}
+
+string BufferBase::missing_header_error()
+{
+    return "Invalid preprocessing data in " + filename + ": no header, "
+            + "data for this field from before the header was introduced "
+            + "is in Montgomery representation and has to be regenerated";
+}
+
+/*
+ * A streamed file might not exist yet when setting up, so the header is
+ * only checked before reading for the first time. Producers write it
+ * before any data.
+ */
+void BufferBase::check_stream_header()
+{
+    header_checked = true;
+    PrepFileHeader header;
+    if (not consumed.wait_for_size(filename, sizeof(header.magic)))
+        return;
+    file->clear();
+    if (not file->is_open())
+        file->open(filename.c_str(), ios::in | ios::binary);
+    file->read(header.magic, sizeof(header.magic));
+    if (not header.is_valid())
+    {
+        if (expected.requires_header())
+            throw runtime_error(missing_header_error());
+        return;
+    }
+    if (not consumed.wait_for_size(filename, PrepFileHeader::SIZE))
+        try_rewind();
+    file->clear();
+    file->seekg(0);
+    if (not header.read(*file))
+        throw file_error("IO problem when streaming from " + filename);
+    header.check(expected, filename);
+    data_start = PrepFileHeader::SIZE;
+    // positions so far have been relative to the beginning of the data
+    if (start_offset == 0)
+    {
+        start_offset = data_start;
+        stream_pos += data_start;
+    }
+}
+
+/*
+ * prune() in mmap mode only records how much of the file has been used
+ * in an offset file next to it. The offset only counts if the data file
+ * is still the same, otherwise it has been regenerated since. A streaming
+ * producer appends to the file and removes the offset file when starting
+ * afresh, so only the inode is compared in that case.
+ */
+void BufferBase::read_start_offset()
+{
+    start_offset = data_start;
+    if (stat(filename.c_str(), &file_stat) != 0)
+        return;
+    ifstream offset_file(offset_filename().c_str());
+    if (offset_file.fail())
+        return;
+    size_t offset, size;
+    long long mtime, inode;
+    offset_file >> offset >> size >> mtime >> inode;
+    bool changed = size != (size_t)file_stat.st_size
+            or mtime != (long long)file_stat.st_mtime;
+    if (offset_file.fail() or (changed and not streaming)
+            or inode != (long long)file_stat.st_ino or offset > size
+            or offset < data_start
+            or (tuple_length > 0 and (offset - data_start) % tuple_length != 0))
+    {
+        cerr << "Ignoring stale " << offset_filename() << endl;
+        return;
+    }
+    start_offset = offset;
+}
+
+void BufferBase::map_file()
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        // fall back to the stream, which fails when actually reading
+        return;
+    if (fstat(fd, &file_stat) == 0 and file_stat.st_size > 0)
+    {
+        void* res = mmap(0, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (res != MAP_FAILED)
+        {
+            madvise(res, file_stat.st_size, MADV_SEQUENTIAL);
+            mapped = (const char*)res;
+            mapped_size = file_stat.st_size;
+            mapped_pos = start_offset;
+        }
+    }
+    ::close(fd);
+}
+
+void BufferBase::unmap()
+{
+    if (mapped)
+        munmap((void*)mapped, mapped_size);
+    mapped = 0;
+    mapped_size = 0;
+    consumed.close();
+}
+
+void BufferBase::read_stream(char* read_buffer, int size_in_bytes)
+{
+    if (not header_checked)
+        check_stream_header();
+    int n_read = 0;
+    while (n_read < size_in_bytes)
+    {
+        long long end = stream_pos + size_in_bytes - n_read;
+        consumed.publish(end);
+        if (not consumed.wait_for_size(filename, end))
+            try_rewind();
+        // the file might not have existed when setting up
+        file->clear();
+        if (not file->is_open())
+            file->open(filename.c_str(), ios::in | ios::binary);
+        file->seekg(stream_pos);
+        file->read(read_buffer + n_read, size_in_bytes - n_read);
+        n_read += file->gcount();
+        stream_pos += file->gcount();
+        if (file->bad() or not file->is_open())
+            throw file_error("IO problem when streaming from " + filename);
+    }
 }
 
 void BufferBase::seekg(int pos)
 {
-    file->seekg(pos * tuple_length);
+    if (streaming)
+    {
+        // data might not be there yet, read_stream() waits for it
+        stream_pos = start_offset + (long long)pos * tuple_length;
+        consumed.publish(stream_pos);
+        next = BUFFER_SIZE;
+        return;
+    }
+
+    if (mapped)
+    {
+        mapped_pos = start_offset + (size_t)pos * tuple_length;
+        if (mapped_pos > mapped_size)
+            try_rewind();
+        return;
+    }
+
+    file->seekg(start_offset + (streamoff)pos * tuple_length);
     if (file->eof() || file->fail())
     {
         // let it go in case we don't need it anyway
@@ -36,16 +236,28 @@ void BufferBase::seekg(int pos)
 
 void BufferBase::try_rewind()
 {
-#ifndef INSECURE
     string type;
     if (field_type and data_type)
         type = (string)" of " + field_type + " " + data_type;
+#ifndef INSECURE
     throw not_enough_to_buffer(type);
 #endif
-    file->clear(); // unset EOF flag
-    file->seekg(0);
-    if (file->peek() == ifstream::traits_type::eof())
-        throw runtime_error("empty file: " + filename);
+    if (streaming)
+        // the producer has finished, and streamed data is not to be reused
+        throw not_enough_to_buffer(type);
+    if (mapped)
+    {
+        if (mapped_size <= start_offset)
+            throw runtime_error("empty file: " + filename);
+        mapped_pos = start_offset;
+    }
+    else
+    {
+        file->clear(); // unset EOF flag
+        file->seekg(start_offset);
+        if (file->peek() == ifstream::traits_type::eof())
+            throw runtime_error("empty file: " + filename);
+    }
     if (!rewind)
         cerr << "REWINDING - ONLY FOR BENCHMARKING" << endl;
     rewind = true;
@@ -54,6 +266,34 @@ void BufferBase::try_rewind()
 
 void BufferBase::prune()
 {
+    // the producer might still be appending, and files with a header
+    // stay as they were sealed, so only record the offset
+    size_t pos = streaming ? stream_pos : mapped_pos;
+    if (file and data_start and not mapped and not streaming)
+    {
+        streamoff file_pos = file->tellg();
+        if (file_pos < 0)
+            return;
+        pos = file_pos;
+    }
+    if (mapped or (streaming and file) or (file and data_start))
+    {
+        if (pos != start_offset)
+        {
+            cerr << "Pruning " << filename << " at offset " << pos << endl;
+            stat(filename.c_str(), &file_stat);
+            string tmp_name = offset_filename() + ".new";
+            ofstream tmp(tmp_name.c_str());
+            tmp << pos << " " << file_stat.st_size << " "
+                    << (long long)file_stat.st_mtime << " "
+                    << (long long)file_stat.st_ino << endl;
+            tmp.close();
+            rename(tmp_name.c_str(), offset_filename().c_str());
+            start_offset = pos;
+        }
+        return;
+    }
+
     if (file and file->tellg() != 0)
     {
         cerr << "Pruning " << filename << endl;
@@ -63,6 +303,8 @@ void BufferBase::prune()
         tmp.close();
         file->close();
         rename(tmp_name.c_str(), filename.c_str());
+        unlink(offset_filename().c_str());
+        start_offset = 0;
         file->open(filename.c_str(), ios::in | ios::binary);
     }
 }
@@ -73,6 +315,10 @@ void BufferBase::purge()
     {
         cerr << "Removing " << filename << endl;
         unlink(filename.c_str());
+        unlink(offset_filename().c_str());
+        unlink(prep_consumed_filename(filename).c_str());
+        unlink(prep_done_filename(filename).c_str());
+        unmap();
         file->close();
         file = 0;
     }
@@ -109,7 +355,15 @@ void Buffer<T, U>::read(char* read_buffer)
 {
     int size_in_bytes = T::size() * BUFFER_SIZE;
     int n_read = 0;
+    if (not header_error.empty())
+        throw runtime_error(header_error);
     timer.start();
+    if (streaming)
+    {
+        read_stream(read_buffer, size_in_bytes);
+        timer.stop();
+        return;
+    }
     do
     {
         file->read(read_buffer + n_read, size_in_bytes - n_read);
@@ -135,6 +389,17 @@ void Buffer<T, U>::read(char* read_buffer)
 template <class T, class U>
 void Buffer<T,U>::input(U& a)
 {
+    if (mapped)
+    {
+        // parse straight from the mapping, using the buffer as scratch space
+        if (mapped_pos + T::size() > mapped_size)
+            try_rewind();
+        buffer[0].assign(mapped + mapped_pos);
+        mapped_pos += T::size();
+        a = buffer[0];
+        return;
+    }
+
     if (next == BUFFER_SIZE)
     {
         fill_buffer();
@@ -161,7 +426,8 @@ void BufferHelper<U,V>::setup(DataFieldType field_type, string filename, int tup
 {
     files[field_type] = new ifstream(filename.c_str(), ios::in | ios::binary);
     get_buffer(field_type).setup(files[field_type], tuple_length, filename,
-            data_type, Data_Files::long_field_names[field_type]);
+            Data_Files::expected_header(field_type, tuple_length), data_type,
+            Data_Files::long_field_names[field_type]);
 }
 
 template<template<class T> class U, template<class T> class V>
@@ -170,6 +436,7 @@ void BufferHelper<U,V>::close()
     for (int i = 0; i < N_DATA_FIELD_TYPE; i++)
         if (files[i])
         {
+            get_buffer(DataFieldType(i)).unmap();
             files[i]->close();
             delete files[i];
         }
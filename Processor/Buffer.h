@@ -9,11 +9,14 @@
 #define PROCESSOR_BUFFER_H_
 
 #include <fstream>
+#include <sys/stat.h>
 using namespace std;
 
 #include "Math/Share.h"
 #include "Math/field_types.h"
 #include "Tools/time-func.h"
+#include "Tools/PrepStream.h"
+#include "Tools/PrepFile.h"
 
 #ifndef BUFFER_SIZE
 #define BUFFER_SIZE 101
@@ -24,6 +27,8 @@ class BufferBase
 {
 protected:
     static bool rewind;
+    static bool use_mmap;
+    static bool streaming;
 
     ifstream* file;
     int next;
@@ -33,18 +38,52 @@ protected:
     int tuple_length;
     string filename;
 
+    // Read-only mapping of the whole file, only if use_mmap is set
+    const char* mapped;
+    size_t mapped_size, mapped_pos;
+
+    // Header expected in the file and where the data starts after it,
+    // problems are only reported when reading
+    PrepFileHeader expected;
+    size_t data_start;
+    bool header_checked;
+    string header_error;
+
+    // Bytes used up by earlier runs, see prune()
+    size_t start_offset;
+    struct stat file_stat;
+
+    // Absolute position of the next read if streaming
+    long long stream_pos;
+    PrepStreamCounter consumed;
+
+    string offset_filename() { return filename + ".offset"; }
+    void read_header();
+    string missing_header_error();
+    void check_stream_header();
+    void read_start_offset();
+    void map_file();
+    void read_stream(char* read_buffer, int size_in_bytes);
+
 public:
     bool eof;
 
+    static void set_mmap(bool on) { use_mmap = on; }
+    static void set_streaming(bool on) { streaming = on; }
+
     BufferBase() : file(0), next(BUFFER_SIZE), data_type(0), field_type(0),
-            tuple_length(-1), eof(false) {}
-    void setup(ifstream* f, int length, string filename, const char* type = 0,
+            tuple_length(-1), mapped(0), mapped_size(0), mapped_pos(0),
+            data_start(0), header_checked(false), start_offset(0), file_stat(), stream_pos(0), eof(false) {}
+    void setup(ifstream* f, int length, string filename,
+            const PrepFileHeader& expected = PrepFileHeader(),
+            const char* type = 0,
             const char* field = 0);
     void seekg(int pos);
     bool is_up() { return file != 0; }
     void try_rewind();
     void prune();
     void purge();
+    void unmap();
 };
 
 
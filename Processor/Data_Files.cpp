@@ -16,6 +16,7 @@ const int Data_Files::tuple_size[N_DTYPE] = { 3, 2, 1, 2, 3, 3 };
 
 Lock Data_Files::tuple_lengths_lock;
 map<DataTag, int> Data_Files::tuple_lengths;
+uint64_t Data_Files::mac_key_ids[N_DATA_FIELD_TYPE];
 
 
 void DataPositions::set_num_players(int num_players)
@@ -42,6 +43,27 @@ void DataPositions::increase(const DataPositions& delta)
     }
 }
 
+void DataPositions::set_max(const DataPositions& other)
+{
+  if (inputs.size() != other.inputs.size())
+    throw invalid_length();
+  for (unsigned int field_type = 0; field_type < N_DATA_FIELD_TYPE; field_type++)
+    {
+      for (unsigned int dtype = 0; dtype < N_DTYPE; dtype++)
+        files[field_type][dtype] = max(files[field_type][dtype],
+            other.files[field_type][dtype]);
+      for (unsigned int j = 0; j < inputs.size(); j++)
+        inputs[j][field_type] = max(inputs[j][field_type],
+            other.inputs[j][field_type]);
+
+      map<DataTag, int>::const_iterator it;
+      const map<DataTag, int>& other_ext = other.extended[field_type];
+      for (it = other_ext.begin(); it != other_ext.end(); it++)
+        extended[field_type][it->first] = max(extended[field_type][it->first],
+            it->second);
+    }
+}
+
 void DataPositions::print_cost() const
 {
   ifstream file("cost");
@@ -75,6 +97,56 @@ void DataPositions::print_cost() const
 }
 
 
+DataPartition::DataPartition(const DataPositions& base, int n_threads,
+    int chunk_size) :
+    base(base), end(base), claimed(n_threads, DataPositions(base.inputs.size())),
+    n_threads(n_threads), chunk_size(chunk_size), n_running(0)
+{
+}
+
+int DataPartition::claim(int thread, int base_pos, int& n_claimed, int& end_pos)
+{
+  int start = base_pos + (n_claimed++ * n_threads + thread) * chunk_size;
+  end_pos = max(end_pos, start + chunk_size);
+  return start;
+}
+
+int DataPartition::claim_file(int thread, int field_type, int dtype)
+{
+  lock.lock();
+  int res = claim(thread, base.files[field_type][dtype],
+      claimed.at(thread).files[field_type][dtype], end.files[field_type][dtype]);
+  lock.unlock();
+  return res;
+}
+
+int DataPartition::claim_input(int thread, int player, int field_type)
+{
+  lock.lock();
+  int res = claim(thread, base.inputs[player][field_type],
+      claimed.at(thread).inputs[player][field_type], end.inputs[player][field_type]);
+  lock.unlock();
+  return res;
+}
+
+int DataPartition::claim_extended(int thread, int field_type, const DataTag& tag)
+{
+  lock.lock();
+  int res = claim(thread, base.extended[field_type][tag],
+      claimed.at(thread).extended[field_type][tag], end.extended[field_type][tag]);
+  lock.unlock();
+  return res;
+}
+
+DataPositions DataPartition::get_end()
+{
+  lock.lock();
+  DataPositions res = end;
+  lock.unlock();
+  return res;
+}
+
+
 int Data_Files::share_length(int field_type)
 {
   switch (field_type)
@@ -93,8 +165,31 @@ int Data_Files::tuple_length(int field_type, int dtype)
   return tuple_size[dtype] * share_length(field_type);
 }
 
+void Data_Files::set_mac_keys(const gfp& alphapi, const gf2n& alpha2i)
+{
+  mac_key_ids[DATA_MODP] = PrepFileHeader::get_mac_key_id(alphapi);
+  mac_key_ids[DATA_GF2N] = PrepFileHeader::get_mac_key_id(alpha2i);
+}
+
+PrepFileHeader Data_Files::expected_header(DataFieldType field_type, int tuple_length)
+{
+  // unknown for extended data that has not been used yet
+  tuple_length = max(tuple_length, 0);
+  switch (field_type)
+  {
+    case DATA_MODP:
+      return PrepFileHeader::create<gfp>(tuple_length, mac_key_ids[field_type]);
+    case DATA_GF2N:
+      return PrepFileHeader::create<gf2n>(tuple_length, mac_key_ids[field_type]);
+    default:
+      throw invalid_params();
+  }
+}
+
 Data_Files::Data_Files(int myn, int n, const string& prep_data_dir) :
-    usage(n), prep_data_dir(prep_data_dir)
+    usage(n), partition(0), partition_thread(0), partition_joined(false),
+    left(n),
+    prep_data_dir(prep_data_dir)
 {
   cerr << "Setting up Data_Files in: " << prep_data_dir << endl;
   num_players=n;
@@ -167,6 +262,67 @@ void Data_Files::seekg(DataPositions& pos)
   usage = pos;
 }
 
+void Data_Files::set_partition(DataPartition* partition, int thread)
+{
+  this->partition = partition;
+  partition_thread = thread;
+  partition_joined = false;
+  left = DataPositions(num_players);
+}
+
+void Data_Files::join_partition(DataPartition* partition)
+{
+  set_partition(partition, partition_thread);
+  partition_joined = true;
+}
+
+void Data_Files::leave_partition()
+{
+  DataPositions pos = usage;
+  pos.set_max(partition->get_end());
+  set_partition(0, partition_thread);
+  seekg(pos);
+}
+
+void Data_Files::next_file(int field_type, int dtype)
+{
+  int& n_left = left.files[field_type][dtype];
+  if (n_left == 0)
+    {
+      int start = partition->claim_file(partition_thread, field_type, dtype);
+      buffers[dtype].get_buffer(DataFieldType(field_type)).seekg(start);
+      n_left = partition->chunk_size;
+    }
+  n_left--;
+}
+
+void Data_Files::next_input(int player, int field_type)
+{
+  int& n_left = left.inputs[player][field_type];
+  if (n_left == 0)
+    {
+      int start = partition->claim_input(partition_thread, player, field_type);
+      if (player == my_num)
+        my_input_buffers.get_buffer(DataFieldType(field_type)).seekg(start);
+      else
+        input_buffers[player].get_buffer(DataFieldType(field_type)).seekg(start);
+      n_left = partition->chunk_size;
+    }
+  n_left--;
+}
+
+void Data_Files::next_extended(int field_type, const DataTag& tag)
+{
+  int& n_left = left.extended[field_type][tag];
+  if (n_left == 0)
+    {
+      int start = partition->claim_extended(partition_thread, field_type, tag);
+      extended[tag].get_buffer(DataFieldType(field_type)).seekg(start);
+      n_left = partition->chunk_size;
+    }
+  n_left--;
+}
+
 void Data_Files::skip(const DataPositions& pos)
 {
   DataPositions new_pos = usage;
@@ -231,8 +387,12 @@ void Data_Files::get(Processor& proc, DataTag tag, const vector<int>& regs, int
   usage.extended[T::field_type()][tag] += vector_size;
   setup_extended(T::field_type(), tag, regs.size());
   for (int j = 0; j < vector_size; j++)
-    for (unsigned int i = 0; i < regs.size(); i++)
-      extended[tag].input(proc.get_S_ref<T>(regs[i] + j));
+    {
+      if (partition)
+        next_extended(T::field_type(), tag);
+      for (unsigned int i = 0; i < regs.size(); i++)
+        extended[tag].input(proc.get_S_ref<T>(regs[i] + j));
+    }
 }
 
 template void Data_Files::get<gfp>(Processor& proc, DataTag tag, const vector<int>& regs, int vector_size);
@@ -55,15 +55,47 @@ struct DataPositions
   DataPositions(int num_players = 0) { set_num_players(num_players); }
   void set_num_players(int num_players);
   void increase(const DataPositions& delta);
+  // Componentwise maximum
+  void set_max(const DataPositions& other);
   void print_cost() const;
 };
 
+/*
+ * Preprocessing data for tapes with unknown usage running at the same
+ * time. Threads claim chunks lazily, the k-th chunk of thread t starting
+ * at base + (k * n_threads + t) * chunk_size. This only depends on how
+ * much each thread uses, so all parties agree without communication.
+ */
+class DataPartition
+{
+  Lock lock;
+  DataPositions base, end;
+  vector<DataPositions> claimed;
+
+  int claim(int thread, int base_pos, int& n_claimed, int& end_pos);
+
+public:
+  const int n_threads, chunk_size;
+  // Tapes and callers taking part, guarded by Machine::partition_lock
+  int n_running;
+
+  DataPartition(const DataPositions& base, int n_threads, int chunk_size);
+
+  int claim_file(int thread, int field_type, int dtype);
+  int claim_input(int thread, int player, int field_type);
+  int claim_extended(int thread, int field_type, const DataTag& tag);
+
+  // Everything claimed so far and the base
+  DataPositions get_end();
+};
+
 class Processor;
 
 class Data_Files
 {
   static map<DataTag, int> tuple_lengths;
   static Lock tuple_lengths_lock;
+  static uint64_t mac_key_ids[N_DATA_FIELD_TYPE];
 
   BufferHelper<Share, Share> buffers[N_DTYPE];
   BufferHelper<Share, Share>* input_buffers;
@@ -74,6 +106,16 @@ class Data_Files
 
   DataPositions usage;
 
+  // Chunks claimed from partition, left counts what is unused in them
+  DataPartition* partition;
+  int partition_thread;
+  bool partition_joined;
+  DataPositions left;
+
+  void next_file(int field_type, int dtype);
+  void next_input(int player, int field_type);
+  void next_extended(int field_type, const DataTag& tag);
+
   public:
 
   const string prep_data_dir;
@@ -87,6 +129,10 @@ class Data_Files
   static int share_length(int field_type);
   static int tuple_length(int field_type, int dtype);
 
+  // MAC key shares to compare to the headers of the files, if known
+  static void set_mac_keys(const gfp& alphapi, const gf2n& alpha2i);
+  static PrepFileHeader expected_header(DataFieldType field_type, int tuple_length);
+
   Data_Files(int my_num,int n,const string& prep_data_dir);
   Data_Files(Names& N, const string& prep_data_dir) :
       Data_Files(N.my_num(), N.num_players(), prep_data_dir) {}
@@ -112,10 +158,23 @@ class Data_Files
     return usage;
   }
 
+  // Take data from the partition instead of the current positions,
+  // null to stop
+  void set_partition(DataPartition* partition, int thread);
+  DataPartition* get_partition() { return partition; }
+  // Take part in the partition of the tapes started from this one,
+  // claiming as the thread set last
+  void join_partition(DataPartition* partition);
+  bool joined_partition() { return partition_joined; }
+  // Stop taking part and continue after everything claimed so far
+  void leave_partition();
+
   template <class T>
   void get_three(DataFieldType field_type, Dtype dtype, Share<T>& a, Share<T>& b, Share<T>& c)
   {
     usage.files[field_type][dtype]++;
+    if (partition)
+      next_file(field_type, dtype);
     buffers[dtype].input(a);
     buffers[dtype].input(b);
     buffers[dtype].input(c);
@@ -125,6 +184,8 @@ class Data_Files
   void get_two(DataFieldType field_type, Dtype dtype, Share<T>& a, Share<T>& b)
   {
     usage.files[field_type][dtype]++;
+    if (partition)
+      next_file(field_type, dtype);
     buffers[dtype].input(a);
     buffers[dtype].input(b);
   }
@@ -133,6 +194,8 @@ class Data_Files
   void get_one(DataFieldType field_type, Dtype dtype, Share<T>& a)
   {
     usage.files[field_type][dtype]++;
+    if (partition)
+      next_file(field_type, dtype);
     buffers[dtype].input(a);
   }
 
@@ -140,6 +203,8 @@ class Data_Files
   void get_input(Share<T>& a,T& x,int i)
   {
     usage.inputs[i][T::field_type()]++;
+    if (partition)
+      next_input(i, T::field_type());
     RefInputTuple<T> tuple(a, x);
     if (i==my_num)
       my_input_buffers.input(tuple);
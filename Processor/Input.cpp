@@ -39,7 +39,9 @@ void Input<T>::start(int player, int n_inputs)
 
     if (player == proc.P.my_num())
     {
-        octetStream o;
+        octetStream& o = os;
+        o.reset_write_head();
+        o.reserve(n_inputs * T::size());
 
         for (int i = 0; i < n_inputs; i++)
         {
@@ -82,7 +84,7 @@ void Input<T>::stop(int player, vector<int> targets)
     if (proc.P.my_num() != player)
     {
         T t;
-        octetStream o;
+        octetStream& o = os;
         timer.start();
         proc.P.receive_player(player, o, true);
         timer.stop();
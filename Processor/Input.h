@@ -26,6 +26,8 @@ class Input
     vector< vector< Share<T> > > shares;
     Buffer<T,T> buffer;
     Timer timer;
+    // reused for all inputs
+    octetStream os;
 
     void adjust_mac(Share<T>& share, T& value);
 
@@ -452,6 +452,128 @@ int BaseInstruction::get_max_reg(int reg_type) const
     return *max_element(r, r + 3) +  size;
 }
 
+#define OPCODE_NAME(NAME) { NAME, #NAME },
+
+static const pair<int, const char*> opcode_names[] = {
+    // Load/store
+    OPCODE_NAME(LDI) OPCODE_NAME(LDSI) OPCODE_NAME(LDMC) OPCODE_NAME(LDMS)
+    OPCODE_NAME(STMC) OPCODE_NAME(STMS) OPCODE_NAME(LDMCI) OPCODE_NAME(LDMSI)
+    OPCODE_NAME(STMCI) OPCODE_NAME(STMSI) OPCODE_NAME(MOVC) OPCODE_NAME(MOVS)
+    OPCODE_NAME(PROTECTMEMS) OPCODE_NAME(PROTECTMEMC)
+    OPCODE_NAME(PROTECTMEMINT) OPCODE_NAME(LDMINT) OPCODE_NAME(STMINT)
+    OPCODE_NAME(LDMINTI) OPCODE_NAME(STMINTI) OPCODE_NAME(PUSHINT)
+    OPCODE_NAME(POPINT) OPCODE_NAME(MOVINT)
+    // Machine
+    OPCODE_NAME(LDTN) OPCODE_NAME(LDARG) OPCODE_NAME(REQBL) OPCODE_NAME(STARG)
+    OPCODE_NAME(TIME) OPCODE_NAME(START) OPCODE_NAME(STOP) OPCODE_NAME(USE)
+    OPCODE_NAME(USE_INP) OPCODE_NAME(RUN_TAPE) OPCODE_NAME(JOIN_TAPE)
+    OPCODE_NAME(CRASH) OPCODE_NAME(USE_PREP) OPCODE_NAME(STARTGRIND)
+    OPCODE_NAME(STOPGRIND)
+    // Addition
+    OPCODE_NAME(ADDC) OPCODE_NAME(ADDS) OPCODE_NAME(ADDM) OPCODE_NAME(ADDCI)
+    OPCODE_NAME(ADDSI) OPCODE_NAME(SUBC) OPCODE_NAME(SUBS) OPCODE_NAME(SUBML)
+    OPCODE_NAME(SUBMR) OPCODE_NAME(SUBCI) OPCODE_NAME(SUBSI)
+    OPCODE_NAME(SUBCFI) OPCODE_NAME(SUBSFI)
+    // Multiplication/division/other arithmetic
+    OPCODE_NAME(MULC) OPCODE_NAME(MULM) OPCODE_NAME(MULCI) OPCODE_NAME(MULSI)
+    OPCODE_NAME(DIVC) OPCODE_NAME(DIVCI) OPCODE_NAME(MODC) OPCODE_NAME(MODCI)
+    OPCODE_NAME(LEGENDREC) OPCODE_NAME(DIGESTC)
+    // Open
+    OPCODE_NAME(STARTOPEN) OPCODE_NAME(STOPOPEN) OPCODE_NAME(OPEN)
+#if defined(EXTENDED_SPDZ)
+    OPCODE_NAME(E_STARTMULT) OPCODE_NAME(E_STOPMULT) OPCODE_NAME(E_MULT)
+#endif
+    // Data access
+    OPCODE_NAME(TRIPLE) OPCODE_NAME(BIT) OPCODE_NAME(SQUARE) OPCODE_NAME(INV)
+    OPCODE_NAME(INPUTMASK) OPCODE_NAME(PREP)
+    // Input
+    OPCODE_NAME(INPUT) OPCODE_NAME(STARTINPUT) OPCODE_NAME(STOPINPUT)
+    OPCODE_NAME(READSOCKETC) OPCODE_NAME(READSOCKETS)
+    OPCODE_NAME(WRITESOCKETC) OPCODE_NAME(WRITESOCKETS)
+    OPCODE_NAME(READSOCKETINT) OPCODE_NAME(WRITESOCKETINT)
+    OPCODE_NAME(WRITESOCKETSHARE) OPCODE_NAME(LISTEN)
+    OPCODE_NAME(ACCEPTCLIENTCONNECTION) OPCODE_NAME(CONNECTIPV4)
+    OPCODE_NAME(READCLIENTPUBLICKEY)
+    // Bitwise logic
+    OPCODE_NAME(ANDC) OPCODE_NAME(XORC) OPCODE_NAME(ORC) OPCODE_NAME(ANDCI)
+    OPCODE_NAME(XORCI) OPCODE_NAME(ORCI) OPCODE_NAME(NOTC)
+    // Bitwise shifts
+    OPCODE_NAME(SHLC) OPCODE_NAME(SHRC) OPCODE_NAME(SHLCI) OPCODE_NAME(SHRCI)
+    // Branching and comparison
+    OPCODE_NAME(JMP) OPCODE_NAME(JMPNZ) OPCODE_NAME(JMPEQZ) OPCODE_NAME(EQZC)
+    OPCODE_NAME(LTZC) OPCODE_NAME(LTC) OPCODE_NAME(GTC) OPCODE_NAME(EQC)
+    OPCODE_NAME(JMPI)
+    // Integers
+    OPCODE_NAME(BITDECINT) OPCODE_NAME(LDINT) OPCODE_NAME(ADDINT)
+    OPCODE_NAME(SUBINT) OPCODE_NAME(MULINT) OPCODE_NAME(DIVINT)
+    OPCODE_NAME(PRINTINT)
+    // Conversion
+    OPCODE_NAME(CONVINT) OPCODE_NAME(CONVMODP)
+    // IO
+    OPCODE_NAME(PRINTMEM) OPCODE_NAME(PRINTREG) OPCODE_NAME(RAND)
+    OPCODE_NAME(PRINTREGPLAIN) OPCODE_NAME(PRINTCHR) OPCODE_NAME(PRINTSTR)
+    OPCODE_NAME(PUBINPUT) OPCODE_NAME(RAWOUTPUT)
+    OPCODE_NAME(STARTPRIVATEOUTPUT) OPCODE_NAME(STOPPRIVATEOUTPUT)
+    OPCODE_NAME(PRINTCHRINT) OPCODE_NAME(PRINTSTRINT)
+    OPCODE_NAME(PRINTFLOATPLAIN) OPCODE_NAME(WRITEFILESHARE)
+    OPCODE_NAME(READFILESHARE)
+    // Load/store
+    OPCODE_NAME(GLDI) OPCODE_NAME(GLDSI) OPCODE_NAME(GLDMC) OPCODE_NAME(GLDMS)
+    OPCODE_NAME(GSTMC) OPCODE_NAME(GSTMS) OPCODE_NAME(GLDMCI)
+    OPCODE_NAME(GLDMSI) OPCODE_NAME(GSTMCI) OPCODE_NAME(GSTMSI)
+    OPCODE_NAME(GMOVC) OPCODE_NAME(GMOVS) OPCODE_NAME(GPROTECTMEMS)
+    OPCODE_NAME(GPROTECTMEMC)
+    // Machine
+    OPCODE_NAME(GREQBL) OPCODE_NAME(GUSE_PREP)
+    // Addition
+    OPCODE_NAME(GADDC) OPCODE_NAME(GADDS) OPCODE_NAME(GADDM)
+    OPCODE_NAME(GADDCI) OPCODE_NAME(GADDSI) OPCODE_NAME(GSUBC)
+    OPCODE_NAME(GSUBS) OPCODE_NAME(GSUBML) OPCODE_NAME(GSUBMR)
+    OPCODE_NAME(GSUBCI) OPCODE_NAME(GSUBSI) OPCODE_NAME(GSUBCFI)
+    OPCODE_NAME(GSUBSFI)
+    // Multiplication/division
+    OPCODE_NAME(GMULC) OPCODE_NAME(GMULM) OPCODE_NAME(GMULCI)
+    OPCODE_NAME(GMULSI) OPCODE_NAME(GDIVC) OPCODE_NAME(GDIVCI)
+    OPCODE_NAME(GMULBITC) OPCODE_NAME(GMULBITM)
+    // Open
+    OPCODE_NAME(GSTARTOPEN) OPCODE_NAME(GSTOPOPEN) OPCODE_NAME(GOPEN)
+    // Data access
+    OPCODE_NAME(GTRIPLE) OPCODE_NAME(GBIT) OPCODE_NAME(GSQUARE)
+    OPCODE_NAME(GINV) OPCODE_NAME(GBITTRIPLE) OPCODE_NAME(GBITGF2NTRIPLE)
+    OPCODE_NAME(GINPUTMASK) OPCODE_NAME(GPREP)
+    // Input
+    OPCODE_NAME(GINPUT) OPCODE_NAME(GSTARTINPUT) OPCODE_NAME(GSTOPINPUT)
+    OPCODE_NAME(GREADSOCKETS) OPCODE_NAME(GWRITESOCKETS)
+    // Bitwise logic
+    OPCODE_NAME(GANDC) OPCODE_NAME(GXORC) OPCODE_NAME(GORC)
+    OPCODE_NAME(GANDCI) OPCODE_NAME(GXORCI) OPCODE_NAME(GORCI)
+    OPCODE_NAME(GNOTC)
+    // Bitwise shifts
+    OPCODE_NAME(GSHLCI) OPCODE_NAME(GSHRCI) OPCODE_NAME(GBITDEC)
+    OPCODE_NAME(GBITCOM)
+    // Conversion
+    OPCODE_NAME(GCONVINT) OPCODE_NAME(GCONVGF2N)
+    // IO
+    OPCODE_NAME(GPRINTMEM) OPCODE_NAME(GPRINTREG) OPCODE_NAME(GPRINTREGPLAIN)
+    OPCODE_NAME(GRAWOUTPUT) OPCODE_NAME(GSTARTPRIVATEOUTPUT)
+    OPCODE_NAME(GSTOPPRIVATEOUTPUT)
+    // Commsec ops
+    OPCODE_NAME(INITSECURESOCKET) OPCODE_NAME(RESPSECURESOCKET)
+};
+
+#undef OPCODE_NAME
+
+const char* opcode_name(int opcode)
+{
+  static map<int, const char*> names(opcode_names,
+      opcode_names + sizeof(opcode_names) / sizeof(opcode_names[0]));
+  map<int, const char*>::const_iterator it = names.find(opcode);
+  if (it == names.end())
+    return 0;
+  else
+    return it->second;
+}
+
 int Instruction::get_mem(RegType reg_type, SecrecyType sec_type) const
 {
   if (get_reg_type() == reg_type and is_direct_memory_access(sec_type))
@@ -513,17 +635,79 @@ void Instruction::execute(Processor& Proc) const
 {
   Proc.PC+=1;
 
+#if defined(EXTENDED_SPDZ)
+  // preprocessing from the extension is fetched for the whole vector at once
+  switch (opcode)
+  {
+    case TRIPLE:
+      Proc.PTriple_Ext_64(r, size);
+      return;
+    case GTRIPLE:
+      Proc.GTriple_Ext_64(r, size);
+      return;
+    case BIT:
+      Proc.PBit_Ext_64(r, size);
+      return;
+    case GBIT:
+      Proc.GBit_Ext_64(r, size);
+      return;
+    case INV:
+      Proc.PInverse_Ext_64(r, size);
+      return;
+    case GINV:
+      Proc.GInverse_Ext_64(r, size);
+      return;
+  }
+#endif
+
 #ifndef DEBUG
-  // optimize some instructions
+  // optimize some instructions, vectors run as bulk operations on
+  // consecutive registers
   switch (opcode)
   {
+    case ADDC:
+      gfp::add(&Proc.get_Cp_ref(r[0]), &Proc.read_Cp(r[1]), &Proc.read_Cp(r[2]), size);
+      return;
+    case SUBC:
+      gfp::sub(&Proc.get_Cp_ref(r[0]), &Proc.read_Cp(r[1]), &Proc.read_Cp(r[2]), size);
+      return;
+    case MULC:
+      gfp::mul(&Proc.get_Cp_ref(r[0]), &Proc.read_Cp(r[1]), &Proc.read_Cp(r[2]), size);
+      return;
+    case ADDS:
+      Share<gfp>::add(&Proc.get_Sp_ref(r[0]), &Proc.read_Sp(r[1]), &Proc.read_Sp(r[2]), size);
+      return;
+    case SUBS:
+      Share<gfp>::sub(&Proc.get_Sp_ref(r[0]), &Proc.read_Sp(r[1]), &Proc.read_Sp(r[2]), size);
+      return;
+    case MULM:
+      Share<gfp>::mul(&Proc.get_Sp_ref(r[0]), &Proc.read_Sp(r[1]), &Proc.read_Cp(r[2]), size);
+      return;
+#if !defined(EXTENDED_SPDZ)
+    case ADDM:
+      Share<gfp>::add(&Proc.get_Sp_ref(r[0]), &Proc.read_Sp(r[1]), &Proc.read_Cp(r[2]), size,
+          Proc.P.my_num()==0, Proc.MCp.get_alphai());
+      return;
+    case GADDM:
+      Share<gf2n>::add(&Proc.get_S2_ref(r[0]), &Proc.read_S2(r[1]), &Proc.read_C2(r[2]), size,
+          Proc.P.my_num()==0, Proc.MC2.get_alphai());
+      return;
+#endif
     case GADDC:
-      for (int i = 0; i < size; i++)
-        Proc.get_C2_ref(r[0] + i).add(Proc.read_C2(r[1] + i),Proc.read_C2(r[2] + i));
+    case GSUBC:
+      gf2n::add(&Proc.get_C2_ref(r[0]), &Proc.read_C2(r[1]), &Proc.read_C2(r[2]), size);
+      return;
+    case GMULC:
+      gf2n::mul(&Proc.get_C2_ref(r[0]), &Proc.read_C2(r[1]), &Proc.read_C2(r[2]), size);
       return;
     case GADDS:
-      for (int i = 0; i < size; i++)
-        Proc.get_S2_ref(r[0] + i).add(Proc.read_S2(r[1] + i),Proc.read_S2(r[2] + i));
+      Share<gf2n>::add(&Proc.get_S2_ref(r[0]), &Proc.read_S2(r[1]), &Proc.read_S2(r[2]), size);
+      return;
+    case GSUBS:
+      Share<gf2n>::sub(&Proc.get_S2_ref(r[0]), &Proc.read_S2(r[1]), &Proc.read_S2(r[2]), size);
+      return;
+    case GMULM:
+      Share<gf2n>::mul(&Proc.get_S2_ref(r[0]), &Proc.read_S2(r[1]), &Proc.read_C2(r[2]), size);
       return;
     case GMOVC:
       for (int i = 0; i < size; i++)
@@ -541,10 +725,6 @@ void Instruction::execute(Processor& Proc) const
       for (int i = 0; i < size; i++)
         Proc.get_C2_ref(r[0] + i).SHR(Proc.read_C2(r[1] + i),n);
       return;
-    case GMULM:
-      for (int i = 0; i < size; i++)
-         Proc.get_S2_ref(r[0] + i).mul(Proc.read_S2(r[1] + i),Proc.read_C2(r[2] + i));
-      return;
   }
 #endif
 
@@ -1115,18 +1295,10 @@ void Instruction::execute(Processor& Proc) const
 	#endif
         break;
       case TRIPLE:
-#if defined(EXTENDED_SPDZ)
-    	  Proc.PTriple_Ext_64(Proc.get_Sp_ref(r[0]),Proc.get_Sp_ref(r[1]),Proc.get_Sp_ref(r[2]));
-#else
     	  Proc.DataF.get_three(DATA_MODP, DATA_TRIPLE, Proc.get_Sp_ref(r[0]),Proc.get_Sp_ref(r[1]),Proc.get_Sp_ref(r[2]));
-#endif
         break;
       case GTRIPLE:
-#if defined(EXTENDED_SPDZ)
-    	  Proc.GTriple_Ext_64(Proc.get_S2_ref(r[0]),Proc.get_S2_ref(r[1]),Proc.get_S2_ref(r[2]));
-#else
         Proc.DataF.get_three(DATA_GF2N, DATA_TRIPLE, Proc.get_S2_ref(r[0]),Proc.get_S2_ref(r[1]),Proc.get_S2_ref(r[2]));
-#endif
         break;
       case GBITTRIPLE:
         Proc.DataF.get_three(DATA_GF2N, DATA_BITTRIPLE, Proc.get_S2_ref(r[0]),Proc.get_S2_ref(r[1]),Proc.get_S2_ref(r[2]));
@@ -1141,32 +1313,16 @@ void Instruction::execute(Processor& Proc) const
         Proc.DataF.get_two(DATA_GF2N, DATA_SQUARE, Proc.get_S2_ref(r[0]),Proc.get_S2_ref(r[1]));
         break;
       case BIT:
-#if defined(EXTENDED_SPDZ)
-    	Proc.PBit_Ext_64(Proc.get_Sp_ref(r[0]));
-#else
         Proc.DataF.get_one(DATA_MODP, DATA_BIT, Proc.get_Sp_ref(r[0]));
-#endif
         break;
       case GBIT:
-#if defined(EXTENDED_SPDZ)
-    	  Proc.GBit_Ext_64(Proc.get_S2_ref(r[0]));
-#else
         Proc.DataF.get_one(DATA_GF2N, DATA_BIT, Proc.get_S2_ref(r[0]));
-#endif
         break;
       case INV:
-#if defined(EXTENDED_SPDZ)
-    	Proc.PInverse_Ext_64(Proc.get_Sp_ref(r[0]),Proc.get_Sp_ref(r[1]));
-#else
         Proc.DataF.get_two(DATA_MODP, DATA_INVERSE, Proc.get_Sp_ref(r[0]),Proc.get_Sp_ref(r[1]));
-#endif
         break;
       case GINV:
-#if defined(EXTENDED_SPDZ)
-    	  Proc.GInverse_Ext_64(Proc.get_S2_ref(r[0]),Proc.get_S2_ref(r[1]));
-#else
         Proc.DataF.get_two(DATA_GF2N, DATA_INVERSE, Proc.get_S2_ref(r[0]),Proc.get_S2_ref(r[1]));
-#endif
         break;
       case INPUTMASK:
         Proc.DataF.get_input(Proc.get_Sp_ref(r[0]), Proc.temp.ansp, n);
@@ -1479,32 +1635,28 @@ void Instruction::execute(Processor& Proc) const
         }
       case STARTOPEN:
 #if defined(EXTENDED_SPDZ)
-    	  std::cerr << "STARTOPEN instruction is not implemented in extension" << std::endl;
-    	  exit(-1);
+    	  Proc.POpen_Start_Ext_64(start, size);
 #else
     	  Proc.POpen_Start(start,Proc.P,Proc.MCp,size);
 #endif
         return;
       case GSTARTOPEN:
 #if defined(EXTENDED_SPDZ)
-    	  std::cerr << "GSTARTOPEN instruction is not implemented in extension" << std::endl;
-    	  exit(-1);
+    	  Proc.GOpen_Start_Ext_64(start, size);
 #else
         Proc.POpen_Start(start,Proc.P,Proc.MC2,size);
 #endif
         return;
       case STOPOPEN:
 #if defined(EXTENDED_SPDZ)
-    	  std::cerr << "STOPOPEN instruction is not implemented in extension" << std::endl;
-    	  exit(-1);
+    	  Proc.POpen_Stop_Ext_64(start, size);
 #else
     	  Proc.POpen_Stop(start,Proc.P,Proc.MCp,size);
 #endif
         return;
       case GSTOPOPEN:
 #if defined(EXTENDED_SPDZ)
-    	  std::cerr << "GSTOPOPEN instruction is not implemented in extension" << std::endl;
-    	  exit(-1);
+    	  Proc.GOpen_Stop_Ext_64(start, size);
 #else
         Proc.POpen_Stop(start,Proc.P,Proc.MC2,size);
 #endif
@@ -1525,12 +1677,10 @@ void Instruction::execute(Processor& Proc) const
         break;
 #if defined(EXTENDED_SPDZ)
       case E_STARTMULT:
-    	  std::cerr << "E_STARTMULT instruction is not implemented in extension" << std::endl;
-    	  exit(-1);
+        Proc.PMult_Start_Ext_64(start, size);
         return;
       case E_STOPMULT:
-    	  std::cerr << "E_STOPMULT instruction is not implemented in extension" << std::endl;
-    	  exit(-1);
+        Proc.PMult_Stop_Ext_64(start, size);
         return;
       case E_MULT:
         Proc.PMult_Ext_64(start, size);
@@ -1717,10 +1867,11 @@ void Instruction::execute(Processor& Proc) const
         Proc.machine.stop(n);
         break;
       case RUN_TAPE:
-        Proc.DataF.skip(Proc.machine.run_tape(r[0], n, r[1], -1));
+        Proc.DataF.skip(Proc.machine.run_tape(r[0], n, r[1], -1, -1, &Proc.DataF,
+            Proc.get_thread_num()));
         break;
       case JOIN_TAPE:
-        Proc.machine.join_tape(r[0]);
+        Proc.machine.join_tape(r[0], &Proc.DataF, Proc.get_thread_num());
         break;
       case CRASH:
         throw crash_requested();
@@ -1847,3 +1998,139 @@ void Instruction::execute(Processor& Proc) const
     }
   }
 }
+
+
+/*
+ * Direct handlers for pre-decoded instructions. Each of them has to
+ * do exactly what the corresponding case in Instruction::execute does
+ * for size 1, including incrementing the PC first.
+ */
+
+#ifndef DEBUG
+#define HANDLER(NAME, CODE) \
+  static void handle_##NAME(Processor& Proc, const DecodedInstruction& instr) \
+  { \
+    const int* r = instr.r; (void)r; \
+    Proc.PC += 1; \
+    CODE; \
+  }
+
+HANDLER(LDINT, Proc.write_Ci(r[0], instr.n))
+HANDLER(MOVINT, Proc.write_Ci(r[0], Proc.read_Ci(r[1])))
+HANDLER(ADDINT, Proc.get_Ci_ref(r[0]) = Proc.read_Ci(r[1]) + Proc.read_Ci(r[2]))
+HANDLER(SUBINT, Proc.get_Ci_ref(r[0]) = Proc.read_Ci(r[1]) - Proc.read_Ci(r[2]))
+HANDLER(MULINT, Proc.get_Ci_ref(r[0]) = Proc.read_Ci(r[1]) * Proc.read_Ci(r[2]))
+HANDLER(LTC, Proc.write_Ci(r[0], Proc.read_Ci(r[1]) < Proc.read_Ci(r[2])))
+HANDLER(GTC, Proc.write_Ci(r[0], Proc.read_Ci(r[1]) > Proc.read_Ci(r[2])))
+HANDLER(EQC, Proc.write_Ci(r[0], Proc.read_Ci(r[1]) == Proc.read_Ci(r[2])))
+HANDLER(LTZC, Proc.write_Ci(r[0], Proc.read_Ci(r[1]) < 0))
+HANDLER(EQZC, Proc.write_Ci(r[0], Proc.read_Ci(r[1]) == 0))
+HANDLER(JMP, Proc.PC += instr.n)
+HANDLER(JMPNZ, if (Proc.read_Ci(r[0]) != 0) Proc.PC += instr.n)
+HANDLER(JMPEQZ, if (Proc.read_Ci(r[0]) == 0) Proc.PC += instr.n)
+HANDLER(LDMINT, Proc.write_Ci(r[0], Proc.machine.Mi.read_C(instr.n).get()))
+HANDLER(STMINT, Proc.machine.Mi.write_C(instr.n, Integer(Proc.read_Ci(r[0])), Proc.PC))
+HANDLER(LDMINTI, Proc.write_Ci(r[0], Proc.machine.Mi.read_C(Proc.read_Ci(r[1])).get()))
+HANDLER(STMINTI, Proc.machine.Mi.write_C(Proc.read_Ci(r[1]), Integer(Proc.read_Ci(r[0])), Proc.PC))
+HANDLER(CONVINT, Proc.get_Cp_ref(r[0]).assign(Proc.read_Ci(r[1])))
+
+HANDLER(LDMC, Proc.write_Cp(r[0], Proc.machine.Mp.read_C(instr.n)))
+HANDLER(LDMS, Proc.write_Sp(r[0], Proc.machine.Mp.read_S(instr.n)))
+HANDLER(STMC, Proc.machine.Mp.write_C(instr.n, Proc.read_Cp(r[0]), Proc.PC))
+HANDLER(STMS, Proc.machine.Mp.write_S(instr.n, Proc.read_Sp(r[0]), Proc.PC))
+HANDLER(MOVC, Proc.write_Cp(r[0], Proc.read_Cp(r[1])))
+HANDLER(MOVS, Proc.write_Sp(r[0], Proc.read_Sp(r[1])))
+HANDLER(ADDC, Proc.get_Cp_ref(r[0]).add(Proc.read_Cp(r[1]), Proc.read_Cp(r[2])))
+HANDLER(SUBC, Proc.get_Cp_ref(r[0]).sub(Proc.read_Cp(r[1]), Proc.read_Cp(r[2])))
+HANDLER(MULC, Proc.get_Cp_ref(r[0]).mul(Proc.read_Cp(r[1]), Proc.read_Cp(r[2])))
+HANDLER(ADDCI, Proc.temp.ansp.assign(instr.n);
+    Proc.get_Cp_ref(r[0]).add(Proc.temp.ansp, Proc.read_Cp(r[1])))
+HANDLER(SUBCI, Proc.temp.ansp.assign(instr.n);
+    Proc.get_Cp_ref(r[0]).sub(Proc.read_Cp(r[1]), Proc.temp.ansp))
+HANDLER(MULCI, Proc.temp.ansp.assign(instr.n);
+    Proc.get_Cp_ref(r[0]).mul(Proc.temp.ansp, Proc.read_Cp(r[1])))
+HANDLER(ADDS, Proc.get_Sp_ref(r[0]).add(Proc.read_Sp(r[1]), Proc.read_Sp(r[2])))
+HANDLER(SUBS, Proc.get_Sp_ref(r[0]).sub(Proc.read_Sp(r[1]), Proc.read_Sp(r[2])))
+HANDLER(MULM, Proc.get_Sp_ref(r[0]).mul(Proc.read_Sp(r[1]), Proc.read_Cp(r[2])))
+#if defined(EXTENDED_SPDZ)
+HANDLER(ADDM, Proc.PAddm_Ext_64(Proc.get_Sp_ref(r[1]), Proc.get_Cp_ref(r[2]), Proc.get_Sp_ref(r[0])))
+HANDLER(SUBML, Proc.PSubml_Ext_64(Proc.get_Sp_ref(r[1]), Proc.get_Cp_ref(r[2]), Proc.get_Sp_ref(r[0])))
+HANDLER(SUBMR, Proc.PSubmr_Ext_64(Proc.get_Cp_ref(r[1]), Proc.get_Sp_ref(r[2]), Proc.get_Sp_ref(r[0])))
+#else
+HANDLER(ADDM, Proc.get_Sp_ref(r[0]).add(Proc.read_Sp(r[1]), Proc.read_Cp(r[2]),
+    Proc.P.my_num() == 0, Proc.MCp.get_alphai()))
+HANDLER(SUBML, Proc.get_Sp_ref(r[0]).sub(Proc.read_Sp(r[1]), Proc.read_Cp(r[2]),
+    Proc.P.my_num() == 0, Proc.MCp.get_alphai()))
+HANDLER(SUBMR, Proc.get_Sp_ref(r[0]).sub(Proc.read_Cp(r[1]), Proc.read_Sp(r[2]),
+    Proc.P.my_num() == 0, Proc.MCp.get_alphai()))
+#endif
+
+HANDLER(GMOVC, Proc.write_C2(r[0], Proc.read_C2(r[1])))
+HANDLER(GMOVS, Proc.write_S2(r[0], Proc.read_S2(r[1])))
+HANDLER(GADDC, Proc.get_C2_ref(r[0]).add(Proc.read_C2(r[1]), Proc.read_C2(r[2])))
+HANDLER(GADDS, Proc.get_S2_ref(r[0]).add(Proc.read_S2(r[1]), Proc.read_S2(r[2])))
+HANDLER(GMULM, Proc.get_S2_ref(r[0]).mul(Proc.read_S2(r[1]), Proc.read_C2(r[2])))
+
+#undef HANDLER
+#define HANDLER(NAME) case NAME: decoded.handler = handle_##NAME; break;
+#endif
+
+void Instruction::decode(DecodedInstruction& decoded) const
+{
+  decoded.handler = 0;
+  for (int i = 0; i < 3; i++)
+    decoded.r[i] = r[i];
+  decoded.n = n;
+
+#ifndef DEBUG
+  // vectors and everything else go through the switch
+  if (size != 1)
+    return;
+
+  switch (opcode)
+  {
+    HANDLER(LDINT)
+    HANDLER(MOVINT)
+    HANDLER(ADDINT)
+    HANDLER(SUBINT)
+    HANDLER(MULINT)
+    HANDLER(LTC)
+    HANDLER(GTC)
+    HANDLER(EQC)
+    HANDLER(LTZC)
+    HANDLER(EQZC)
+    HANDLER(JMP)
+    HANDLER(JMPNZ)
+    HANDLER(JMPEQZ)
+    HANDLER(LDMINT)
+    HANDLER(STMINT)
+    HANDLER(LDMINTI)
+    HANDLER(STMINTI)
+    HANDLER(CONVINT)
+    HANDLER(LDMC)
+    HANDLER(LDMS)
+    HANDLER(STMC)
+    HANDLER(STMS)
+    HANDLER(MOVC)
+    HANDLER(MOVS)
+    HANDLER(ADDC)
+    HANDLER(SUBC)
+    HANDLER(MULC)
+    HANDLER(ADDCI)
+    HANDLER(SUBCI)
+    HANDLER(MULCI)
+    HANDLER(ADDS)
+    HANDLER(SUBS)
+    HANDLER(MULM)
+    HANDLER(ADDM)
+    HANDLER(SUBML)
+    HANDLER(SUBMR)
+    HANDLER(GMOVC)
+    HANDLER(GMOVS)
+    HANDLER(GADDC)
+    HANDLER(GADDS)
+    HANDLER(GMULM)
+  }
+#undef HANDLER
+#endif
+}
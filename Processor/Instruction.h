@@ -264,6 +264,9 @@ enum
     RESPSECURESOCKET = 0x1BB
 };
 
+// Mnemonic as in the enum above, 0 for unknown opcodes
+const char* opcode_name(int opcode);
+
 
 // Register types
 enum RegType {
@@ -307,6 +310,7 @@ public:
 
   void parse_operands(istream& s, int pos);
 
+  int get_opcode() const { return opcode; }
   bool is_gf2n_instruction() const { return ((opcode&0x100)!=0); }
   virtual int get_reg_type() const;
 
@@ -317,6 +321,22 @@ public:
 };
 
 
+struct DecodedInstruction;
+typedef void (*InstructionHandler)(Processor& Proc, const DecodedInstruction& instr);
+
+/* Pre-decoded form of the most frequent scalar instructions,
+ * which the tape loop calls directly instead of going through
+ * the opcode switch in Instruction::execute
+ */
+struct DecodedInstruction
+{
+  // NULL if the instruction has to go through Instruction::execute
+  InstructionHandler handler;
+  int r[3];
+  int n;
+};
+
+
 class Instruction : public BaseInstruction
 {
 public:
@@ -334,6 +354,9 @@ public:
   // Execute this instruction, updateing the processor and memory
   // and streams pointing to the triples etc
   void execute(Processor& Proc) const;
+
+  // Fill in a direct handler if there is one for this instruction
+  void decode(DecodedInstruction& decoded) const;
 };
 
 
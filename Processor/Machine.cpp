@@ -5,6 +5,7 @@
 #include "Exceptions/Exceptions.h"
 
 #include <sys/time.h>
+#include <sys/resource.h>
 
 #include "Math/Setup.h"
 
@@ -17,15 +18,39 @@ using namespace std;
 
 Machine::Machine(int my_number, Names& playerNames,
     string progname_str, string memtype, int lgp, int lg2, bool direct,
-    int opening_sum, bool parallel, bool receive_threads, int max_broadcast)
+    int opening_sum, bool parallel, bool receive_threads, int max_broadcast,
+    bool profile, string profile_json, bool switch_dispatch, bool mmap_prep,
+    bool stream_prep, int max_running, int prep_chunk, int check_batch,
+    int check_pending, int check_memory, bool event_loop, bool coalesce,
+    BroadcastHash::Type broadcast_hash, int broadcast_check, ChannelMux* mux,
+    int ext_prefetch)
   : my_number(my_number), N(playerNames), nthreads(0), tn(0), numt(0), usage_unknown(false),
+    partition(0),
     progname(progname_str), direct(direct), opening_sum(opening_sum), parallel(parallel),
-    receive_threads(receive_threads), max_broadcast(max_broadcast)
+    receive_threads(receive_threads), max_broadcast(max_broadcast),
+    switch_dispatch(switch_dispatch), mmap_prep(mmap_prep),
+    stream_prep(stream_prep), profile(profile or profile_json.size()), profile_json(profile_json),
+    max_running(max_running), prep_chunk(prep_chunk), ext_prefetch(ext_prefetch),
+    check_batch(check_batch), check_pending(check_pending),
+    check_memory(check_memory), event_loop(event_loop), coalesce(coalesce),
+    broadcast_check(broadcast_check), mux(mux)
 {
   if (opening_sum < 2)
     this->opening_sum = N.num_players();
   if (max_broadcast < 2)
     this->max_broadcast = N.num_players();
+  if (check_pending < check_batch)
+    this->check_pending = 4 * check_batch;
+  if (ext_prefetch < 1)
+    throw runtime_error("extension prefetch size has to be positive");
+
+  // streamed files are still growing, so they cannot be mapped
+  BufferBase::set_mmap(mmap_prep and not stream_prep);
+  BufferBase::set_streaming(stream_prep);
+  scheduler.set_slots(max_running);
+  // split between the MACs and values of a batch
+  PackedSegments::set_max_memory((size_t)check_memory << 19);
+  BroadcastHash::set_default(broadcast_hash);
 
   // Set up the fields
   prep_dir_prefix = get_prep_dir(N.num_players(), lgp, lg2);
@@ -53,6 +78,7 @@ Machine::Machine(int my_number, Names& playerNames,
   cerr << "MAC Key p = " << alphapi << endl;
   cerr << "MAC Key 2 = " << alpha2i << endl;
   inpf.close();
+  Data_Files::set_mac_keys(alphapi, alpha2i);
 
 
   // Initialize the global memory
@@ -118,6 +144,8 @@ Machine::Machine(int my_number, Names& playerNames,
   client_ready.resize(nthreads);
   server_ready.resize(nthreads);
   join_timer.resize(nthreads);
+  if (profile)
+    profilers.resize(nthreads);
 
   for (int i=0; i<nthreads; i++)
     { pthread_mutex_init(&t_mutex[i],NULL);
@@ -130,6 +158,10 @@ Machine::Machine(int my_number, Names& playerNames,
       tinfo[i].prognum=-2;  // Dont do anything until we are ready
       tinfo[i].finished=true;
       tinfo[i].ready=false;
+      tinfo[i].scheduler=&scheduler;
+      tinfo[i].ticket=0;
+      tinfo[i].children=&tinfo[i].nested;
+      tinfo[i].partition=0;
       tinfo[i].machine=this;
       // lock for synchronization
       pthread_mutex_lock(&t_mutex[i]);
@@ -148,36 +180,74 @@ Machine::Machine(int my_number, Names& playerNames,
     }
 }
 
-DataPositions Machine::run_tape(int thread_number, int tape_number, int arg, int line_number)
+DataPositions Machine::run_tape(int thread_number, int tape_number, int arg,
+    int line_number, long long ticket, Data_Files* caller, int caller_thread)
 {
   if (thread_number >= (int)tinfo.size())
     throw Processor_Error("invalid thread number: " + to_string(thread_number) + "/" + to_string(tinfo.size()));
   if (tape_number >= (int)progs.size())
     throw Processor_Error("invalid tape number: " + to_string(tape_number) + "/" + to_string(progs.size()));
+
+  // tapes with unknown usage running alongside others claim data in chunks,
+  // and so does everything started by a tape taking part
+  bool unknown = progs[tape_number].usage_unknown();
+  partition_lock.lock();
+  if (not unknown and partition and line_number != -1)
+    {
+      partition_lock.unlock();
+      cerr << "Line " << line_number << " has tape " << tape_number
+          << " with known offline data usage after tapes with unknown usage"
+          << endl;
+      throw invalid_program();
+    }
+  bool partitioned = (unknown and (numt > 1 or line_number == -1))
+      or (caller and caller->get_partition());
+  if (partitioned)
+    {
+      if (partition == 0)
+        partition = new DataPartition(caller ? caller->get_usage() : pos,
+            nthreads, prep_chunk);
+      partition->n_running++;
+      if (caller and caller->get_partition() == 0)
+        {
+          // the caller would otherwise read what the partition hands out
+          caller->join_partition(partition);
+          partition->n_running++;
+        }
+    }
+  DataPartition* shared = partitioned ? partition : 0;
+  partition_lock.unlock();
+
   pthread_mutex_lock(&t_mutex[thread_number]);
   tinfo[thread_number].prognum=tape_number;
   tinfo[thread_number].arg=arg;
-  tinfo[thread_number].pos=pos;
+  if (ticket < 0)
+    {
+      // only the caller takes tickets from its queue, see TapeScheduler
+      TapeScheduler* queue = caller_thread < 0 ? &scheduler :
+          tinfo[caller_thread].children;
+      tinfo[thread_number].scheduler = queue;
+      tinfo[thread_number].ticket = queue->enqueue();
+    }
+  else
+    {
+      tinfo[thread_number].scheduler = &scheduler;
+      tinfo[thread_number].ticket = ticket;
+    }
+  tinfo[thread_number].children = (line_number != -1 and numt == 1) ?
+      &scheduler : &tinfo[thread_number].nested;
+  tinfo[thread_number].pos = caller ? caller->get_usage() : pos;
+  tinfo[thread_number].partition = shared;
   tinfo[thread_number].finished=false;
   //printf("Send signal to run program %d in thread %d\n",tape_number,thread_number);
   pthread_cond_signal(&server_ready[thread_number]);
   pthread_mutex_unlock(&t_mutex[thread_number]);
   //printf("Running line %d\n",exec);
-  if (progs[tape_number].usage_unknown())
-    { // only one thread allowed
-      if (numt>1)
-        { cerr << "Line " << line_number << " has " <<
-          numt << " threads but tape " << tape_number <<
-          " has unknown offline data usage" << endl;
-        throw invalid_program();
-        }
-      else if (line_number == -1)
-        {
-          cerr << "Internally called tape " << tape_number <<
-              " has unknown offline data usage" << endl;
-          throw invalid_program();
-        }
-      usage_unknown = true;
+  if (unknown or partitioned)
+    {
+      // a single tape in a line just continues, see run()
+      if (not partitioned)
+        usage_unknown = true;
       return DataPositions(N.num_players());
     }
   else
@@ -187,14 +257,44 @@ DataPositions Machine::run_tape(int thread_number, int tape_number, int arg, int
     }
 }
 
-void Machine::join_tape(int i)
+void Machine::join_tape(int i, Data_Files* caller, int caller_thread)
 {
   join_timer[i].start();
+  TapeScheduler* queue = caller_thread < 0 ? 0 : tinfo[caller_thread].children;
+  long long resume = 0;
+  if (queue)
+    {
+      // keep the place right after the tapes started so far
+      resume = queue->enqueue();
+      queue->release();
+    }
   pthread_mutex_lock(&t_mutex[i]);
   //printf("Waiting for client to terminate\n");
   if ((tinfo[i].finished)==false)
     { pthread_cond_wait(&client_ready[i],&t_mutex[i]); }
   pthread_mutex_unlock(&t_mutex[i]);
+  if (queue)
+    queue->acquire(resume);
+
+  DataPartition* joined = tinfo[i].partition;
+  tinfo[i].partition = 0;
+  if (joined and caller)
+    {
+      partition_lock.lock();
+      joined->n_running--;
+      // a caller taking part only for its own tapes is the last one left
+      if (caller->joined_partition() and joined->n_running == 1)
+        {
+          caller->leave_partition();
+          joined->n_running--;
+        }
+      if (joined->n_running == 0)
+        {
+          delete partition;
+          partition = 0;
+        }
+      partition_lock.unlock();
+    }
   join_timer[i].stop();
 }
 
@@ -212,20 +312,25 @@ void Machine::run()
       if (numt==0) 
         { flag=false; }
       else
-        { for (int i=0; i<numt; i++)
+        { vector<int> tapes(numt), args(numt);
+          for (int i=0; i<numt; i++)
             {
 	        // Now load up data
-                inpf >> tn;
+                inpf >> tapes[i];
 
                 // Cope with passing an integer parameter to a tape
-                int arg;
                 if (inpf.get() == ':')
-                  inpf >> arg;
+                  inpf >> args[i];
                 else
-                  arg = 0;
-
+                  args[i] = 0;
+            }
+          // take the tickets before any tape can start further tapes
+          long long ticket = scheduler.enqueue(numt);
+          for (int i=0; i<numt; i++)
+            {
+                tn = tapes[i];
                 //cerr << "Run scheduled tape " << tn << " in thread " << i << endl;
-                pos.increase(run_tape(i, tn, arg, exec));
+                pos.increase(run_tape(i, tn, args[i], exec, ticket + i));
             }
           // Make sure all terminate before we continue
           for (int i=0; i<numt; i++)
@@ -236,6 +341,14 @@ void Machine::run()
              pos = tinfo[0].pos;
              usage_unknown = false;
            }
+         partition_lock.lock();
+         if (partition)
+           {
+             pos.set_max(partition->get_end());
+             delete partition;
+             partition = 0;
+           }
+         partition_lock.unlock();
          //printf("Finished running line %d\n",exec);
          exec++;
       }
@@ -278,8 +391,14 @@ void Machine::run()
     cerr << "Join timer: " << i << " " << join_timer[i].elapsed() << endl;
   cerr << "Finish timer: " << finish_timer.elapsed() << endl;
   cerr << "Process timer: " << proc_timer.elapsed() << endl;
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    cerr << "Maximum resident set size: " << usage.ru_maxrss / 1024 << " MB" << endl;
   print_timers();
 
+  if (profile)
+    print_profile();
+
   if (opening_sum < N.num_players() && !direct)
     cerr << "Summed at most " << opening_sum << " shares at once with indirect communication" << endl;
   else
@@ -307,8 +426,9 @@ void Machine::run()
   extern unsigned long long sent_amount, sent_counter;
   cerr << "Data sent = " << sent_amount << " bytes in "
       << sent_counter << " calls,";
-  cerr << sent_amount / sent_counter / N.num_players()
-      << " bytes per call" << endl;
+  if (sent_counter)
+    cerr << sent_amount / sent_counter / N.num_players();
+  cerr << " bytes per call" << endl;
 
   for (int dtype = 0; dtype < N_DTYPE; dtype++)
     {
@@ -337,6 +457,23 @@ void Machine::run()
   cerr << "End of prog" << endl;
 }
 
+void Machine::print_profile()
+{
+  Profiler total;
+  for (auto& profiler : profilers)
+    total.merge(profiler);
+  total.print(cerr);
+
+  if (profile_json.size())
+    {
+      ofstream out(profile_json);
+      if (out.fail())
+        throw file_error(profile_json);
+      total.output_json(out);
+      cerr << "Wrote instruction profile to " << profile_json << endl;
+    }
+}
+
 void BaseMachine::time()
 {
   cout << "Elapsed time: " << timer[0].elapsed() << endl;
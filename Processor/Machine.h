@@ -13,7 +13,11 @@
 
 #include "Processor/Online-Thread.h"
 #include "Processor/Data_Files.h"
+#include "Processor/Profiler.h"
+#include "Processor/TapeScheduler.h"
 #include "Math/gfp.h"
+#include "Networking/BroadcastHash.h"
+#include "Networking/ChannelMux.h"
 
 #include "Tools/time-func.h"
 
@@ -58,6 +62,10 @@ class Machine : public BaseMachine
 
   int tn,numt;
   bool usage_unknown;
+  // Shared by tapes with unknown usage running at the same time,
+  // created, counted and deleted under the lock
+  DataPartition* partition;
+  Lock partition_lock;
 
   public:
 
@@ -82,13 +90,66 @@ class Machine : public BaseMachine
   bool receive_threads;
   int max_broadcast;
 
+  // Bypass the pre-decoded handlers, for comparison
+  bool switch_dispatch;
+  // Map preprocessing files instead of reading them
+  bool mmap_prep;
+  // Wait for preprocessing data from a concurrent producer
+  bool stream_prep;
+
+  // Per-thread instruction profiles, only used if profile is set
+  bool profile;
+  string profile_json;
+  vector<Profiler> profilers;
+
+  // Limits the number of tapes running at once if max_running is set
+  int max_running;
+  TapeScheduler scheduler;
+
+  // Tuples claimed at once by tapes sharing a partition
+  int prep_chunk;
+  // Most tuples of one type fetched from the extension library at once
+  int ext_prefetch;
+
+  // Check MACs of batches of this many openings in the background
+  // if set, holding at most check_pending unchecked values
+  int check_batch, check_pending;
+  // Megabytes of packed MAC check data kept in memory per batch of openings,
+  // that is per thread and field plus per pending batch with check_batch
+  int check_memory;
+
+  // Communicate through one epoll thread per online thread
+  bool event_loop;
+  // Send messages of a round to the same player together
+  bool coalesce;
+  // Compare the broadcast hashes after every this many tapes per thread,
+  // or only at the end if 0
+  int broadcast_check;
+  // Connections shared by all threads, if any
+  ChannelMux* mux;
+
   Machine(int my_number, Names& playerNames, string progname,
       string memtype, int lgp, int lg2, bool direct, int opening_sum, bool parallel,
-      bool receive_threads, int max_broadcast);
-
-  DataPositions run_tape(int thread_number, int tape_number, int arg, int line_number);
-  void join_tape(int thread_number);
+      bool receive_threads, int max_broadcast, bool profile = false,
+      string profile_json = "", bool switch_dispatch = false,
+      bool mmap_prep = false, bool stream_prep = false, int max_running = 0,
+      int prep_chunk = 1000, int check_batch = 0, int check_pending = 0,
+      int check_memory = 0, bool event_loop = false, bool coalesce = false,
+      BroadcastHash::Type broadcast_hash = BroadcastHash::BLAKE2B_HASH,
+      int broadcast_check = 1, ChannelMux* mux = 0, int ext_prefetch = 10000);
+
+  // caller is the data of the tape executing RUN_TAPE in caller_thread,
+  // if any
+  DataPositions run_tape(int thread_number, int tape_number, int arg,
+      int line_number, long long ticket = -1, Data_Files* caller = 0,
+      int caller_thread = -1);
+  // caller as above, the calling tape gives up its slot meanwhile
+  // and continues after the data used by the joined tape
+  void join_tape(int thread_number, Data_Files* caller = 0,
+      int caller_thread = -1);
   void run();
+
+  void print_profile();
 };
 
 #endif /* MACHINE_H_ */
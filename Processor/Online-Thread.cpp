@@ -26,10 +26,26 @@ void* Sub_Main_Func(void* ptr)
   int num=tinfo->thread_num;
   fprintf(stderr, "\tI am in thread %d\n",num);
   Player* player;
-  if (!machine.receive_threads or machine.direct or machine.parallel)
+  if (machine.mux)
+    {
+      cerr << "Using shared connections" << endl;
+      player = new ChannelPlayer(*machine.mux, num);
+    }
+  else if (tinfo->Nms->is_shared_memory())
+    {
+      cerr << "Using shared memory" << endl;
+      player = new ShmPlayer(*(tinfo->Nms), num << 16);
+    }
+  else if (machine.event_loop)
+    {
+      cerr << "Using one thread for all communication" << endl;
+      player = new AsyncPlayer(*(tinfo->Nms), num << 16);
+    }
+  else if (!machine.receive_threads or machine.direct or machine.parallel)
     {
       cerr << "Using single-threaded receiving" << endl;
       player = new Player(*(tinfo->Nms), num << 16);
+      player->set_coalescing(machine.coalesce);
     }
   else
     {
@@ -57,6 +73,15 @@ void* Sub_Main_Func(void* ptr)
       MC2 = new Parallel_MAC_Check<gf2n>(*(tinfo->alpha2i),*(tinfo->Nms), num, machine.opening_sum);
       MCp = new Parallel_MAC_Check<gfp>(*(tinfo->alphapi),*(tinfo->Nms), num, machine.opening_sum);
     }
+  else if (machine.check_batch > 0)
+    {
+      cerr << "Using indirect communication with MAC check in batches of "
+          << machine.check_batch << " in the background." << endl;
+      MC2 = new Background_MAC_Check<gf2n>(*(tinfo->alpha2i),*(tinfo->Nms), num,
+          machine.check_batch, machine.check_pending, machine.opening_sum);
+      MCp = new Background_MAC_Check<gfp>(*(tinfo->alphapi),*(tinfo->Nms), num,
+          machine.check_batch, machine.check_pending, machine.opening_sum);
+    }
   else
     {
       cerr << "Using indirect communication." << endl;
@@ -70,6 +95,7 @@ void* Sub_Main_Func(void* ptr)
 
   bool flag=true;
   int program=-3; 
+  int unchecked_tapes=0;
   // int exec=0;
 
   // synchronize
@@ -101,19 +127,36 @@ void* Sub_Main_Func(void* ptr)
       else
         { // RUN PROGRAM
           //printf("\tClient %d about to run %d in execution %d\n",num,program,exec);
+          wait_timer.start();
+          TapeScheduler* scheduler = tinfo->scheduler;
+          scheduler->acquire(tinfo->ticket);
+          if (machine.scheduler.is_active())
+            tinfo->nested.hold();
+          wait_timer.stop();
           Proc.reset(progs[program],tinfo->arg);
 
           // Bits, Triples, Squares, and Inverses skipping
           DataF.seekg(tinfo->pos);
+          DataF.set_partition(tinfo->partition, num);
              
           //printf("\tExecuting program");
           // Execute the program
-          progs[program].execute(Proc);
+          if (machine.profile)
+            {
+              Profiler& profiler = machine.profilers[num];
+              profiler.set_tape(program);
+              progs[program].execute(Proc, profiler);
+            }
+          else if (machine.switch_dispatch)
+            progs[program].execute_switch(Proc);
+          else
+            progs[program].execute(Proc);
 
          if (progs[program].usage_unknown())
            { // communicate file positions to main thread
              tinfo->pos = DataF.get_usage();
            }
+         DataF.set_partition(0, 0);
 
           //double elapsed = timeval_diff(&startv, &endv);
           //printf("Thread time = %f seconds\n",elapsed/1000000);
@@ -125,8 +168,17 @@ void* Sub_Main_Func(void* ptr)
           MC2->Check(P);
           MCp->Check(P);
           //printf("\tMAC checked\n");
-          P.Check_Broadcast();
+          // the hash keeps accumulating until the next check
+          unchecked_tapes++;
+          if (machine.broadcast_check > 0
+              and unchecked_tapes >= machine.broadcast_check)
+            {
+              P.Check_Broadcast();
+              unchecked_tapes = 0;
+            }
           //printf("\tBroadcast checked\n");
+          tinfo->nested.finish();
+          scheduler->release();
 
          // printf("\tSignalling I have finished\n");
           wait_timer.start();
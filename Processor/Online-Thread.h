@@ -8,6 +8,7 @@
 #include "Math/gfp.h"
 #include "Math/Integer.h"
 #include "Processor/Data_Files.h"
+#include "Processor/TapeScheduler.h"
 
 #include <vector>
 using namespace std;
@@ -31,6 +32,15 @@ class thread_info
   DataPositions pos;
   // Integer arg (optional)
   int arg;
+  // Position in the order of starting tapes in scheduler, see TapeScheduler
+  TapeScheduler* scheduler;
+  long long ticket;
+  // Where tapes started by this tape queue, either the machine's scheduler
+  // or nested
+  TapeScheduler* children;
+  TapeScheduler nested;
+  // Data shared with other tapes if usage is unknown, see Machine::run_tape()
+  DataPartition* partition;
 
   Machine* machine;
 };
@@ -25,6 +25,7 @@ Processor::Processor(int thread_num,Data_Files& DataF,Player& P,
   input2(*this,MC2),inputp(*this,MCp),privateOutput2(*this),privateOutputp(*this),sent(0),rounds(0),
   external_clients(ExternalClients(P.my_num(), DataF.prep_data_dir)),binary_file_io(Binary_File_IO())
 #if defined(EXTENDED_SPDZ)
+  , px_values(NULL), px_size(0)
   , po_shares(NULL), po_opens(NULL), po_size(0)
   , pi_inputs(NULL), pi_size(0)
   , pm_shares(NULL), pm_products(NULL), pm_size(0)
@@ -61,6 +62,9 @@ Processor::Processor(int thread_num,Data_Files& DataF,Player& P,
 	}
 	cout << "SPDZ GF2N extension library initialized." << endl;
 
+	ext_query_mix<gfp>(p_mix_native, p_mix_adds);
+	ext_query_mix<gf2n>(g_mix_native, g_mix_adds);
+
 	alloc_po_mpz(5000);
 	alloc_pm_mpz(5000);
 	mpz_init(mpz_share_aux);
@@ -72,12 +76,20 @@ Processor::~Processor()
 {
   cerr << "Sent " << sent << " elements in " << rounds << " rounds" << endl;
 #if defined(EXTENDED_SPDZ)
+	//rounds still in flight write into their buffers, so wait for them first
+	ext_pending_drain(p_pending_opens, the_ext_lib.x_stop_open, spdz_gfp_ext_handle, "POpen_Stop_Ext_64");
+	ext_pending_drain(p_pending_mults, the_ext_lib.x_stop_mult, spdz_gfp_ext_handle, "PMult_Stop_Ext_64");
+	ext_pending_drain(g_pending_opens, the_ext_lib.x_stop_open, spdz_gf2n_ext_handle, "GOpen_Stop_Ext_64");
+
 	(*the_ext_lib.x_term)(spdz_gfp_ext_handle);
 	(*the_ext_lib.x_term)(spdz_gf2n_ext_handle);
 	dlclose(the_ext_lib.x_lib_handle);
 
 	free_po_mpz();
 	free_pm_mpz();
+	free_px_mpz();
+	for(size_t i = 0; i < ext_pending_spare.size(); i++)
+		delete ext_pending_spare[i];
 	mpz_clear(mpz_share_aux);
 	mpz_clear(mpz_arg_aux);
 #endif
@@ -601,103 +613,82 @@ void Processor::POpen_Ext_64(const vector<int>& reg, int size)
 
 	prep_shares(source, Sh_PO, size);
 
-	//the share values are saved as mpz
-	if(Sh_PO.size() > po_size)
+	if(the_ext_lib.has_limb_abi())
 	{
-		free_po_mpz();
-		alloc_po_mpz(Sh_PO.size());
+		//the extension library reads the shares' canonical limbs and writes the opens' limbs into PO
+		size_t share_stride;
+		const mp_limb_t * share_limbs = PShares2limbs(Sh_PO, share_stride);
+		if(0 != (*the_ext_lib.x_opens_limbs)(spdz_gfp_ext_handle, Sh_PO.size(), gfp::t(),
+				share_limbs, share_stride,
+				(mp_limb_t *)PO.data(), sizeof(gfp) / sizeof(mp_limb_t), 1))
+		{
+			cerr << "Processor::POpen_Ext_64 extension library opens_limbs failed." << endl;
+			dlclose(the_ext_lib.x_lib_handle);
+			abort();
+		}
+		Plimbs2gfps(PO, Sh_PO.size());
 	}
-	PShares2mpz(Sh_PO, po_shares);
-
-	//the extension library is given the shares' values and returns opens' values
-	if(0 != (*the_ext_lib.x_opens)(spdz_gfp_ext_handle, Sh_PO.size(), po_shares, po_opens, 1))
+	else
 	{
-		cerr << "Processor::POpen_Ext_64 extension library start_open failed." << endl;
-		dlclose(the_ext_lib.x_lib_handle);
-		abort();
-	}
+		//the share values are saved as mpz
+		if(Sh_PO.size() > po_size)
+		{
+			free_po_mpz();
+			alloc_po_mpz(Sh_PO.size());
+		}
+		PShares2mpz(Sh_PO, po_shares);
 
-	Pmpz2gfps(po_opens, PO);
+		//the extension library is given the shares' values and returns opens' values
+		if(0 != (*the_ext_lib.x_opens)(spdz_gfp_ext_handle, Sh_PO.size(), po_shares, po_opens, 1))
+		{
+			cerr << "Processor::POpen_Ext_64 extension library start_open failed." << endl;
+			dlclose(the_ext_lib.x_lib_handle);
+			abort();
+		}
+
+		Pmpz2gfps(po_opens, PO);
+	}
 	POpen_Stop_prep_opens(dest, PO, C, size);
 
 	sent += dest.size() * size;
 	rounds++;
 }
 
-/*
 void Processor::POpen_Start_Ext_64(const vector<int>& reg, int size)
 {
-	int sz=reg.size();
-
 	vector< Share<gfp> >& Sh_PO = get_Sh_PO<gfp>();
 	Sh_PO.clear();
-	Sh_PO.reserve(sz*size);
+	Sh_PO.reserve(reg.size()*size);
 
 	prep_shares(reg, Sh_PO, size);
 
-	vector<gfp>& PO = get_PO<gfp>();
-	PO.resize(sz*size);
-
-	//the share values are saved as mpz
-	if(Sh_PO.size() > po_size)
-	{
-		free_po_mpz();
-		alloc_po_mpz(Sh_PO.size());
-	}
-	PShares2mpz(Sh_PO, po_shares);
+	//the share values are saved as mpz in a buffer owned by the pending open
+	Ext_Pending * op = ext_pending_acquire(Sh_PO.size(), Sh_PO.size());
+	PShares2mpz(Sh_PO, op->shares);
 
-	//the extension library is given the shares' values and returns opens' values
-	if(0 != (*the_ext_lib.ext_start_open)(spdz_gfp_ext_handle, Sh_PO.size(), po_shares, po_opens, 1))
-	{
-		cerr << "Processor::POpen_Start_Ext_64 extension library start_open failed." << endl;
-		dlclose(the_ext_lib.ext_lib_handle);
-		abort();
-	}
+	Ext_Start(the_ext_lib.x_start_open, the_ext_lib.x_opens, spdz_gfp_ext_handle, op, "POpen_Start_Ext_64");
+	p_pending_opens.push_back(op);
 }
 
-void Processor::POpen_Stop_Ext_64(const vector<int>& reg,int size)
+void Processor::POpen_Stop_Ext_64(const vector<int>& reg, int size)
 {
 	vector<gfp>& PO = get_PO<gfp>();
 	vector<gfp>& C = get_C<gfp>();
-	int sz=reg.size();
-	PO.resize(sz*size);
+	PO.resize(reg.size()*size);
 
-	if(0 != (*the_ext_lib.ext_stop_open)(spdz_gfp_ext_handle))
-	{
-		cerr << "Processor::POpen_Stop_Ext_64 extension library stop_open failed." << endl;
-		dlclose(the_ext_lib.ext_lib_handle);
-		abort();
-	}
+	Ext_Pending * op = Ext_Stop(p_pending_opens, the_ext_lib.x_stop_open, spdz_gfp_ext_handle, PO.size(), "POpen_Stop_Ext_64");
 
-	Pmpz2gfps(po_opens, PO);
+	Pmpz2gfps(op->results, PO);
 	POpen_Stop_prep_opens(reg, PO, C, size);
+	ext_pending_release(op);
 
 	sent += reg.size() * size;
 	rounds++;
 }
-*/
 
-void Processor::PTriple_Ext_64(Share<gfp>& a, Share<gfp>& b, Share<gfp>& c)
+void Processor::PTriple_Ext_64(const int* reg, int size)
 {
-	mpz_t ma, mb, mc;
-
-	mpz_init(ma);
-	mpz_init(mb);
-	mpz_init(mc);
-
-	if(0 != (*the_ext_lib.x_triple)(spdz_gfp_ext_handle, ma, mb, mc))
-	{
-		cerr << "Processor::PTriple_Ext_64 extension library triple failed." << endl;
-		dlclose(the_ext_lib.x_lib_handle);
-		abort();
-	}
-	Pmpz2share(&ma, a);
-	Pmpz2share(&mb, b);
-	Pmpz2share(&mc, c);
-
-	mpz_clear(ma);
-	mpz_clear(mb);
-	mpz_clear(mc);
+	Ext_Prefetch_Get(p_triples, DATA_TRIPLE, reg, size);
 }
 
 void Processor::PInput_Ext_64(Share<gfp>& input_value, const int input_party_id)
@@ -774,76 +765,75 @@ void Processor::PMult_Ext_64(const vector<int>& reg, int size)
 	vector<gfp>& PO = get_PO<gfp>();
 	PO.resize(sources.size()*size);
 
-	//the share values are saved as mpz
-	if(Sh_PO.size() > pm_size)
+	if(the_ext_lib.has_limb_abi())
 	{
-		free_pm_mpz();
-		alloc_pm_mpz(Sh_PO.size());
-	}
-	PShares2mpz(Sh_PO, pm_shares);
+		//the extension library reads the factors' canonical limbs and writes the products' limbs into PO
+		size_t share_stride;
+		const mp_limb_t * share_limbs = PShares2limbs(Sh_PO, share_stride);
+		if(0 != (*the_ext_lib.x_mult_limbs)(spdz_gfp_ext_handle, Sh_PO.size(), gfp::t(),
+				share_limbs, share_stride,
+				(mp_limb_t *)PO.data(), sizeof(gfp) / sizeof(mp_limb_t), 1))
+		{
+			cerr << "Processor::PMult_Ext_64 extension library mult_limbs failed." << endl;
+			dlclose(the_ext_lib.x_lib_handle);
+			abort();
+		}
+		Plimbs2gfps(PO, Sh_PO.size() / 2);
 
-	if(0 != (*the_ext_lib.x_mult)(spdz_gfp_ext_handle, Sh_PO.size(), pm_shares, pm_products, 1))
-	{
-		cerr << "Processor::PMult_Start_Ext_64 extension library start_mult failed." << endl;
-		dlclose(the_ext_lib.x_lib_handle);
-		abort();
+		PMult_Stop_prep_products(dest, PO, size);
 	}
+	else
+	{
+		//the share values are saved as mpz
+		if(Sh_PO.size() > pm_size)
+		{
+			free_pm_mpz();
+			alloc_pm_mpz(Sh_PO.size());
+		}
+		PShares2mpz(Sh_PO, pm_shares);
+
+		if(0 != (*the_ext_lib.x_mult)(spdz_gfp_ext_handle, Sh_PO.size(), pm_shares, pm_products, 1))
+		{
+			cerr << "Processor::PMult_Start_Ext_64 extension library start_mult failed." << endl;
+			dlclose(the_ext_lib.x_lib_handle);
+			abort();
+		}
 
-	PMult_Stop_prep_products(dest, size);
+		PMult_Stop_prep_products(dest, pm_products, size);
+	}
 
 	sent += dest.size() * size;
 	rounds++;
 }
 
-/*
 void Processor::PMult_Start_Ext_64(const vector<int>& reg, int size)
 {
-	int sz=reg.size();
-
 	vector< Share<gfp> >& Sh_PO = get_Sh_PO<gfp>();
 	Sh_PO.clear();
-	Sh_PO.reserve(sz*size);
+	Sh_PO.reserve(reg.size()*size);
 
 	prep_shares(reg, Sh_PO, size);
 
-	vector<gfp>& PO = get_PO<gfp>();
-	PO.resize(sz*size);
-
-	//the share values are saved as mpz
-	if(Sh_PO.size() > pm_size)
-	{
-		free_pm_mpz();
-		alloc_pm_mpz(Sh_PO.size());
-	}
-	PShares2mpz(Sh_PO, pm_shares);
+	//the factors' values are saved as mpz in a buffer owned by the pending mult
+	Ext_Pending * op = ext_pending_acquire(Sh_PO.size(), Sh_PO.size() / 2);
+	PShares2mpz(Sh_PO, op->shares);
 
-	if(0 != (*the_ext_lib.ext_start_mult)(spdz_gfp_ext_handle, Sh_PO.size(), pm_shares, pm_products, 1))
-	{
-		cerr << "Processor::PMult_Start_Ext_64 extension library start_mult failed." << endl;
-		dlclose(the_ext_lib.ext_lib_handle);
-		abort();
-	}
+	Ext_Start(the_ext_lib.x_start_mult, the_ext_lib.x_mult, spdz_gfp_ext_handle, op, "PMult_Start_Ext_64");
+	p_pending_mults.push_back(op);
 }
-*/
 
-/*
 void Processor::PMult_Stop_Ext_64(const vector<int>& reg, int size)
 {
-	if(0 != (*the_ext_lib.ext_stop_mult)(spdz_gfp_ext_handle))
-	{
-		cerr << "Processor::PMult_Stop_Ext_64 extension library stop_mult failed." << endl;
-		dlclose(the_ext_lib.ext_lib_handle);
-		abort();
-	}
+	Ext_Pending * op = Ext_Stop(p_pending_mults, the_ext_lib.x_stop_mult, spdz_gfp_ext_handle, reg.size() * size, "PMult_Stop_Ext_64");
 
-	PMult_Stop_prep_products(reg, size);
+	PMult_Stop_prep_products(reg, op->results, size);
+	ext_pending_release(op);
 
 	sent += reg.size() * size;
 	rounds++;
 }
-*/
 
-void Processor::PMult_Stop_prep_products(const vector<int>& reg, int size)
+void Processor::PMult_Stop_prep_products(const vector<int>& reg, const mpz_t * products, int size)
 {
 	if (size>1)
 	{
@@ -853,7 +843,7 @@ void Processor::PMult_Stop_prep_products(const vector<int>& reg, int size)
 			vector<Share<gfp> >::iterator insert_point=get_S<gfp>().begin()+*reg_it;
 			for(int i = 0; i < size; ++i)
 			{
-				Pmpz2share(pm_products + (product_idx++), *(insert_point + i));
+				Pmpz2share(products + (product_idx++), *(insert_point + i));
 			}
 		}
 	}
@@ -862,13 +852,32 @@ void Processor::PMult_Stop_prep_products(const vector<int>& reg, int size)
 		int sz=reg.size();
 		for(int i = 0; i < sz; ++i)
 		{
-			Pmpz2share(pm_products + i, get_S_ref<gfp>(reg[i]));
+			Pmpz2share(products + i, get_S_ref<gfp>(reg[i]));
+		}
+	}
+}
+
+void Processor::PMult_Stop_prep_products(const vector<int>& reg, const vector<gfp>& products, int size)
+{
+	size_t product_idx = 0;
+	for (typename vector<int>::const_iterator reg_it=reg.begin(); reg_it!=reg.end(); reg_it++)
+	{
+		vector<Share<gfp> >::iterator insert_point=get_S<gfp>().begin()+*reg_it;
+		for(int i = 0; i < size; ++i)
+		{
+			Pgfp2share(products[product_idx++], *(insert_point + i));
 		}
 	}
 }
 
 void Processor::PAddm_Ext_64(Share<gfp>& a, gfp& b, Share<gfp>& c)
 {
+	if(p_mix_native)
+	{
+		c.add(a, b, p_mix_adds, MCp.get_alphai());
+		ext_mac_share(c);
+		return;
+	}
 	to_bigint(*((bigint*)(&mpz_share_aux)), a.get_share());
 	to_bigint(*((bigint*)(&mpz_arg_aux)), b);
 	if(0 == (*the_ext_lib.x_mix_add)(spdz_gfp_ext_handle, mpz_share_aux, mpz_arg_aux))
@@ -885,6 +894,12 @@ void Processor::PAddm_Ext_64(Share<gfp>& a, gfp& b, Share<gfp>& c)
 
 void Processor::PSubml_Ext_64(Share<gfp>& a, gfp& b, Share<gfp>& c)
 {
+	if(p_mix_native)
+	{
+		c.sub(a, b, p_mix_adds, MCp.get_alphai());
+		ext_mac_share(c);
+		return;
+	}
 	to_bigint(*((bigint*)(&mpz_share_aux)), a.get_share());
 	to_bigint(*((bigint*)(&mpz_arg_aux)), b);
 	if(0 == (*the_ext_lib.x_mix_sub_scalar)(spdz_gfp_ext_handle, mpz_share_aux, mpz_arg_aux))
@@ -901,6 +916,12 @@ void Processor::PSubml_Ext_64(Share<gfp>& a, gfp& b, Share<gfp>& c)
 
 void Processor::PSubmr_Ext_64(gfp& a, Share<gfp>& b, Share<gfp>& c)
 {
+	if(p_mix_native)
+	{
+		c.sub(a, b, p_mix_adds, MCp.get_alphai());
+		ext_mac_share(c);
+		return;
+	}
 	to_bigint(*((bigint*)(&mpz_share_aux)), b.get_share());
 	to_bigint(*((bigint*)(&mpz_arg_aux)), a);
 	if(0 == (*the_ext_lib.x_mix_sub_share)(spdz_gfp_ext_handle, mpz_arg_aux, mpz_share_aux))
@@ -917,6 +938,12 @@ void Processor::PSubmr_Ext_64(gfp& a, Share<gfp>& b, Share<gfp>& c)
 
 void Processor::PLdsi_Ext_64(gfp& value, Share<gfp>& share)
 {
+	if(p_mix_native)
+	{
+		share.assign(value, p_mix_adds? 0: 1, MCp.get_alphai());
+		ext_mac_share(share);
+		return;
+	}
 	to_bigint(*((bigint*)(&mpz_arg_aux)), value);
 	if(0 == (*the_ext_lib.x_share_immediates)(spdz_gfp_ext_handle, 0, 1, &mpz_arg_aux, &mpz_share_aux))
 	{
@@ -930,33 +957,14 @@ void Processor::PLdsi_Ext_64(gfp& value, Share<gfp>& share)
 	}
 }
 
-void Processor::PBit_Ext_64(Share<gfp>& share)
+void Processor::PBit_Ext_64(const int* reg, int size)
 {
-	if(0 == (*the_ext_lib.x_bit)(spdz_gfp_ext_handle, mpz_share_aux))
-	{
-		Pmpz2share(&mpz_share_aux, share);
-	}
-	else
-	{
-		cerr << "Processor::PBit_Ext_64 extension library bit failed." << endl;
-		dlclose(the_ext_lib.x_lib_handle);
-		abort();
-	}
+	Ext_Prefetch_Get(p_bits, DATA_BIT, reg, size);
 }
 
-void Processor::PInverse_Ext_64(Share<gfp>& share_value, Share<gfp>& share_inverse)
+void Processor::PInverse_Ext_64(const int* reg, int size)
 {
-	if(0 == (*the_ext_lib.x_inverse)(spdz_gfp_ext_handle, mpz_share_aux, mpz_arg_aux))
-	{
-		Pmpz2share(&mpz_share_aux, share_value);
-		Pmpz2share(&mpz_arg_aux, share_inverse);
-	}
-	else
-	{
-		cerr << "Processor::PBit_Ext_64 extension library inverse failed." << endl;
-		dlclose(the_ext_lib.x_lib_handle);
-		abort();
-	}
+	Ext_Prefetch_Get(p_inverses, DATA_INVERSE, reg, size);
 }
 
 void Processor::PShares2mpz(const vector< Share<gfp> >& shares, mpz_t * share_values)
@@ -977,10 +985,49 @@ void Processor::Pmpz2gfps(const mpz_t * mpz_values, vector<gfp>& gfps)
 	}
 }
 
+const mp_limb_t * Processor::PShares2limbs(const vector< Share<gfp> >& shares, size_t & stride)
+{
+	const Zp_Data& ZpD = gfp::get_ZpD();
+	if(!ZpD.get_montgomery())
+	{
+		//plain residues already, the library reads the share values in place
+		stride = sizeof(Share<gfp>) / sizeof(mp_limb_t);
+		return (const mp_limb_t *)shares.data();
+	}
+
+	int t = ZpD.get_t();
+	size_t count = shares.size();
+	px_limbs.resize(count * t);
+	for(size_t i = 0; i < count; i++)
+	{
+		ZpD.to_canonical(&px_limbs[i * t], (const mp_limb_t *)&shares[i].get_share());
+	}
+	stride = t;
+	return px_limbs.data();
+}
+
+void Processor::Plimbs2gfps(vector<gfp>& gfps, size_t count)
+{
+	const Zp_Data& ZpD = gfp::get_ZpD();
+	if(!ZpD.get_montgomery())
+		return;
+	for(size_t i = 0; i < count; i++)
+	{
+		mp_limb_t * x = (mp_limb_t *)&gfps[i];
+		ZpD.from_canonical(x, x);
+	}
+}
+
 void Processor::Pmpz2share(const mpz_t * mpzv, Share<gfp> & shv)
 {
-	gfp mac, value;
+	gfp value;
 	to_gfp(value, *((mpz_class*)mpzv));
+	Pgfp2share(value, shv);
+}
+
+void Processor::Pgfp2share(const gfp & value, Share<gfp> & shv)
+{
+	gfp mac;
 	mac.mul(MCp.get_alphai(), value);
 	shv.set_share(value);
 	shv.set_mac(mac);
@@ -1019,78 +1066,40 @@ void Processor::GOpen_Ext_64(const vector<int>& reg, int size)
 	rounds++;
 }
 
-/*
-void Processor::GOpen_Start_Ext_64(const vector<int>& reg,int size)
+void Processor::GOpen_Start_Ext_64(const vector<int>& reg, int size)
 {
-	int sz=reg.size();
-
 	vector< Share<gf2n> >& Sh_PO = get_Sh_PO<gf2n>();
 	Sh_PO.clear();
-	Sh_PO.reserve(sz*size);
+	Sh_PO.reserve(reg.size()*size);
 
 	prep_shares(reg, Sh_PO, size);
 
-	vector<gf2n>& PO = get_PO<gf2n>();
-	PO.resize(sz*size);
-
-	alloc_go_mpz(Sh_PO.size());
-	GShares2mpz(Sh_PO, go_shares);
+	Ext_Pending * op = ext_pending_acquire(Sh_PO.size(), Sh_PO.size());
+	GShares2mpz(Sh_PO, op->shares);
 
-	if(0 != (*the_ext_lib.ext_start_open)(spdz_gf2n_ext_handle, go_size, go_shares, go_opens, 1))
-	{
-		cerr << "Processor::GOpen_Start_Ext_64 extension library start_open failed." << endl;
-		dlclose(the_ext_lib.ext_lib_handle);
-		abort();
-	}
-	else
-	{
-		cout << "Processor::GOpen_Start_Ext_64 extension start open launched." << endl;
-	}
+	Ext_Start(the_ext_lib.x_start_open, the_ext_lib.x_opens, spdz_gf2n_ext_handle, op, "GOpen_Start_Ext_64");
+	g_pending_opens.push_back(op);
 }
-*/
 
-/*
-void Processor::GOpen_Stop_Ext_64(const vector<int>& reg,int size)
+void Processor::GOpen_Stop_Ext_64(const vector<int>& reg, int size)
 {
 	vector<gf2n>& PO = get_PO<gf2n>();
 	vector<gf2n>& C = get_C<gf2n>();
-	int sz=reg.size();
-	PO.resize(sz*size);
+	PO.resize(reg.size()*size);
 
-	if(0 != (*the_ext_lib.ext_stop_open)(spdz_gf2n_ext_handle))
-	{
-		cerr << "Processor::GOpen_Stop_Ext_64 extension library stop_open failed." << endl;
-		dlclose(the_ext_lib.ext_lib_handle);
-		abort();
-	}
+	Ext_Pending * op = Ext_Stop(g_pending_opens, the_ext_lib.x_stop_open, spdz_gf2n_ext_handle, PO.size(), "GOpen_Stop_Ext_64");
 
-	Gmpz2gf2ns(go_opens, PO);
-	free_go_mpz();
+	Gmpz2gf2ns(op->results, PO);
 	POpen_Stop_prep_opens(reg, PO, C, size);
+	ext_pending_release(op);
 
 	sent += reg.size() * size;
 	rounds++;
 }
-*/
 
-void Processor::GTriple_Ext_64(Share<gf2n>& a, Share<gf2n>& b, Share<gf2n>& c)
+void Processor::GTriple_Ext_64(const int* reg, int size)
 {
-	mpz_t mpza, mpzb, mpzc;
-	mpz_init(mpza);
-	mpz_init(mpzb);
-	mpz_init(mpzc);
-	if(0 != (*the_ext_lib.x_triple)(spdz_gf2n_ext_handle, mpza, mpzb, mpzc))
-	{
-		cerr << "Processor::GTriple_Ext_64 extension library triple failed." << endl;
-		dlclose(the_ext_lib.x_lib_handle);
-		abort();
-	}
-	Gmpz2share(&mpza, a);
-	Gmpz2share(&mpzb, b);
-	Gmpz2share(&mpzc, c);
-	mpz_clear(mpza);
-	mpz_clear(mpzb);
-	mpz_clear(mpzc);
+	Ext_Prefetch_Get(g_triples, DATA_TRIPLE, reg, size);
 }
 
 void Processor::GInput_Ext_64(Share<gf2n>& input_value, const int input_party_id)
@@ -1223,6 +1232,12 @@ void Processor::GMult_Stop_prep_products(const vector<int>& reg, int size)
 
 void Processor::GAddm_Ext_64(Share<gf2n>& a, gf2n& b, Share<gf2n>& c)
 {
+	if(g_mix_native)
+	{
+		c.add(a, b, g_mix_adds, MC2.get_alphai());
+		ext_mac_share(c);
+		return;
+	}
 	mpz_set_ui(mpz_share_aux, a.get_share().get_word());
 	mpz_set_ui(mpz_arg_aux, b.get_word());
 	if(0 == (*the_ext_lib.x_mix_add)(spdz_gf2n_ext_handle, mpz_share_aux, mpz_arg_aux))
@@ -1239,6 +1254,12 @@ void Processor::GAddm_Ext_64(Share<gf2n>& a, gf2n& b, Share<gf2n>& c)
 
 void Processor::GSubml_Ext_64(Share<gf2n>& a, gf2n& b, Share<gf2n>& c)
 {
+	if(g_mix_native)
+	{
+		c.sub(a, b, g_mix_adds, MC2.get_alphai());
+		ext_mac_share(c);
+		return;
+	}
 	mpz_set_ui(mpz_share_aux, a.get_share().get_word());
 	mpz_set_ui(mpz_arg_aux, b.get_word());
 	if(0 == (*the_ext_lib.x_mix_sub_scalar)(spdz_gf2n_ext_handle, mpz_share_aux, mpz_arg_aux))
@@ -1255,6 +1276,12 @@ void Processor::GSubml_Ext_64(Share<gf2n>& a, gf2n& b, Share<gf2n>& c)
 
 void Processor::GSubmr_Ext_64(gf2n& a, Share<gf2n>& b, Share<gf2n>& c)
 {
+	if(g_mix_native)
+	{
+		c.sub(a, b, g_mix_adds, MC2.get_alphai());
+		ext_mac_share(c);
+		return;
+	}
 	mpz_set_ui(mpz_share_aux, b.get_share().get_word());
 	mpz_set_ui(mpz_arg_aux, a.get_word());
 	if(0 == (*the_ext_lib.x_mix_sub_share)(spdz_gf2n_ext_handle, mpz_arg_aux, mpz_share_aux))
@@ -1271,6 +1298,12 @@ void Processor::GSubmr_Ext_64(gf2n& a, Share<gf2n>& b, Share<gf2n>& c)
 
 void Processor::GLdsi_Ext_64(gf2n& value, Share<gf2n>& share)
 {
+	if(g_mix_native)
+	{
+		share.assign(value, g_mix_adds? 0: 1, MC2.get_alphai());
+		ext_mac_share(share);
+		return;
+	}
 	mpz_set_ui(mpz_arg_aux, value.get_word());
 	if(0 == (*the_ext_lib.x_share_immediates)(spdz_gf2n_ext_handle, 0, 1, &mpz_arg_aux, &mpz_share_aux))
 	{
@@ -1284,33 +1317,14 @@ void Processor::GLdsi_Ext_64(gf2n& value, Share<gf2n>& share)
 	}
 }
 
-void Processor::GBit_Ext_64(Share<gf2n>& share)
+void Processor::GBit_Ext_64(const int* reg, int size)
 {
-	if(0 == (*the_ext_lib.x_bit)(spdz_gf2n_ext_handle, mpz_share_aux))
-	{
-		Gmpz2share(&mpz_share_aux, share);
-	}
-	else
-	{
-		cerr << "Processor::GBit_Ext_64 extension library bit failed." << endl;
-		dlclose(the_ext_lib.x_lib_handle);
-		abort();
-	}
+	Ext_Prefetch_Get(g_bits, DATA_BIT, reg, size);
 }
 
-void Processor::GInverse_Ext_64(Share<gf2n>& share_value, Share<gf2n>& share_inverse)
+void Processor::GInverse_Ext_64(const int* reg, int size)
 {
-	if(0 == (*the_ext_lib.x_inverse)(spdz_gf2n_ext_handle, mpz_share_aux, mpz_arg_aux))
-	{
-		Gmpz2share(&mpz_share_aux, share_value);
-		Gmpz2share(&mpz_arg_aux, share_inverse);
-	}
-	else
-	{
-		cerr << "Processor::GInverse_Ext_64 extension library inverse failed." << endl;
-		dlclose(the_ext_lib.x_lib_handle);
-		abort();
-	}
+	Ext_Prefetch_Get(g_inverses, DATA_INVERSE, reg, size);
 }
 
 void Processor::GShares2mpz(const vector< Share<gf2n> >& shares, mpz_t * share_values)
@@ -1341,9 +1355,226 @@ void Processor::Gmpz2share(const mpz_t * mpzv, Share<gf2n> & shv)
 
 }
 
+template <class T>
+void Processor::Ext_Prefetch_Get(Ext_Prefetch<T>& buffer, Dtype dtype, const int* reg, int size)
+{
+	int tuple_size = Data_Files::tuple_size[dtype];
+	if(buffer.left() < (size_t)size * tuple_size)
+		Ext_Prefetch_Fill(buffer, dtype, size);
+
+	for(int i = 0; i < size; i++)
+		for(int j = 0; j < tuple_size; j++)
+			get_S_ref<T>(reg[j] + i) = buffer.shares[buffer.next++];
+}
+
+template <class T>
+void Processor::Ext_Prefetch_Fill(Ext_Prefetch<T>& buffer, Dtype dtype, size_t required)
+{
+	int tuple_size = Data_Files::tuple_size[dtype];
+
+	//keep the unused tuples and fetch at least a chunk with one call,
+	//growing the chunks so that programs using few tuples do not wait for many
+	buffer.shares.erase(buffer.shares.begin(), buffer.shares.begin() + buffer.next);
+	buffer.next = 0;
+	buffer.batch = min(buffer.batch ? 2 * buffer.batch : (size_t)SPDZ_EXT_PREFETCH_START,
+			(size_t)machine.ext_prefetch);
+	size_t count = max(buffer.batch, required - buffer.shares.size() / tuple_size);
+
+	if(count * tuple_size > px_size)
+	{
+		free_px_mpz();
+		alloc_px_mpz(count * tuple_size);
+	}
+
+	//the tuple components are returned component-wise: px_values[j * count + i]
+	void * handle = get_ext_handle<T>();
+	int result = 0;
+	switch(dtype)
+	{
+	case DATA_TRIPLE:
+		if(NULL != the_ext_lib.x_triples)
+			result = (*the_ext_lib.x_triples)(handle, count, px_values, px_values + count, px_values + 2 * count);
+		else
+			for(size_t i = 0; i < count && 0 == result; i++)
+				result = (*the_ext_lib.x_triple)(handle, px_values[i], px_values[count + i], px_values[2 * count + i]);
+		break;
+	case DATA_BIT:
+		if(NULL != the_ext_lib.x_bits)
+			result = (*the_ext_lib.x_bits)(handle, count, px_values);
+		else
+			for(size_t i = 0; i < count && 0 == result; i++)
+				result = (*the_ext_lib.x_bit)(handle, px_values[i]);
+		break;
+	case DATA_INVERSE:
+		if(NULL != the_ext_lib.x_inverses)
+			result = (*the_ext_lib.x_inverses)(handle, count, px_values, px_values + count);
+		else
+			for(size_t i = 0; i < count && 0 == result; i++)
+				result = (*the_ext_lib.x_inverse)(handle, px_values[i], px_values[count + i]);
+		break;
+	default:
+		throw not_implemented();
+	}
+
+	if(0 != result)
+	{
+		cerr << "Processor::Ext_Prefetch_Fill extension library " << Data_Files::dtype_names[dtype] << " failed." << endl;
+		dlclose(the_ext_lib.x_lib_handle);
+		abort();
+	}
+
+	size_t offset = buffer.shares.size();
+	buffer.shares.resize(offset + count * tuple_size);
+	for(size_t i = 0; i < count; i++)
+		for(int j = 0; j < tuple_size; j++)
+			ext_mpz2share(px_values + j * count + i, buffer.shares[offset + i * tuple_size + j]);
+}
+
+template <class T>
+void Processor::ext_query_mix(bool & native, bool & adds)
+{
+	native = adds = false;
+	if(NULL == the_ext_lib.x_mix_descriptor)
+		return;
+
+	spdz_ext_mix_descriptor descriptor;
+	if(0 != (*the_ext_lib.x_mix_descriptor)(get_ext_handle<T>(), &descriptor))
+	{
+		cerr << "Processor::ext_query_mix extension library mix_descriptor failed; using library mixed operations." << endl;
+		return;
+	}
+	if(SPDZ_EXT_MIX_ALL_PARTIES != descriptor.constant_party
+			&& (descriptor.constant_party < 0 || descriptor.constant_party >= P.num_players()))
+	{
+		cerr << "Processor::ext_query_mix invalid constant party " << descriptor.constant_party << endl;
+		return;
+	}
+	adds = (SPDZ_EXT_MIX_ALL_PARTIES == descriptor.constant_party || P.my_num() == descriptor.constant_party);
+	native = ext_check_mix<T>(adds);
+	if(!native)
+		cerr << "Processor::ext_query_mix local " << T::type_string() << " ADDM does not match the extension library; using library mixed operations." << endl;
+}
+
+template <class T>
+bool Processor::ext_check_mix(bool adds)
+{
+	//a share of 3 plus the constant 5 through the library, and locally as ADDM does
+	mpz_t share, scalar;
+	mpz_init_set_ui(share, 3);
+	mpz_init_set_ui(scalar, 5);
+	int result = (*the_ext_lib.x_mix_add)(get_ext_handle<T>(), share, scalar);
+	Share<T> by_library, start, local;
+	ext_mpz2share(&share, by_library);
+	mpz_clear(share);
+	mpz_clear(scalar);
+	if(0 != result)
+		return false;
+
+	T value, constant;
+	value.assign(3);
+	constant.assign(5);
+	start.set_share(value);
+	ext_mac_share(start);
+	local.add(start, constant, adds, ext_alphai<T>());
+	ext_mac_share(local);
+	return by_library.get_share().equal(local.get_share()) && by_library.get_mac().equal(local.get_mac());
+}
+
+Ext_Pending * Processor::ext_pending_acquire(size_t share_count, size_t result_count)
+{
+	Ext_Pending * op;
+	if(ext_pending_spare.empty())
+		op = new Ext_Pending;
+	else
+	{
+		op = ext_pending_spare.back();
+		ext_pending_spare.pop_back();
+	}
+	op->reserve(share_count);
+	op->share_count = share_count;
+	op->result_count = result_count;
+	op->ticket = 0;
+	op->done = false;
+	return op;
+}
+
+void Processor::ext_pending_release(Ext_Pending * op)
+{
+	ext_pending_spare.push_back(op);
+}
+
+void Processor::ext_pending_drain(deque<Ext_Pending *>& pending, spdz_ext_stop_method_t stop,
+		void * handle, const char * caller)
+{
+	if(!pending.empty())
+		cerr << "Processor::" << caller << " " << pending.size() << " started rounds never stopped." << endl;
+	for(size_t i = 0; i < pending.size(); i++)
+	{
+		if(!pending[i]->done && 0 != (*stop)(handle, pending[i]->ticket))
+			cerr << "Processor::" << caller << " extension library stop failed." << endl;
+		delete pending[i];
+	}
+	pending.clear();
+}
+
+void Processor::Ext_Start(spdz_ext_start_method_t start, spdz_ext_batch_method_t batch,
+		void * handle, Ext_Pending * op, const char * caller)
+{
+	int result;
+	if(NULL != start)
+	{
+		//the library launches the round and returns at once; the buffers must live until stop
+		result = (*start)(handle, op->share_count, op->shares, op->results, 1, &op->ticket);
+	}
+	else
+	{
+		//no asynchronous support in the library: complete the round now, stop only collects it
+		result = (*batch)(handle, op->share_count, op->shares, op->results, 1);
+		op->done = true;
+	}
+
+	if(0 != result)
+	{
+		cerr << "Processor::" << caller << " extension library start failed." << endl;
+		dlclose(the_ext_lib.x_lib_handle);
+		abort();
+	}
+}
+
+Ext_Pending * Processor::Ext_Stop(deque<Ext_Pending *>& pending, spdz_ext_stop_method_t stop,
+		void * handle, size_t result_count, const char * caller)
+{
+	if(pending.empty())
+	{
+		cerr << "Processor::" << caller << " without a matching start." << endl;
+		throw Processor_Error("stop instruction without start");
+	}
+
+	Ext_Pending * op = pending.front();
+	pending.pop_front();
+
+	if(op->result_count != result_count)
+	{
+		cerr << "Processor::" << caller << " mismatched number of results " << result_count << "/" << op->result_count << endl;
+		throw Processor_Error("stop instruction does not match start");
+	}
+
+	if(!op->done && 0 != (*stop)(handle, op->ticket))
+	{
+		cerr << "Processor::" << caller << " extension library stop failed." << endl;
+		dlclose(the_ext_lib.x_lib_handle);
+		abort();
+	}
+	op->done = true;
+	return op;
+}
+
 #define LOAD_LIB_METHOD(Name,Proc)	\
 if(0 != load_extension_method(Name, (void**)(&Proc), x_lib_handle)) { dlclose(x_lib_handle); abort(); }
 
+#define LOAD_LIB_OPTIONAL_METHOD(Name,Proc)	\
+load_extension_method(Name, (void**)(&Proc), x_lib_handle, false);
+
 spdz_ext_ifc::spdz_ext_ifc()
 {
 	x_lib_handle = NULL;
@@ -1361,6 +1592,18 @@ spdz_ext_ifc::spdz_ext_ifc()
 	*(void**)(&x_share_immediates) = NULL;
 	*(void**)(&x_bit) = NULL;
 	*(void**)(&x_inverse) = NULL;
+	*(void**)(&x_triples) = NULL;
+	*(void**)(&x_bits) = NULL;
+	*(void**)(&x_inverses) = NULL;
+	*(void**)(&x_mix_descriptor) = NULL;
+	*(void**)(&x_start_open) = NULL;
+	*(void**)(&x_stop_open) = NULL;
+	*(void**)(&x_start_mult) = NULL;
+	*(void**)(&x_stop_mult) = NULL;
+	*(void**)(&x_abi_version) = NULL;
+	*(void**)(&x_opens_limbs) = NULL;
+	*(void**)(&x_mult_limbs) = NULL;
+	abi_version = SPDZ_EXT_ABI_MPZ;
 
 
 	//get the SPDZ-2 extension library for env-var
@@ -1405,6 +1648,30 @@ spdz_ext_ifc::spdz_ext_ifc()
 	LOAD_LIB_METHOD("share_immediates", x_share_immediates)
 	LOAD_LIB_METHOD("bit", x_bit)
 	LOAD_LIB_METHOD("inverse", x_inverse)
+	LOAD_LIB_OPTIONAL_METHOD("triples", x_triples)
+	LOAD_LIB_OPTIONAL_METHOD("bits", x_bits)
+	LOAD_LIB_OPTIONAL_METHOD("inverses", x_inverses)
+	LOAD_LIB_OPTIONAL_METHOD("mix_descriptor", x_mix_descriptor)
+
+	//asynchronous rounds are used only if both start and stop are provided
+	LOAD_LIB_OPTIONAL_METHOD("start_open", x_start_open)
+	LOAD_LIB_OPTIONAL_METHOD("stop_open", x_stop_open)
+	if(NULL == x_stop_open)
+		x_start_open = NULL;
+	LOAD_LIB_OPTIONAL_METHOD("start_mult", x_start_mult)
+	LOAD_LIB_OPTIONAL_METHOD("stop_mult", x_stop_mult)
+	if(NULL == x_stop_mult)
+		x_start_mult = NULL;
+
+	//the limb-array ABI is optional; it is used only if fully provided
+	LOAD_LIB_OPTIONAL_METHOD("abi_version", x_abi_version)
+	if(NULL != x_abi_version && (*x_abi_version)() >= SPDZ_EXT_ABI_LIMBS)
+	{
+		LOAD_LIB_METHOD("opens_limbs", x_opens_limbs)
+		LOAD_LIB_METHOD("mult_limbs", x_mult_limbs)
+		abi_version = SPDZ_EXT_ABI_LIMBS;
+	}
+	cout << "extension library ABI version " << abi_version << endl;
 
 }
 
@@ -1413,12 +1680,15 @@ spdz_ext_ifc::~spdz_ext_ifc()
 	dlclose(x_lib_handle);
 }
 
-int spdz_ext_ifc::load_extension_method(const char * method_name, void ** proc_addr, void * libhandle)
+int spdz_ext_ifc::load_extension_method(const char * method_name, void ** proc_addr, void * libhandle, bool required)
 {
 	*proc_addr = dlsym(libhandle, method_name);
 	const char * dlsym_error = dlerror();
 	if(NULL != dlsym_error || NULL == *proc_addr)
 	{
+		*proc_addr = NULL;
+		if(!required)
+			return -1;
 		cerr << "failed to load " << method_name << " extension [" << ((NULL != dlsym_error)? dlsym_error: "") << "]" << endl;
 		return -1;
 	}
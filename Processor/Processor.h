@@ -24,6 +24,64 @@
 #include "Instruction.h"
 
 #include <stack>
+#include <deque>
+
+// number of tuples fetched by the first extension call per type,
+// later calls fetch twice as many as before up to Machine::ext_prefetch
+#define SPDZ_EXT_PREFETCH_START	100
+
+#if defined(EXTENDED_SPDZ)
+// blocking round, start and stop of an asynchronous round of the extension
+typedef int (*spdz_ext_batch_method_t)(void * handle, const size_t share_count, const mpz_t * shares, mpz_t * results, int verify);
+typedef int (*spdz_ext_start_method_t)(void * handle, const size_t share_count, const mpz_t * shares, mpz_t * results, int verify, size_t * ticket);
+typedef int (*spdz_ext_stop_method_t)(void * handle, const size_t ticket);
+
+template<class T>
+class Ext_Prefetch
+{
+public:
+  vector< Share<T> > shares;
+  size_t next;
+  // tuples fetched by the last call
+  size_t batch;
+
+  Ext_Prefetch() : next(0), batch(0) {}
+  size_t left() const { return shares.size() - next; }
+};
+
+// mpz buffers of an open or mult round handed to the extension until it is stopped
+class Ext_Pending
+{
+  Ext_Pending(const Ext_Pending&);
+  Ext_Pending& operator=(const Ext_Pending&);
+
+public:
+  size_t ticket;
+  bool done;
+  size_t share_count, result_count, capacity;
+  mpz_t * shares, * results;
+
+  Ext_Pending() : ticket(0), done(false), share_count(0), result_count(0), capacity(0), shares(NULL), results(NULL) {}
+  ~Ext_Pending() { free(); }
+
+  void reserve(size_t required)
+  {
+	  if(required <= capacity)
+		  return;
+	  free();
+	  shares = new mpz_t[capacity = required];
+	  results = new mpz_t[capacity];
+	  for(size_t i = 0; i < capacity; i++) { mpz_init(shares[i]); mpz_init(results[i]); }
+  }
+  void free()
+  {
+	  for(size_t i = 0; i < capacity; i++) { mpz_clear(shares[i]); mpz_clear(results[i]); }
+	  delete [] shares; shares = NULL;
+	  delete [] results; results = NULL;
+	  capacity = 0;
+  }
+};
+#endif
 
 class ProcessorBase
 {
@@ -287,31 +345,38 @@ class Processor : public ProcessorBase
   public:
 
   void POpen_Ext_64(const vector<int>& reg,int size);
-  //void POpen_Start_Ext_64(const vector<int>& reg,int size);
-  //void POpen_Stop_Ext_64(const vector<int>& reg,int size);
-  void PTriple_Ext_64(Share<gfp>& a, Share<gfp>& b, Share<gfp>& c);
+  void POpen_Start_Ext_64(const vector<int>& reg,int size);
+  void POpen_Stop_Ext_64(const vector<int>& reg,int size);
+  void PTriple_Ext_64(const int* reg, int size);
   void PInput_Ext_64(Share<gfp>& input_value, const int input_party_id);
   //void PInput_Start_Ext_64(int player, int n_inputs);
   //void PInput_Stop_Ext_64(int player, vector<int> targets);
   void PMult_Ext_64(const vector<int>& reg, int size);
-  //void PMult_Start_Ext_64(const vector<int>& reg, int size);
-  //void PMult_Stop_Ext_64(const vector<int>& reg, int size);
-  void PMult_Stop_prep_products(const vector<int>& reg, int size);
+  void PMult_Start_Ext_64(const vector<int>& reg, int size);
+  void PMult_Stop_Ext_64(const vector<int>& reg, int size);
+  void PMult_Stop_prep_products(const vector<int>& reg, const mpz_t * products, int size);
+  void PMult_Stop_prep_products(const vector<int>& reg, const vector<gfp>& products, int size);
   void PAddm_Ext_64(Share<gfp>& a, gfp& b, Share<gfp>& c);
   void PSubml_Ext_64(Share<gfp>& a, gfp& b, Share<gfp>& c);
   void PSubmr_Ext_64(gfp& a, Share<gfp>& b, Share<gfp>& c);
   void PLdsi_Ext_64(gfp& value, Share<gfp>& share);
-  void PBit_Ext_64(Share<gfp>& share);
-  void PInverse_Ext_64(Share<gfp>& share_value, Share<gfp>& share_inverse);
+  void PBit_Ext_64(const int* reg, int size);
+  void PInverse_Ext_64(const int* reg, int size);
 
   void PShares2mpz(const vector< Share<gfp> >& shares, mpz_t * share_values);
   void Pmpz2gfps(const mpz_t * mpz_values, vector<gfp>& gfps);
   void Pmpz2share(const mpz_t * mpzv, Share<gfp> & shv);
+  void Pgfp2share(const gfp & value, Share<gfp> & shv);
+
+  // limb-array ABI: canonical copies of the share values unless gfp is plain already
+  vector<mp_limb_t> px_limbs;
+  const mp_limb_t * PShares2limbs(const vector< Share<gfp> >& shares, size_t & stride);
+  void Plimbs2gfps(vector<gfp>& gfps, size_t count);
 
   void GOpen_Ext_64(const vector<int>& reg,int size);
-  //void GOpen_Start_Ext_64(const vector<int>& reg,int size);
-  //void GOpen_Stop_Ext_64(const vector<int>& reg,int size);
-  void GTriple_Ext_64(Share<gf2n>& a, Share<gf2n>& b, Share<gf2n>& c);
+  void GOpen_Start_Ext_64(const vector<int>& reg,int size);
+  void GOpen_Stop_Ext_64(const vector<int>& reg,int size);
+  void GTriple_Ext_64(const int* reg, int size);
   void GInput_Ext_64(Share<gf2n>& input_value, const int input_party_id);
   //void GInput_Start_Ext_64(int player, int n_inputs);
   //void GInput_Stop_Ext_64(int player, vector<int> targets);
@@ -322,14 +387,69 @@ class Processor : public ProcessorBase
   void GSubml_Ext_64(Share<gf2n>& a, gf2n& b, Share<gf2n>& c);
   void GSubmr_Ext_64(gf2n& a, Share<gf2n>& b, Share<gf2n>& c);
   void GLdsi_Ext_64(gf2n& value, Share<gf2n>& share);
-  void GBit_Ext_64(Share<gf2n>& share);
-  void GInverse_Ext_64(Share<gf2n>& share_value, Share<gf2n>& share_inverse);
+  void GBit_Ext_64(const int* reg, int size);
+  void GInverse_Ext_64(const int* reg, int size);
 
   void GShares2mpz(const vector< Share<gf2n> >& shares, mpz_t * share_values);
   void Gmpz2gf2ns(const mpz_t * mpz_values, vector<gf2n>& gf2ns);
   void Gmpz2share(const mpz_t * mpzv, Share<gf2n> & shv);
 
+  template <class T>
+  void Ext_Prefetch_Get(Ext_Prefetch<T>& buffer, Dtype dtype, const int* reg, int size);
+  template <class T>
+  void Ext_Prefetch_Fill(Ext_Prefetch<T>& buffer, Dtype dtype, size_t required);
+
+  template <class T>
+  void * get_ext_handle();
+  template <class T>
+  void ext_mpz2share(const mpz_t * mpzv, Share<T> & shv);
+
   void * spdz_gfp_ext_handle, * spdz_gf2n_ext_handle;
+
+  // mixed share/constant operations done locally, and whether this party adds the constant
+  bool p_mix_native, g_mix_native;
+  bool p_mix_adds, g_mix_adds;
+  template <class T>
+  void ext_query_mix(bool & native, bool & adds);
+  template <class T>
+  bool ext_check_mix(bool adds);
+  template <class T>
+  const T& ext_alphai();
+  // the extension path MACs every share it returns as alpha_i times its value
+  template <class T>
+  void ext_mac_share(Share<T> & shv) { T mac; mac.mul(ext_alphai<T>(), shv.get_share()); shv.set_mac(mac); }
+
+  // rounds started but not yet stopped, in instruction order
+  deque<Ext_Pending *> p_pending_opens, p_pending_mults, g_pending_opens;
+  vector<Ext_Pending *> ext_pending_spare;
+  Ext_Pending * ext_pending_acquire(size_t share_count, size_t result_count);
+  void ext_pending_release(Ext_Pending * op);
+  // wait for rounds that are still in flight and free them
+  void ext_pending_drain(deque<Ext_Pending *>& pending, spdz_ext_stop_method_t stop,
+		  void * handle, const char * caller);
+
+  void Ext_Start(spdz_ext_start_method_t start, spdz_ext_batch_method_t batch,
+		  void * handle, Ext_Pending * op, const char * caller);
+  Ext_Pending * Ext_Stop(deque<Ext_Pending *>& pending, spdz_ext_stop_method_t stop,
+		  void * handle, size_t result_count, const char * caller);
+
+  // preprocessed tuples fetched from the extension in chunks
+  Ext_Prefetch<gfp> p_triples, p_bits, p_inverses;
+  Ext_Prefetch<gf2n> g_triples, g_bits, g_inverses;
+
+  mpz_t * px_values;
+  size_t px_size;
+  void alloc_px_mpz(const size_t required_size)
+  {
+	  px_values = new mpz_t[px_size = required_size];
+	  for(size_t i = 0; i < px_size; i++) mpz_init(px_values[i]);
+  }
+  void free_px_mpz()
+  {
+	  for(size_t i = 0; i < px_size; i++) mpz_clear(px_values[i]);
+	  delete [] px_values; px_values = NULL;
+	  px_size = 0;
+  }
   mpz_t mpz_share_aux, mpz_arg_aux;
 
   mpz_t * po_shares, * po_opens;
@@ -448,6 +568,20 @@ class Processor : public ProcessorBase
 
 };
 
+#define SPDZ_EXT_ABI_MPZ		1
+#define SPDZ_EXT_ABI_LIMBS		2
+
+// constant_party value of a library whose every party adds public constants
+#define SPDZ_EXT_MIX_ALL_PARTIES	(-1)
+
+/* Affine behaviour of a library's sharing, reported once per handle: adding a
+ * public constant c to a share adds c to the share of constant_party only (or of
+ * every party), which is what ADDM, SUBML, SUBMR and LDSI need to run locally. */
+typedef struct
+{
+	int constant_party;
+} spdz_ext_mix_descriptor;
+
 class spdz_ext_ifc
 {
 public:
@@ -484,9 +618,54 @@ public:
 
     int (*x_inverse)(void * handle, mpz_t share_value, mpz_t share_inverse);
 
-    static int load_extension_method(const char * method_name, void ** proc_addr, void * libhandle);
+    /* Optional batched preprocessing: count tuples per call, one array per tuple component.
+     * If absent, the single-tuple methods above are called count times instead. */
+    int (*x_triples)(void * handle, const size_t count, mpz_t * a, mpz_t * b, mpz_t * c);
+
+    int (*x_bits)(void * handle, const size_t count, mpz_t * bits);
+
+    int (*x_inverses)(void * handle, const size_t count, mpz_t * values, mpz_t * inverses);
+
+    /* Optional ABI v2 (SPDZ_EXT_ABI_LIMBS): shares and results are passed as
+     * fixed-width little-endian limb arrays of limb_count limbs each, read
+     * with the given strides (in limbs). Values are canonical (non-Montgomery)
+     * residues: the processor converts from and to its Montgomery form at the
+     * call, and passes the Share<gfp>/gfp vectors in place if gfp is plain.
+     * 61/63-bit primes use a single uint64_t limb. The mpz_t based methods
+     * above remain mandatory. */
+    int (*x_abi_version)();
+
+    int (*x_opens_limbs)(void * handle, const size_t share_count, const size_t limb_count,
+    				const mp_limb_t * shares, const size_t share_stride,
+    				mp_limb_t * opens, const size_t open_stride, int verify);
+
+    int (*x_mult_limbs)(void * handle, const size_t share_count, const size_t limb_count,
+    				const mp_limb_t * shares, const size_t share_stride,
+    				mp_limb_t * products, const size_t product_stride, int verify);
+
+    int abi_version;
+
+    bool has_limb_abi() const { return abi_version >= SPDZ_EXT_ABI_LIMBS; }
+
+    // optional; without it every mixed operation is passed to the library
+    int (*x_mix_descriptor)(void * handle, spdz_ext_mix_descriptor * descriptor);
+
+    /* Optional asynchronous rounds: start_* launches the round on the given buffers and
+     * returns a ticket, stop_* blocks until the round of that ticket is complete.
+     * Without them, STARTOPEN/E_STARTMULT run the blocking opens/mult instead. */
+    int (*x_start_open)(void * handle, const size_t share_count, const mpz_t * shares, mpz_t * opens, int verify, size_t * ticket);
+
+    int (*x_stop_open)(void * handle, const size_t ticket);
+
+    int (*x_start_mult)(void * handle, const size_t share_count, const mpz_t * shares, mpz_t * products, int verify, size_t * ticket);
+
+    int (*x_stop_mult)(void * handle, const size_t ticket);
+
+    static int load_extension_method(const char * method_name, void ** proc_addr, void * libhandle, bool required = true);
 };
 
+extern spdz_ext_ifc the_ext_lib;
+
 template<> inline Share<gf2n>& Processor::get_S_ref(int i) { return get_S2_ref(i); }
 template<> inline gf2n& Processor::get_C_ref(int i)        { return get_C2_ref(i); }
 template<> inline Share<gfp>& Processor::get_S_ref(int i)  { return get_Sp_ref(i); }
@@ -503,5 +682,16 @@ template<> inline vector<gf2n>& Processor::get_PO()               { return PO2;
 template<> inline vector< Share<gfp> >& Processor::get_Sh_PO()    { return Sh_POp; }
 template<> inline vector<gfp>& Processor::get_PO()                { return POp; }
 
+#if defined(EXTENDED_SPDZ)
+template<> inline void * Processor::get_ext_handle<gf2n>()        { return spdz_gf2n_ext_handle; }
+template<> inline void * Processor::get_ext_handle<gfp>()         { return spdz_gfp_ext_handle; }
+
+template<> inline void Processor::ext_mpz2share(const mpz_t * mpzv, Share<gf2n> & shv) { Gmpz2share(mpzv, shv); }
+template<> inline void Processor::ext_mpz2share(const mpz_t * mpzv, Share<gfp> & shv)  { Pmpz2share(mpzv, shv); }
+
+template<> inline const gf2n& Processor::ext_alphai()             { return MC2.get_alphai(); }
+template<> inline const gfp& Processor::ext_alphai()              { return MCp.get_alphai(); }
+#endif
+
 #endif
 
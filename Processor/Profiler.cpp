@@ -0,0 +1,181 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * Profiler.cpp
+ *
+ */
+
+#include "Processor/Profiler.h"
+#include "Processor/Processor.h"
+#include "Tools/time-func.h"
+
+#include <algorithm>
+#include <iomanip>
+
+OpcodeStats::OpcodeStats() :
+    count(0), wall_ns(0), cpu_ns(0), sent(0), rounds(0),
+    comm_data(0), comm_rounds(0)
+{
+}
+
+OpcodeStats& OpcodeStats::operator+=(const OpcodeStats& other)
+{
+  count += other.count;
+  wall_ns += other.wall_ns;
+  cpu_ns += other.cpu_ns;
+  sent += other.sent;
+  rounds += other.rounds;
+  comm_data += other.comm_data;
+  comm_rounds += other.comm_rounds;
+  return *this;
+}
+
+void Profiler::calibrate()
+{
+  const int n_samples = 1000;
+  long long total = 0;
+  for (int i = 0; i < n_samples; i++)
+    {
+      struct timespec wall, cpu_start, cpu_end;
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+      clock_gettime(CLOCK_MONOTONIC, &wall);
+      clock_gettime(CLOCK_MONOTONIC, &wall);
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+      total += timespec_diff(&cpu_start, &cpu_end);
+    }
+  cpu_overhead = total / n_samples;
+}
+
+void Profiler::set_tape(int tape)
+{
+  if (cpu_overhead < 0)
+    calibrate();
+  if ((int)stats.size() <= tape)
+    stats.resize(tape + 1);
+  if (stats[tape].empty())
+    stats[tape].resize(N_OPCODES);
+  current = &stats[tape];
+}
+
+void Profiler::start(const Processor& Proc)
+{
+  sent_start = Proc.sent;
+  rounds_start = Proc.rounds;
+  Proc.P.get_comm_totals(data_start, comm_rounds_start);
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+  clock_gettime(CLOCK_MONOTONIC, &wall_start);
+}
+
+void Profiler::stop(int opcode, const Processor& Proc)
+{
+  struct timespec wall_end, cpu_end;
+  clock_gettime(CLOCK_MONOTONIC, &wall_end);
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+  if (opcode < 0 or opcode >= N_OPCODES)
+    return;
+  size_t data, comm_rounds;
+  Proc.P.get_comm_totals(data, comm_rounds);
+  OpcodeStats& x = (*current)[opcode];
+  x.count++;
+  x.wall_ns += timespec_diff(&wall_start, &wall_end);
+  x.cpu_ns += max(0LL, timespec_diff(&cpu_start, &cpu_end) - cpu_overhead);
+  x.sent += Proc.sent - sent_start;
+  x.rounds += Proc.rounds - rounds_start;
+  x.comm_data += data - data_start;
+  x.comm_rounds += comm_rounds - comm_rounds_start;
+}
+
+void Profiler::merge(const Profiler& other)
+{
+  if (stats.size() < other.stats.size())
+    stats.resize(other.stats.size());
+  for (size_t tape = 0; tape < other.stats.size(); tape++)
+    {
+      if (other.stats[tape].empty())
+        continue;
+      if (stats[tape].empty())
+        stats[tape].resize(N_OPCODES);
+      for (int opcode = 0; opcode < N_OPCODES; opcode++)
+        stats[tape][opcode] += other.stats[tape][opcode];
+    }
+}
+
+struct ProfileEntry
+{
+  int tape, opcode;
+  const OpcodeStats* stats;
+  bool operator<(const ProfileEntry& other) const
+    { return stats->wall_ns > other.stats->wall_ns; }
+};
+
+static vector<ProfileEntry> sorted_entries(
+    const vector< vector<OpcodeStats> >& stats)
+{
+  vector<ProfileEntry> res;
+  for (size_t tape = 0; tape < stats.size(); tape++)
+    for (size_t opcode = 0; opcode < stats[tape].size(); opcode++)
+      if (stats[tape][opcode].count > 0)
+        res.push_back({(int)tape, (int)opcode, &stats[tape][opcode]});
+  stable_sort(res.begin(), res.end());
+  return res;
+}
+
+static string mnemonic(int opcode)
+{
+  const char* name = opcode_name(opcode);
+  return name ? name : "?";
+}
+
+void Profiler::print(ostream& s) const
+{
+  vector<ProfileEntry> entries = sorted_entries(stats);
+  OpcodeStats total;
+  for (auto& entry : entries)
+    total += *entry.stats;
+
+  s << "Instruction profile (opcodes in hex, sorted by wall time):" << endl;
+  s << setw(6) << "tape" << setw(8) << "opcode" << " " << left << setw(22)
+      << "mnemonic" << right << setw(14) << "count"
+      << setw(12) << "wall (s)" << setw(8) << "wall %" << setw(12) << "cpu (s)"
+      << setw(12) << "sent" << setw(10) << "rounds" << setw(14) << "bytes"
+      << setw(12) << "messages" << endl;
+  for (auto& entry : entries)
+    {
+      const OpcodeStats& x = *entry.stats;
+      s << setw(6) << entry.tape << setw(8) << hex << showbase << entry.opcode
+          << dec << noshowbase << " " << left << setw(22)
+          << mnemonic(entry.opcode) << right << setw(14) << x.count
+          << setw(12) << fixed << setprecision(6) << 1e-9 * x.wall_ns << setw(8)
+          << setprecision(2)
+          << (total.wall_ns ? 100. * x.wall_ns / total.wall_ns : 0.) << setw(12)
+          << setprecision(6) << 1e-9 * x.cpu_ns << setw(12)
+          << x.sent << setw(10) << x.rounds << setw(14) << x.comm_data
+          << setw(12) << x.comm_rounds << endl;
+    }
+  s.unsetf(ios::floatfield);
+  s << "Total: " << total.count << " instructions, "
+      << 1e-9 * total.wall_ns << " s wall, "
+      << 1e-9 * total.cpu_ns << " s CPU, " << total.comm_data
+      << " bytes in " << total.comm_rounds << " messages" << endl;
+}
+
+void Profiler::output_json(ostream& s) const
+{
+  vector<ProfileEntry> entries = sorted_entries(stats);
+  s << "[" << endl;
+  for (size_t i = 0; i < entries.size(); i++)
+    {
+      const OpcodeStats& x = *entries[i].stats;
+      s << "  {\"tape\": " << entries[i].tape << ", \"opcode\": "
+          << entries[i].opcode << ", \"name\": \""
+          << mnemonic(entries[i].opcode) << "\", \"count\": " << x.count
+          << ", \"wall_ns\": " << x.wall_ns << ", \"cpu_ns\": " << x.cpu_ns
+          << ", \"sent\": " << x.sent << ", \"rounds\": " << x.rounds
+          << ", \"bytes\": " << x.comm_data << ", \"messages\": "
+          << x.comm_rounds << "}";
+      if (i + 1 < entries.size())
+        s << ",";
+      s << endl;
+    }
+  s << "]" << endl;
+}
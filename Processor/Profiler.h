@@ -0,0 +1,72 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * Profiler.h
+ *
+ */
+
+#ifndef PROCESSOR_PROFILER_H_
+#define PROCESSOR_PROFILER_H_
+
+#include <time.h>
+#include <vector>
+#include <iostream>
+using namespace std;
+
+class Processor;
+
+/* Cost of one opcode in one tape, summed over all executions */
+
+struct OpcodeStats
+{
+  long long count;
+  long long wall_ns, cpu_ns;
+  // Processor::sent and Processor::rounds
+  long long sent, rounds;
+  // bytes and rounds as accounted by Player::comm_stats
+  long long comm_data, comm_rounds;
+
+  OpcodeStats();
+  OpcodeStats& operator+=(const OpcodeStats& other);
+};
+
+/*
+ * Per-thread instruction profile keyed by (tape, opcode).
+ * Only touched by the thread owning it, merged by the main
+ * thread once all threads have been joined.
+ */
+
+class Profiler
+{
+  // indexed by tape, then by opcode
+  vector< vector<OpcodeStats> > stats;
+  vector<OpcodeStats>* current;
+
+  void calibrate();
+
+  struct timespec wall_start, cpu_start;
+  // cost of reading the clocks as seen by the thread CPU clock
+  long long cpu_overhead;
+  int sent_start, rounds_start;
+  size_t data_start, comm_rounds_start;
+
+public:
+  // opcodes are at most 9 bits wide, see Instruction.h
+  static const int N_OPCODES = 0x200;
+
+  Profiler() : current(0), cpu_overhead(-1), sent_start(0), rounds_start(0),
+      data_start(0), comm_rounds_start(0) {}
+
+  void set_tape(int tape);
+
+  void start(const Processor& Proc);
+  void stop(int opcode, const Processor& Proc);
+
+  void merge(const Profiler& other);
+
+  // Sorted by wall time, most expensive first
+  void print(ostream& s) const;
+  void output_json(ostream& s) const;
+};
+
+#endif /* PROCESSOR_PROFILER_H_ */
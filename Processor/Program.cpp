@@ -4,6 +4,7 @@
 #include "Processor/Program.h"
 #include "Processor/Data_Files.h"
 #include "Processor/Processor.h"
+#include "Processor/Profiler.h"
 
 void Program::compute_constants()
 {
@@ -39,6 +40,9 @@ void Program::parse(istream& s)
       //cerr << "\t" << instr << endl;
       s.peek();
     }
+  decoded.resize(p.size());
+  for (unsigned int i=0; i<p.size(); i++)
+    p[i].decode(decoded[i]);
   compute_constants();
 }
 
@@ -65,6 +69,23 @@ ostream& operator<<(ostream& s,const Program& P)
 
 
 void Program::execute(Processor& Proc) const
+{
+  unsigned int size = p.size();
+  Proc.PC=0;
+  octet seed[SEED_SIZE];
+  memset(seed, 0, SEED_SIZE);
+  Proc.prng.SetSeed(seed);
+  const DecodedInstruction* code = decoded.data();
+  while (Proc.PC<size)
+    { const DecodedInstruction& instr = code[Proc.PC];
+      if (instr.handler)
+        instr.handler(Proc, instr);
+      else
+        p[Proc.PC].execute(Proc);
+    }
+}
+
+void Program::execute_switch(Processor& Proc) const
 {
   unsigned int size = p.size();
   Proc.PC=0;
@@ -75,6 +96,21 @@ void Program::execute(Processor& Proc) const
     { p[Proc.PC].execute(Proc); }
 }
 
+void Program::execute(Processor& Proc, Profiler& profiler) const
+{
+  unsigned int size = p.size();
+  Proc.PC=0;
+  octet seed[SEED_SIZE];
+  memset(seed, 0, SEED_SIZE);
+  Proc.prng.SetSeed(seed);
+  while (Proc.PC<size)
+    { const Instruction& instr = p[Proc.PC];
+      profiler.start(Proc);
+      instr.execute(Proc);
+      profiler.stop(instr.get_opcode(), Proc);
+    }
+}
+
 
 
 
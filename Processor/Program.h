@@ -7,12 +7,15 @@
 #include "Processor/Data_Files.h"
 
 class Machine;
+class Profiler;
 
 /* A program is a vector of instructions */
 
 class Program
 {
   vector<Instruction> p;
+  // Direct handlers for p, see Instruction::decode()
+  vector<DecodedInstruction> decoded;
   // Here we note the number of bits, squares and triples and input
   // data needed
   //  - This is computed for a whole program sequence to enable
@@ -56,6 +59,12 @@ class Program
   // and streams pointing to the triples etc
   void execute(Processor& Proc) const;
 
+  // As above, but only using the switch in Instruction::execute
+  void execute_switch(Processor& Proc) const;
+
+  // As above, recording the cost of each instruction
+  void execute(Processor& Proc, Profiler& profiler) const;
+
 };
 
 #endif
@@ -0,0 +1,72 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * TapeScheduler.cpp
+ *
+ */
+
+#include "Processor/TapeScheduler.h"
+
+void TapeScheduler::set_slots(int n_slots)
+{
+    this->n_slots = n_slots;
+    n_free = n_slots;
+}
+
+long long TapeScheduler::enqueue(int n)
+{
+    if (not is_active())
+        return 0;
+    signal.lock();
+    long long res = next_ticket;
+    next_ticket += n;
+    signal.unlock();
+    return res;
+}
+
+void TapeScheduler::acquire(long long ticket)
+{
+    if (not is_active())
+        return;
+    signal.lock();
+    while (serving != ticket or n_free == 0)
+        signal.wait();
+    serving++;
+    n_free--;
+    // the next ticket might be able to go as well
+    signal.broadcast();
+    signal.unlock();
+}
+
+void TapeScheduler::release()
+{
+    if (not is_active())
+        return;
+    signal.lock();
+    n_free++;
+    signal.broadcast();
+    signal.unlock();
+}
+
+void TapeScheduler::hold()
+{
+    signal.lock();
+    n_slots = 1;
+    n_free = 0;
+    next_ticket = 0;
+    serving = 0;
+    signal.unlock();
+}
+
+void TapeScheduler::finish()
+{
+    if (not is_active())
+        return;
+    signal.lock();
+    n_free++;
+    signal.broadcast();
+    // tapes started but not joined still run in this slot
+    while (serving != next_ticket or n_free < n_slots)
+        signal.wait();
+    signal.unlock();
+}
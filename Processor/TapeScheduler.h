@@ -0,0 +1,54 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * TapeScheduler.h
+ *
+ */
+
+#ifndef PROCESSOR_TAPESCHEDULER_H_
+#define PROCESSOR_TAPESCHEDULER_H_
+
+#include "Tools/Signal.h"
+
+/*
+ * Limits the number of tapes running at once. Every online thread keeps
+ * its own Player, MAC_Check, and Data_Files, but only n_slots of them
+ * execute at any time, and a slot becoming free goes to the tape started
+ * first. All parties start tapes in the same order, so they also run them
+ * in the same order, which avoids waiting for a tape that the other
+ * parties have not scheduled yet.
+ *
+ * Only one tape at a time may take tickets from a queue, otherwise the
+ * order would depend on timing. A tape running alone in its schedule line
+ * uses the machine's queue for the tapes it starts. Every other tape has
+ * its own nested queue with a single slot, its own, which it lends to the
+ * tapes it started while it waits in JOIN_TAPE. Tickets in such a queue
+ * follow the program order of the tape owning it.
+ */
+
+class TapeScheduler
+{
+    Signal signal;
+    int n_slots, n_free;
+    long long next_ticket, serving;
+
+public:
+    TapeScheduler() : n_slots(0), n_free(0), next_ticket(0), serving(0) {}
+
+    // 0 for no limit
+    void set_slots(int n_slots);
+    bool is_active() { return n_slots > 0; }
+
+    // Tickets for the next n tapes to be started, returns the first
+    long long enqueue(int n = 1);
+    // Wait until all earlier tickets run and a slot is free
+    void acquire(long long ticket);
+    void release();
+
+    // Start a nested queue whose slot is held by the calling tape
+    void hold();
+    // Give up the held slot and wait for the tapes left in the queue
+    void finish();
+};
+
+#endif /* PROCESSOR_TAPESCHEDULER_H_ */
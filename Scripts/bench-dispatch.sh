@@ -0,0 +1,21 @@
+#!/bin/bash
+
+# (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+# Compare pre-decoded instruction dispatch with the plain opcode switch
+# on a tight loop of local instructions. Needs setup-online.sh first.
+
+HERE=$(cd `dirname $0`; pwd)
+SPDZROOT=$HERE/..
+
+prog=${1:-bench_dispatch}
+bits=${2:-128}
+
+. $HERE/run-common.sh
+
+$SPDZROOT/compile.py $prog > /dev/null || exit 1
+
+for mode in "" --switch-dispatch; do
+    run_player Player-Online.x $prog -lgp ${bits} $mode || exit 1
+    echo "${mode:-pre-decoded}: $(grep '^Time =' $SPDZROOT/logs/$last_player)"
+done
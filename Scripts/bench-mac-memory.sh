@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+# Peak memory while opened values wait for the MAC check, with and
+# without spilling them to a temporary file. Needs setup-online.sh first.
+# Increase n in the program for longer runs, the peak should stay the same.
+
+HERE=$(cd `dirname $0`; pwd)
+SPDZROOT=$HERE/..
+
+prog=${1:-bench_mac_memory}
+bits=${2:-128}
+
+. $HERE/run-common.sh
+
+$SPDZROOT/compile.py $prog > /dev/null || exit 1
+
+for mode in "" "--check-memory 4" "--check-batch 100000 --check-memory 4"; do
+    run_player Player-Online.x $prog -lgp ${bits} $mode || exit 1
+    echo "${mode:-default}: $(grep '^Time =' $SPDZROOT/logs/$last_player)," \
+	"$(grep '^Maximum resident' $SPDZROOT/logs/$last_player)"
+done
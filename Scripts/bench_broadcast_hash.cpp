@@ -0,0 +1,77 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * Throughput of the hashes available for checking broadcasts,
+ * hashing messages of different sizes as Player does.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include "Networking/BroadcastHash.h"
+#include "Tools/time-func.h"
+#include "Tools/ezOptionParser.h"
+
+using namespace std;
+
+int main(int argc, const char** argv) {
+    ez::ezOptionParser opt;
+    opt.add(
+          "256", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Megabytes to hash per hash and message size (default: 256)", // Help description.
+          "-m", // Flag token.
+          "--megabytes" // Flag token.
+    );
+    opt.add(
+          "16,1024,65536", // Default.
+          0, // Required?
+          -1, // Number of args expected.
+          ',', // Delimiter if expecting multiple args.
+          "Message sizes in bytes (default: 16,1024,65536)", // Help description.
+          "-s", // Flag token.
+          "--sizes" // Flag token.
+    );
+    opt.parse(argc, argv);
+
+    int megabytes;
+    vector<int> sizes;
+    opt.get("--megabytes")->getInt(megabytes);
+    opt.get("--sizes")->getInts(sizes);
+    long long total = (long long) megabytes << 20;
+
+    vector<octet> message;
+    for (auto size : sizes)
+    {
+        if (size <= 0)
+        {
+            cerr << "Message sizes have to be positive" << endl;
+            return 1;
+        }
+        if ((int) message.size() < size)
+            message.resize(size, 0x5a);
+    }
+
+    BroadcastHash::Type types[] = { BroadcastHash::SHA1_HASH,
+            BroadcastHash::BLAKE2B_HASH };
+
+    cout << setw(8) << "hash" << setw(12) << "message" << setw(12) << "MB/s"
+            << endl;
+    for (auto size : sizes)
+        for (auto type : types)
+        {
+            BroadcastHash hash(type);
+            octetStream digest;
+            Timer timer;
+            timer.start();
+            for (long long done = 0; done < total; done += size)
+                hash.update(message.data(), size);
+            hash.final(digest);
+            timer.stop();
+            cout << setw(8) << BroadcastHash::name(type) << setw(12) << size
+                    << setw(12) << fixed << setprecision(1)
+                    << megabytes / timer.elapsed() << endl;
+        }
+}
@@ -8,7 +8,10 @@ run_player() {
     if ! test -e $SPDZROOT/logs; then
         mkdir $SPDZROOT/logs
     fi
-    if test $bin = Player-Online.x; then
+    if test $bin = Player-Online.x -a "$SHM"; then
+	# shared memory instead of TCP, no need for Server.x
+	params="$* -pn $port -h shm://$players"
+    elif test $bin = Player-Online.x; then
 	params="$* -pn $port -h localhost"
     else
 	params="$port localhost $*"
@@ -16,8 +19,10 @@ run_player() {
     if test $bin = Player-KeyGen.x -a ! -e Player-Data/Params-Data; then
 	./Setup.x $players $size 40
     fi
-    >&2 echo Running $SPDZROOT/Server.x $players $port
-    $SPDZROOT/Server.x $players $port &
+    if ! test $bin = Player-Online.x -a "$SHM"; then
+	>&2 echo Running $SPDZROOT/Server.x $players $port
+	$SPDZROOT/Server.x $players $port &
+    fi
     rem=$(($players - 2))
     for i in $(seq 0 $rem); do
       echo "trying with player $i"
@@ -0,0 +1,114 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * Compares the shift-and-add reduction for Mersenne primes with mpz
+ * arithmetic, for modp and the element-wise gfp operations. Also checks
+ * that the reduction is only used when asked for.
+ */
+
+#include <iostream>
+#include <vector>
+#include "Math/Zp_Data.h"
+#include "Math/modp.h"
+#include "Math/gfp.h"
+#include "Tools/random.h"
+
+using namespace std;
+
+static int errors = 0;
+
+void check(bool ok, const string& what, int k)
+{
+    if (not ok)
+    {
+        cerr << "Mismatch for 2^" << k << "-1: " << what << endl;
+        errors++;
+    }
+}
+
+bigint random_below(PRNG& G, const bigint& p)
+{
+    bigint res;
+    G.randomBnd(res, p);
+    return res;
+}
+
+void test_prime(int k, PRNG& G, int n)
+{
+    bigint p = (bigint(1) << k) - 1;
+    Zp_Data ZpD(p, true, true);
+    check(ZpD.get_mersenne() == k, "not detected", k);
+    check(not ZpD.get_montgomery(), "Montgomery representation", k);
+    check(Zp_Data(p).get_mersenne() == 0, "used without asking", k);
+
+    vector<bigint> values = { 0, 1, 2, p - 2, p - 1 };
+    for (int i = 0; i < n; i++)
+        values.push_back(random_below(G, p));
+
+    for (auto& a : values)
+        for (int i = 0; i < 10; i++)
+        {
+            bigint b = i < 5 ? values[i] : random_below(G, p);
+            modp x, y, z;
+            to_modp(x, a, ZpD);
+            to_modp(y, b, ZpD);
+            Mul(z, x, y, ZpD);
+            bigint res;
+            to_bigint(res, z, ZpD);
+            check(res == (a * b) % p, "modp product", k);
+            Sqr(z, x, ZpD);
+            to_bigint(res, z, ZpD);
+            check(res == (a * a) % p, "modp square", k);
+
+            if (k < 64)
+            {
+                mp_limb_t xy = Zp_Data::Mersenne_Mult(a.get_ui(), b.get_ui(), k);
+                check(bigint(xy) == (a * b) % p, "single-limb product", k);
+                // sums of two residues, below 2^(k+1)
+                bigint sum = a + b + (i % 2);
+                mp_limb_t r = Zp_Data::Mersenne_Reduce(sum.get_ui(), k);
+                check(bigint(r) == sum % p, "reduction", k);
+            }
+        }
+
+    gfp::init_field(p, true, true);
+    int m = values.size();
+    vector<gfp> x(m), y(m), sum(m), diff(m), prod(m), scaled(m);
+    for (int i = 0; i < m; i++)
+    {
+        to_gfp(x[i], values[i]);
+        to_gfp(y[i], values[m - 1 - i]);
+    }
+    gfp::add(sum.data(), x.data(), y.data(), m);
+    gfp::sub(diff.data(), x.data(), y.data(), m);
+    gfp::mul(prod.data(), x.data(), y.data(), m);
+    gfp::mul(scaled.data(), x.data(), y[0], m);
+    for (int i = 0; i < m; i++)
+    {
+        bigint a = values[i], b = values[m - 1 - i], res;
+        to_bigint(res, sum[i]);
+        check(res == (a + b) % p, "gfp sum", k);
+        to_bigint(res, diff[i]);
+        check(res == (a - b + p) % p, "gfp difference", k);
+        to_bigint(res, prod[i]);
+        check(res == (a * b) % p, "gfp product", k);
+        to_bigint(res, scaled[i]);
+        check(res == (a * values[m - 1]) % p, "gfp product with scalar", k);
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1000;
+    PRNG G;
+    G.ReSeed();
+    // exponents of Mersenne primes with one or two limbs, not 64 or 128
+    for (int k : { 2, 3, 5, 7, 13, 17, 19, 31, 61, 89, 107, 127 })
+        test_prime(k, G, n);
+    if (errors)
+    {
+        cerr << errors << " mismatches" << endl;
+        return 1;
+    }
+    cout << "Mersenne reduction matches mpz" << endl;
+}
@@ -0,0 +1,72 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * BufferPool.cpp
+ *
+ */
+
+#include "Tools/BufferPool.h"
+
+// octetStreams can outlive the pool of their thread at exit
+static thread_local bool pool_destroyed = false;
+
+BufferPool* BufferPool::local()
+{
+  if (pool_destroyed)
+    return 0;
+  static thread_local BufferPool pool;
+  return &pool;
+}
+
+BufferPool::~BufferPool()
+{
+  for (int i = 0; i <= MAX_BITS; i++)
+    for (auto buffer : free_lists[i])
+      delete[] buffer;
+  pool_destroyed = true;
+}
+
+int BufferPool::size_class(size_t size)
+{
+  if (size > (1UL << MAX_BITS) or size < (1UL << MIN_BITS)
+      or (size & (size - 1)) != 0)
+    return -1;
+  return __builtin_ctzl(size);
+}
+
+size_t BufferPool::capacity(size_t size)
+{
+  if (size == 0 or size > (1UL << MAX_BITS))
+    return size;
+  size_t res = 1UL << MIN_BITS;
+  while (res < size)
+    res <<= 1;
+  return res;
+}
+
+octet* BufferPool::allocate(size_t size)
+{
+  if (size == 0)
+    return 0;
+  int i = size_class(size);
+  BufferPool* pool = local();
+  if (i >= 0 and pool and not pool->free_lists[i].empty())
+    {
+      octet* res = pool->free_lists[i].back();
+      pool->free_lists[i].pop_back();
+      return res;
+    }
+  return new octet[size];
+}
+
+void BufferPool::deallocate(octet* buffer, size_t size)
+{
+  if (buffer == 0)
+    return;
+  int i = size_class(size);
+  BufferPool* pool = local();
+  if (i >= 0 and pool and pool->free_lists[i].size() < MAX_FREE)
+    pool->free_lists[i].push_back(buffer);
+  else
+    delete[] buffer;
+}
@@ -0,0 +1,48 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * BufferPool.h
+ *
+ */
+
+#ifndef TOOLS_BUFFERPOOL_H_
+#define TOOLS_BUFFERPOOL_H_
+
+#include "Networking/data.h"
+
+#include <vector>
+using namespace std;
+
+/*
+ * Memory for octetStream, kept in per-thread free lists of
+ * power-of-two size classes. Temporary octetStreams created in every
+ * round then reuse the buffers of the previous round instead of
+ * calling new and delete. A buffer can be returned on another thread
+ * than the one that allocated it. The lists are capped so that
+ * producer-consumer setups do not hoard memory, and large buffers
+ * bypass the pool.
+ */
+
+class BufferPool
+{
+  static const int MIN_BITS = 6;
+  static const int MAX_BITS = 20;
+  static const size_t MAX_FREE = 8;
+
+  vector<octet*> free_lists[MAX_BITS + 1];
+
+  static BufferPool* local();
+  static int size_class(size_t size);
+
+public:
+  ~BufferPool();
+
+  // Capacity actually allocated for a request of size bytes
+  static size_t capacity(size_t size);
+
+  // size is the capacity as returned by capacity()
+  static octet* allocate(size_t size);
+  static void deallocate(octet* buffer, size_t size);
+};
+
+#endif /* TOOLS_BUFFERPOOL_H_ */
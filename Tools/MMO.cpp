@@ -27,15 +27,22 @@ void MMO::setIV(octet key[AES_BLK_SIZE])
 }
 
 
+const MMO& MMO::fixed_key()
+{
+    static MMO mmo;
+    return mmo;
+}
+
+
 template<int N>
 void MMO::encrypt_and_xor(void* output, const void* input, const octet* key)
 {
     __m128i in[N], out[N];
-    avx_memcpy(in, input, sizeof(in));
+    for (int i = 0; i < N; i++)
+        in[i] = _mm_loadu_si128(((__m128i*)input) + i);
     ecb_aes_128_encrypt<N>(out, in, key);
     for (int i = 0; i < N; i++)
-        out[i] = _mm_xor_si128(out[i], in[i]);
-    avx_memcpy(output, out, sizeof(out));
+        _mm_storeu_si128(((__m128i*)output) + i, _mm_xor_si128(out[i], in[i]));
 }
 
 template<int N>
@@ -50,78 +57,114 @@ void MMO::encrypt_and_xor(void* output, const void* input, const octet* key,
         _mm_storeu_si128(((__m128i*)output) + indices[i], out[i]);
 }
 
-template <>
-void MMO::hashOneBlock<gf2n>(octet* output, octet* input)
+void MMO::encrypt(__m128i* blocks, const int* indices, int n, const octet* key)
 {
-    encrypt_and_xor<1>(output, input, IV);
-}
+    for (; n >= 8; n -= 8, indices += 8)
+        ecb_aes_128_encrypt<8>(blocks, blocks, key, indices);
 
+    // and now my favorite hack
+    switch (n) {
+    case 7:
+        ecb_aes_128_encrypt<7>(blocks, blocks, key, indices);
+        break;
+    case 6:
+        ecb_aes_128_encrypt<6>(blocks, blocks, key, indices);
+        break;
+    case 5:
+        ecb_aes_128_encrypt<5>(blocks, blocks, key, indices);
+        break;
+    case 4:
+        ecb_aes_128_encrypt<4>(blocks, blocks, key, indices);
+        break;
+    case 3:
+        ecb_aes_128_encrypt<3>(blocks, blocks, key, indices);
+        break;
+    case 2:
+        ecb_aes_128_encrypt<2>(blocks, blocks, key, indices);
+        break;
+    case 1:
+        ecb_aes_128_encrypt<1>(blocks, blocks, key, indices);
+        break;
+    default:
+        break;
+    }
+}
 
 template <>
-void MMO::hashOneBlock<gfp>(octet* output, octet* input)
+void MMO::hashBlocks<gf2n>(void* output, const void* input, size_t n) const
 {
-    encrypt_and_xor<1>(output, input, IV);
-    while (mpn_cmp((mp_limb_t*)output, gfp::get_ZpD().get_prA(), gfp::t()) >= 0)
-        encrypt_and_xor<1>(output, output, IV);
+    __m128i* out = (__m128i*)output;
+    const __m128i* in = (const __m128i*)input;
+    size_t i = 0;
+    for (; i + PIPELINE <= n; i += PIPELINE)
+        encrypt_and_xor<PIPELINE>(out + i, in + i, IV);
+    for (; i < n; i++)
+        encrypt_and_xor<1>(out + i, in + i, IV);
 }
 
-template <>
-void MMO::hashBlockWise<gf2n,128>(octet* output, octet* input)
+// same as mpn_cmp(x, prime, t) >= 0 but inlined
+static inline bool not_reduced(const mp_limb_t* x, const mp_limb_t* prime, int t)
 {
-    for (int i = 0; i < 16; i++)
-        encrypt_and_xor<8>(&((__m128i*)output)[i*8], &((__m128i*)input)[i*8], IV);
+    for (int i = t - 1; i >= 0; i--)
+        if (x[i] != prime[i])
+            return x[i] > prime[i];
+    return true;
 }
 
+// Rehash outputs that are not reduced modulo p, without the xor,
+// which keeps the outputs of hashBlockWise() as before
 template <>
-void MMO::hashBlockWise<gfp,128>(octet* output, octet* input)
+void MMO::hashBlocks<gfp>(void* output, const void* input, size_t n) const
 {
-    for (int i = 0; i < 16; i++)
+    hashBlocks<gf2n>(output, input, n);
+    const mp_limb_t* prime = gfp::get_ZpD().get_prA();
+    int t = gfp::t();
+    const int chunk = 128;
+    int indices[chunk];
+    for (size_t start = 0; start < n; start += chunk)
     {
-        __m128i* in = &((__m128i*)input)[i*8];
-        __m128i* out = &((__m128i*)output)[i*8];
-        encrypt_and_xor<8>(out, in, IV);
-        int left = 8;
-        int indices[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+        __m128i* out = (__m128i*)output + start;
+        int left = min(n - start, (size_t)chunk);
+        for (int j = 0; j < left; j++)
+            indices[j] = j;
         while (left)
         {
             int now_left = 0;
             for (int j = 0; j < left; j++)
-                if (mpn_cmp((mp_limb_t*)&out[indices[j]], gfp::get_ZpD().get_prA(), gfp::t()) >= 0)
+                if (not_reduced((mp_limb_t*)&out[indices[j]], prime, t))
                 {
                     indices[now_left] = indices[j];
                     now_left++;
                 }
             left = now_left;
-
-            // and now my favorite hack
-            switch (left) {
-            case 8:
-                ecb_aes_128_encrypt<8>(out, out, IV, indices);
-                break;
-            case 7:
-                ecb_aes_128_encrypt<7>(out, out, IV, indices);
-                break;
-            case 6:
-                ecb_aes_128_encrypt<6>(out, out, IV, indices);
-                break;
-            case 5:
-                ecb_aes_128_encrypt<5>(out, out, IV, indices);
-                break;
-            case 4:
-                ecb_aes_128_encrypt<4>(out, out, IV, indices);
-                break;
-            case 3:
-                ecb_aes_128_encrypt<3>(out, out, IV, indices);
-                break;
-            case 2:
-                ecb_aes_128_encrypt<2>(out, out, IV, indices);
-                break;
-            case 1:
-                ecb_aes_128_encrypt<1>(out, out, IV, indices);
-                break;
-            default:
-                break;
-            }
+            encrypt(out, indices, left, IV);
         }
     }
 }
+
+template <>
+void MMO::hashOneBlock<gf2n>(octet* output, octet* input)
+{
+    encrypt_and_xor<1>(output, input, IV);
+}
+
+
+template <>
+void MMO::hashOneBlock<gfp>(octet* output, octet* input)
+{
+    encrypt_and_xor<1>(output, input, IV);
+    while (mpn_cmp((mp_limb_t*)output, gfp::get_ZpD().get_prA(), gfp::t()) >= 0)
+        encrypt_and_xor<1>(output, output, IV);
+}
+
+template <>
+void MMO::hashBlockWise<gf2n,128>(octet* output, octet* input)
+{
+    hashBlocks<gf2n>(output, input, 128);
+}
+
+template <>
+void MMO::hashBlockWise<gfp,128>(octet* output, octet* input)
+{
+    hashBlocks<gfp>(output, input, 128);
+}
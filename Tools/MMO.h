@@ -15,12 +15,18 @@ class MMO
 {
     octet IV[176]  __attribute__((aligned (16)));
 
+    // blocks encrypted at once to keep the AES units busy
+    static const int PIPELINE = 8;
+
     template<int N>
     static void encrypt_and_xor(void* output, const void* input,
             const octet* key);
     template<int N>
     static void encrypt_and_xor(void* output, const void* input,
             const octet* key, const int* indices);
+    // encrypt the blocks at the given indices in place
+    static void encrypt(__m128i* blocks, const int* indices, int n,
+            const octet* key);
 
 public:
     MMO() { zeroIV(); }
@@ -32,6 +38,13 @@ public:
     void hashBlockWise(octet* output, octet* input);
     template <class T>
     void outputOneBlock(octet* output);
+
+    // Hash any number of consecutive blocks, in place if output == input
+    template <class T>
+    void hashBlocks(void* output, const void* input, size_t n) const;
+
+    // Instance with the zero key, shared by all threads
+    static const MMO& fixed_key();
 };
 
 #endif /* TOOLS_MMO_H_ */
@@ -14,7 +14,7 @@ using namespace std;
 
 OfflineMachineBase::OfflineMachineBase() :
         server(0), my_num(0), nplayers(0), nthreads(0), ntriples(0),
-        nTriplesPerThread(0), output(0)
+        nTriplesPerThread(0), output(0), stream_ahead(0)
 {
 }
 
@@ -71,6 +71,15 @@ void OfflineMachineBase::parse_options(int argc, const char** argv)
         "-o", // Flag token.
         "--output" // Flag token.
     );
+    opt.add(
+        "0", // Default.
+        0, // Required?
+        1, // Number of args expected.
+        0, // Delimiter if expecting multiple args.
+        "Stream output to an online phase running with --stream-prep, "
+        "staying at most this many MB ahead (implies -o, default: 0 for no streaming).", // Help description.
+        "--stream" // Flag token.
+    );
 
     opt.parse(argc, argv);
     if (!opt.isSet("-p"))
@@ -85,7 +94,9 @@ void OfflineMachineBase::parse_options(int argc, const char** argv)
     opt.get("-N")->getInt(nplayers);
     opt.get("-x")->getInt(nthreads);
     opt.get("-n")->getLongLong(ntriples);
-    output = opt.get("-o")->isSet;
+    opt.get("--stream")->getLongLong(stream_ahead);
+    stream_ahead <<= 20;
+    output = opt.get("-o")->isSet or stream_ahead > 0;
 
     nTriplesPerThread =  DIV_CEIL(ntriples, nthreads);
 }
@@ -23,6 +23,8 @@ public:
     int my_num, nplayers, nthreads;
     long long ntriples, nTriplesPerThread;
     bool output;
+    // Bytes to stay ahead of a streaming consumer, 0 if not streaming
+    long long stream_ahead;
 
     OfflineMachineBase();
     ~OfflineMachineBase();
@@ -0,0 +1,411 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * PrepFile.cpp
+ *
+ */
+
+#include "Tools/PrepFile.h"
+#include "Math/gfp.h"
+#include "Math/gf2n.h"
+#include "Exceptions/Exceptions.h"
+
+#include <nmmintrin.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+static const char prep_file_magic[8] = { 'S', 'P', 'D', 'Z', 'p', 'r', 'e', 'p' };
+
+static_assert(sizeof(PrepFileHeader) == PrepFileHeader::SIZE,
+        "preprocessing file header has the wrong size");
+
+static PrepFileHeader make_header(int field_type, int tuple_length,
+        const string& modulus, int flags, uint64_t mac_key_id)
+{
+    PrepFileHeader res;
+    memcpy(res.magic, prep_file_magic, sizeof(res.magic));
+    res.version = PrepFileHeader::VERSION;
+    res.field_type = field_type;
+    res.tuple_length = tuple_length;
+    res.flags = flags;
+    res.mac_key_id = mac_key_id;
+    if (modulus.size() >= sizeof(res.modulus))
+        throw runtime_error("modulus too long for preprocessing file header");
+    strcpy(res.modulus, modulus.c_str());
+    return res;
+}
+
+static string describe_field(const gfp&, int& flags)
+{
+    flags = gfp::get_ZpD().get_montgomery() ? PrepFileHeader::MONTGOMERY : 0;
+    return gfp::pr().get_str();
+}
+
+static string describe_field(const gf2n&, int& flags)
+{
+    flags = 0;
+    return "2^" + to_string(gf2n::degree());
+}
+
+template<class T>
+PrepFileHeader PrepFileHeader::create(int tuple_length, uint64_t mac_key_id)
+{
+    int flags;
+    string modulus = describe_field(T(), flags);
+    return make_header(T::field_type(), tuple_length, modulus, flags,
+            mac_key_id);
+}
+
+template<class T>
+uint64_t PrepFileHeader::get_mac_key_id(const T& mac_key_share)
+{
+    // FNV-1a of the human-readable form, which does not depend on
+    // the representation
+    stringstream ss;
+    ss << mac_key_share;
+    uint64_t res = 14695981039346656037ULL;
+    for (char c : ss.str())
+        res = (res ^ (unsigned char)c) * 1099511628211ULL;
+    return res;
+}
+
+bool PrepFileHeader::verify(const string& filename)
+{
+    ifstream file(filename.c_str(), ios::in | ios::binary);
+    if (file.fail())
+        return false;
+    PrepFileHeader header;
+    if (not header.read(file) or not header.sealed)
+        return false;
+    file.seekg(0, ios::end);
+    header.check_size(file.tellg(), filename);
+    file.seekg(SIZE);
+
+    Crc32c checksum;
+    vector<char> buffer(1 << 20);
+    while (file.read(buffer.data(), buffer.size()) or file.gcount())
+        checksum.update(buffer.data(), file.gcount());
+    if (file.bad())
+        throw file_error(filename);
+    if (checksum.get() != header.checksum)
+        throw runtime_error("Checksum mismatch in " + filename);
+    return true;
+}
+
+PrepFileHeader::PrepFileHeader()
+{
+    memset(this, 0, sizeof(*this));
+}
+
+bool PrepFileHeader::parse(const char* data, size_t size)
+{
+    if (size < (size_t)SIZE or memcmp(data, prep_file_magic, sizeof(magic)))
+        return false;
+    memmove(this, data, SIZE);
+    modulus[sizeof(modulus) - 1] = 0;
+    return true;
+}
+
+bool PrepFileHeader::read(istream& s)
+{
+    s.read((char*)this, SIZE);
+    if (parse((char*)this, s.gcount()))
+        return true;
+    *this = PrepFileHeader();
+    s.clear();
+    s.seekg(0);
+    return false;
+}
+
+bool PrepFileHeader::is_valid() const
+{
+    return memcmp(magic, prep_file_magic, sizeof(magic)) == 0;
+}
+
+bool PrepFileHeader::requires_header() const
+{
+    return is_valid() and field_type == DATA_MODP and not (flags & MONTGOMERY);
+}
+
+void PrepFileHeader::check(const PrepFileHeader& expected,
+        const string& filename) const
+{
+    stringstream ss;
+    if (version != VERSION)
+        ss << "unsupported version " << version;
+    else if (field_type != expected.field_type or strcmp(modulus, expected.modulus))
+        ss << "field " << modulus << " instead of " << expected.modulus;
+    else if (flags != expected.flags)
+        ss << ((flags & MONTGOMERY) ? "" : "no ")
+                << "Montgomery representation, which is "
+                << ((expected.flags & MONTGOMERY) ? "" : "not ") << "used here";
+    else if (tuple_length == 0
+            or (expected.tuple_length and tuple_length != expected.tuple_length))
+        ss << "tuples of " << tuple_length << " bytes instead of "
+                << expected.tuple_length;
+    else if (mac_key_id and expected.mac_key_id
+            and mac_key_id != expected.mac_key_id)
+        ss << "different MAC key";
+    else
+        return;
+    throw runtime_error("Invalid preprocessing data in " + filename + ": " + ss.str());
+}
+
+void PrepFileHeader::check_size(long long file_size, const string& filename) const
+{
+    long long expected_size = SIZE + n_tuples * tuple_length;
+    if (sealed and file_size != expected_size)
+    {
+        stringstream ss;
+        ss << filename << " has " << file_size << " bytes instead of "
+                << expected_size << " for " << n_tuples << " tuples";
+        throw runtime_error(ss.str());
+    }
+}
+
+class Crc32cTable
+{
+public:
+    uint32_t table[256];
+
+    Crc32cTable()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            uint32_t x = i;
+            for (int j = 0; j < 8; j++)
+                x = (x >> 1) ^ (0x82F63B78 & -(x & 1));
+            table[i] = x;
+        }
+    }
+};
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char* data, size_t size)
+{
+    uint64_t res = crc;
+    for (; size >= 8; size -= 8, data += 8)
+        res = _mm_crc32_u64(res, *(uint64_t*)data);
+    for (; size > 0; size--, data++)
+        res = _mm_crc32_u8(res, *data);
+    return res;
+}
+
+void Crc32c::update(const void* data, size_t size)
+{
+    static bool sse42 = __builtin_cpu_supports("sse4.2");
+    const unsigned char* bytes = (const unsigned char*)data;
+    if (sse42)
+    {
+        crc = crc32c_sse42(crc, bytes, size);
+        return;
+    }
+    static Crc32cTable table;
+    for (size_t i = 0; i < size; i++)
+        crc = table.table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+}
+
+PrepFileWriter::PrepFileWriter() :
+        fd(-1), n_submitted(0), n_written(0), write_errno(0), current(0),
+        block_limit(BLOCK_SIZE), thread(), running(false)
+{
+    pthread_mutex_init(&mutex, 0);
+    pthread_cond_init(&cond, 0);
+}
+
+PrepFileWriter::~PrepFileWriter()
+{
+    // also called when unwinding, so no exception
+    try
+    {
+        close();
+    }
+    catch (exception& e)
+    {
+        cerr << e.what() << endl;
+    }
+    delete current;
+    for (auto block : empty)
+        delete block;
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cond);
+}
+
+void PrepFileWriter::open(const string& filename, const PrepFileHeader& header)
+{
+    close();
+    // closing divides by the tuple length
+    if (header.tuple_length == 0)
+        throw runtime_error("Cannot write tuples of length 0 to " + filename);
+    this->filename = filename;
+    this->header = header;
+    this->header.sealed = 0;
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw file_error(filename);
+    // readers of a stream need the header before any data
+    if (pwrite(fd, &this->header, PrepFileHeader::SIZE, 0)
+            != PrepFileHeader::SIZE)
+    {
+        ::close(fd);
+        fd = -1;
+        throw file_error(filename);
+    }
+
+    checksum = Crc32c();
+    n_submitted = n_written = 0;
+    write_errno = 0;
+    block_limit = BLOCK_SIZE;
+    if (current == 0)
+    {
+        // some space for the last element going beyond a block
+        current = new octetStream(BLOCK_SIZE + PrepFileHeader::SIZE);
+        for (int i = 1; i < N_BLOCKS; i++)
+            empty.push_back(new octetStream(BLOCK_SIZE + PrepFileHeader::SIZE));
+    }
+    current->reset_write_head();
+    running = true;
+    pthread_create(&thread, 0, run_thread, this);
+}
+
+void* PrepFileWriter::run_thread(void* writer)
+{
+    ((PrepFileWriter*)writer)->run();
+    return 0;
+}
+
+void PrepFileWriter::run()
+{
+    pthread_mutex_lock(&mutex);
+    while (true)
+    {
+        while (running and full.empty())
+            pthread_cond_wait(&cond, &mutex);
+        if (full.empty())
+            break;
+        octetStream* block = full.front();
+        int error = write_errno;
+        pthread_mutex_unlock(&mutex);
+
+        size_t done = 0, size = block->get_length();
+        if (not error)
+            checksum.update(block->get_data(), size);
+        while (not error and done < size)
+        {
+            ssize_t res = pwrite(fd, block->get_data() + done, size - done,
+                    PrepFileHeader::SIZE + n_written + done);
+            if (res < 0 and errno != EINTR)
+                error = errno;
+            else if (res > 0)
+                done += res;
+        }
+
+        pthread_mutex_lock(&mutex);
+        full.pop_front();
+        n_written += size;
+        write_errno = error;
+        block->reset_write_head();
+        empty.push_back(block);
+        pthread_cond_broadcast(&cond);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void PrepFileWriter::submit(size_t size)
+{
+    pthread_mutex_lock(&mutex);
+    while (empty.empty() and not write_errno)
+        pthread_cond_wait(&cond, &mutex);
+    octetStream* next = 0;
+    if (not write_errno)
+    {
+        next = empty.front();
+        empty.pop_front();
+    }
+    pthread_mutex_unlock(&mutex);
+    check_error();
+
+    // the rest goes to the next block
+    size_t rest = current->get_length() - size;
+    next->append(current->get_data() + size, rest);
+    current->rewind_write_head(rest);
+
+    pthread_mutex_lock(&mutex);
+    full.push_back(current);
+    n_submitted += size;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+
+    current = next;
+    block_limit = BLOCK_SIZE - n_submitted % BLOCK_SIZE;
+}
+
+void PrepFileWriter::check_error()
+{
+    pthread_mutex_lock(&mutex);
+    int error = write_errno;
+    pthread_mutex_unlock(&mutex);
+    if (error)
+        throw file_error(filename + ": " + strerror(error));
+}
+
+void PrepFileWriter::flush()
+{
+    if (not is_open())
+        return;
+    if (current->get_length())
+        submit(current->get_length());
+    pthread_mutex_lock(&mutex);
+    while (n_written < n_submitted and not write_errno)
+        pthread_cond_wait(&cond, &mutex);
+    pthread_mutex_unlock(&mutex);
+    check_error();
+}
+
+void PrepFileWriter::close()
+{
+    if (not is_open())
+        return;
+
+    pthread_mutex_lock(&mutex);
+    bool failed = write_errno;
+    pthread_mutex_unlock(&mutex);
+    if (current->get_length() and not failed)
+        submit(current->get_length());
+    current->reset_write_head();
+
+    // the thread writes everything submitted before stopping
+    pthread_mutex_lock(&mutex);
+    running = false;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, 0);
+
+    int error = write_errno;
+    if (not error and n_written % header.tuple_length != 0)
+        cerr << "Incomplete tuple at the end of " << filename
+                << ", not sealing it" << endl;
+    else if (not error)
+    {
+        header.n_tuples = n_written / header.tuple_length;
+        header.checksum = checksum.get();
+        header.sealed = 1;
+        if (pwrite(fd, &header, PrepFileHeader::SIZE, 0) != PrepFileHeader::SIZE)
+            error = errno;
+    }
+    if (::close(fd) != 0 and not error)
+        error = errno;
+    fd = -1;
+    if (error)
+        throw file_error(filename + ": " + strerror(error));
+}
+
+template PrepFileHeader PrepFileHeader::create<gfp>(int tuple_length, uint64_t mac_key_id);
+template PrepFileHeader PrepFileHeader::create<gf2n>(int tuple_length, uint64_t mac_key_id);
+template uint64_t PrepFileHeader::get_mac_key_id(const gfp& mac_key_share);
+template uint64_t PrepFileHeader::get_mac_key_id(const gf2n& mac_key_share);
@@ -0,0 +1,141 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * PrepFile.h
+ *
+ */
+
+#ifndef TOOLS_PREPFILE_H_
+#define TOOLS_PREPFILE_H_
+
+#include "Tools/octetStream.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <deque>
+using namespace std;
+
+/*
+ * Container for preprocessing data: a header of SIZE bytes followed by
+ * the tuples in the binary format of output(s, false). The header
+ * identifies the field and the MAC key share, and the producer seals it
+ * when closing by filling in the number of tuples and a CRC32C checksum
+ * of the data. Files without the header are still read as before.
+ */
+struct PrepFileHeader
+{
+    static const int SIZE = 4096;
+    static const int VERSION = 1;
+
+    // flags
+    static const int MONTGOMERY = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t field_type;
+    uint32_t tuple_length;
+    uint32_t flags;
+    // zero if the data has no MACs or the key is unknown
+    uint64_t mac_key_id;
+    uint64_t n_tuples;
+    uint32_t checksum;
+    uint32_t sealed;
+    char modulus[SIZE - 48];
+
+    // Description of the field of T, tuple_length zero for any
+    template<class T>
+    static PrepFileHeader create(int tuple_length, uint64_t mac_key_id = 0);
+    template<class T>
+    static uint64_t get_mac_key_id(const T& mac_key_share);
+
+    // Throws if a sealed file does not match its checksum,
+    // false if the file is missing, has no header, or is not sealed
+    static bool verify(const string& filename);
+
+    PrepFileHeader();
+
+    // False if there is no header at the beginning of data
+    bool parse(const char* data, size_t size);
+    // Read from the beginning of a file, which is left at
+    // the start of the data, also if there is no header
+    bool read(istream& s);
+    bool is_valid() const;
+    // Whether data of this kind has always come with a header, which holds
+    // for plain gfp modulo a Mersenne prime: older data is in Montgomery form
+    bool requires_header() const;
+
+    // Throws if the data does not fit the expectations
+    void check(const PrepFileHeader& expected, const string& filename) const;
+    // Throws if a sealed file has been truncated or extended
+    void check_size(long long file_size, const string& filename) const;
+};
+
+class Crc32c
+{
+    uint32_t crc;
+
+public:
+    Crc32c() : crc(~0u) {}
+    void update(const void* data, size_t size);
+    uint32_t get() const { return ~crc; }
+};
+
+/*
+ * Writes a container through a background thread. The data is collected
+ * in blocks of BLOCK_SIZE bytes, which start at aligned positions in the
+ * file unless flush() is used in between.
+ */
+class PrepFileWriter
+{
+    static const size_t BLOCK_SIZE = 1 << 20;
+    static const int N_BLOCKS = 4;
+
+    string filename;
+    int fd;
+    PrepFileHeader header;
+    Crc32c checksum;
+
+    // data bytes handed to the thread and written by it
+    long long n_submitted, n_written;
+    int write_errno;
+
+    octetStream* current;
+    size_t block_limit;
+    deque<octetStream*> full, empty;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool running;
+
+    // prevent copying
+    PrepFileWriter(const PrepFileWriter& other);
+
+    static void* run_thread(void* writer);
+    void run();
+    void submit(size_t size);
+    void check_error();
+
+public:
+    PrepFileWriter();
+    ~PrepFileWriter();
+
+    void open(const string& filename, const PrepFileHeader& header);
+    bool is_open() { return fd >= 0; }
+
+    template<class T>
+    void write(const T& x)
+    {
+        x.pack(*current);
+        if (current->get_length() >= block_limit)
+            submit(block_limit);
+    }
+
+    // Wait until everything so far is in the file
+    void flush();
+    // Flush and seal the header
+    void close();
+};
+
+#endif /* TOOLS_PREPFILE_H_ */
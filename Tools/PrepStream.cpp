@@ -0,0 +1,146 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * PrepStream.cpp
+ *
+ */
+
+#include "Tools/PrepStream.h"
+#include "Exceptions/Exceptions.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+string prep_consumed_filename(const string& filename)
+{
+    return filename + ".consumed";
+}
+
+string prep_done_filename(const string& filename)
+{
+    return filename + ".done";
+}
+
+bool prep_stream_done(const string& filename)
+{
+    return access(prep_done_filename(filename).c_str(), F_OK) == 0;
+}
+
+static long long file_size(const string& filename)
+{
+    struct stat s;
+    if (stat(filename.c_str(), &s) != 0)
+        return -1;
+    return s.st_size;
+}
+
+void PrepStreamCounter::open(const string& filename)
+{
+    close();
+    string name = prep_consumed_filename(filename);
+    int fd = ::open(name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        throw file_error(name);
+    struct stat s;
+    if (fstat(fd, &s) != 0
+            or (s.st_size < (off_t)sizeof(*counter)
+                    and ftruncate(fd, sizeof(*counter)) != 0))
+    {
+        ::close(fd);
+        throw file_error(name);
+    }
+    void* res = mmap(0, sizeof(*counter), PROT_READ | PROT_WRITE, MAP_SHARED,
+            fd, 0);
+    ::close(fd);
+    if (res == MAP_FAILED)
+        throw file_error(name);
+    counter = (long long*)res;
+}
+
+void PrepStreamCounter::close()
+{
+    if (counter)
+        munmap(counter, sizeof(*counter));
+    counter = 0;
+}
+
+long long PrepStreamCounter::get()
+{
+    return __atomic_load_n(counter, __ATOMIC_ACQUIRE);
+}
+
+void PrepStreamCounter::publish(long long pos)
+{
+    long long current = get();
+    while (current < pos
+            and not __atomic_compare_exchange_n(counter, &current, pos, false,
+                    __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+        ;
+}
+
+void PrepStreamCounter::reset()
+{
+    __atomic_store_n(counter, 0, __ATOMIC_RELEASE);
+}
+
+bool PrepStreamCounter::wait_for_size(const string& filename, long long size)
+{
+    int sleep_us = 100;
+    long long waited_us = 0;
+    while (file_size(filename) < size)
+    {
+        // check again after seeing the marker, the producer closes first
+        if (prep_stream_done(filename))
+            return file_size(filename) >= size;
+        // the producer resets the counter when starting
+        publish(size);
+        if (waited_us < 1000000 and waited_us + sleep_us >= 1000000)
+            cerr << "Waiting for " << filename << " to reach " << size
+                    << " bytes" << endl;
+        usleep(sleep_us);
+        waited_us += sleep_us;
+        sleep_us = min(2 * sleep_us, 10000);
+    }
+    return true;
+}
+
+void PrepStreamWriter::open(const string& filename, long long max_ahead)
+{
+    this->filename = filename;
+    this->max_ahead = max_ahead;
+    unlink(prep_done_filename(filename).c_str());
+    // offsets recorded by earlier consumers refer to the old content
+    unlink((filename + ".offset").c_str());
+    consumed.open(filename);
+    consumed.reset();
+    cerr << "Streaming to " << filename << " at most " << max_ahead
+            << " bytes ahead" << endl;
+}
+
+void PrepStreamWriter::wait(const volatile bool* stop)
+{
+    int sleep_us = 100;
+    while (file_size(filename) - consumed.get() > max_ahead
+            and not (stop and *stop))
+    {
+        usleep(sleep_us);
+        sleep_us = min(2 * sleep_us, 10000);
+    }
+}
+
+void PrepStreamWriter::finish()
+{
+    if (not is_open())
+        return;
+    consumed.close();
+    ofstream done(prep_done_filename(filename).c_str());
+    // also called from the destructor, so no exception
+    if (done.fail())
+        cerr << "Cannot mark end of stream in "
+                << prep_done_filename(filename) << endl;
+}
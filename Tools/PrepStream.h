@@ -0,0 +1,71 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * PrepStream.h
+ *
+ */
+
+#ifndef TOOLS_PREPSTREAM_H_
+#define TOOLS_PREPSTREAM_H_
+
+#include <string>
+using namespace std;
+
+/*
+ * Streaming of preprocessing data from an offline producer to an online
+ * phase running at the same time. The producer appends to the usual data
+ * file, and the consumer waits for the file to grow instead of failing
+ * at the end. Next to the data file, <file>.consumed holds the highest
+ * byte position any consumer has asked for, which lets the producer stay
+ * at most a given number of bytes ahead, and <file>.done marks that the
+ * producer has finished.
+ */
+
+string prep_consumed_filename(const string& filename);
+string prep_done_filename(const string& filename);
+bool prep_stream_done(const string& filename);
+
+// Shared counter in <file>.consumed, only ever increased by consumers
+class PrepStreamCounter
+{
+    long long* counter;
+
+public:
+    PrepStreamCounter() : counter(0) {}
+    ~PrepStreamCounter() { close(); }
+
+    void open(const string& filename);
+    void close();
+    bool is_open() { return counter != 0; }
+
+    long long get();
+    void publish(long long pos);
+    void reset();
+
+    // Wait until the file is at least size bytes long,
+    // false if the producer finished before that
+    bool wait_for_size(const string& filename, long long size);
+};
+
+class PrepStreamWriter
+{
+    string filename;
+    long long max_ahead;
+    PrepStreamCounter consumed;
+
+public:
+    PrepStreamWriter() : max_ahead(0) {}
+    ~PrepStreamWriter() { finish(); }
+
+    // Call after the data file has been opened for writing
+    void open(const string& filename, long long max_ahead);
+    bool is_open() { return consumed.is_open(); }
+
+    // Block while the file is more than max_ahead bytes
+    // ahead of the consumers or until *stop is set,
+    // data has to be flushed before
+    void wait(const volatile bool* stop = 0);
+    void finish();
+};
+
+#endif /* TOOLS_PREPSTREAM_H_ */
@@ -16,20 +16,18 @@
 
 void octetStream::clear()
 {
-    if (data)
-        delete[] data;
+    BufferPool::deallocate(data, mxlen);
     data = 0;
     len = mxlen = ptr = 0;
 }
 
 void octetStream::assign(const octetStream& os)
 {
-  if (os.len>=mxlen)
+  if (os.len>mxlen)
     {
-      if (data)
-        delete[] data;
-      mxlen=os.mxlen;  
-      data=new octet[mxlen];
+      BufferPool::deallocate(data, mxlen);
+      mxlen=BufferPool::capacity(os.len);
+      data=BufferPool::allocate(mxlen);
     }
   len=os.len;
   memcpy(data,os.data,len*sizeof(octet));
@@ -49,16 +47,16 @@ void octetStream::swap(octetStream& os)
 
 octetStream::octetStream(size_t maxlen)
 {
-  mxlen=maxlen; len=0; ptr=0;
-  data=new octet[mxlen];
+  mxlen=BufferPool::capacity(maxlen); len=0; ptr=0;
+  data=BufferPool::allocate(mxlen);
 }
 
 
 octetStream::octetStream(const octetStream& os)
 {
-  mxlen=os.mxlen;
+  mxlen=BufferPool::capacity(os.len);
   len=os.len;
-  data=new octet[mxlen];
+  data=BufferPool::allocate(mxlen);
   memcpy(data,os.data,len*sizeof(octet));
   ptr=os.ptr;
 }
@@ -22,6 +22,7 @@
 #include "Networking/data.h"
 #include "Networking/sockets.h"
 #include "Tools/avx_memcpy.h"
+#include "Tools/BufferPool.h"
 
 #include <string.h>
 #include <vector>
@@ -43,6 +44,8 @@ class octetStream
 
   void resize(size_t l);
   void resize_precise(size_t l);
+  // Make room for l more bytes
+  void reserve(size_t l) { resize(len + l); }
   void clear();
 
   void assign(const octetStream& os);
@@ -55,7 +58,7 @@ class octetStream
     { if (this!=&os) { assign(os); }
       return *this;
     }
-  ~octetStream() { if(data) delete[] data; }
+  ~octetStream() { BufferPool::deallocate(data, mxlen); }
   
   size_t get_ptr() const     { return ptr; }
   size_t get_length() const  { return len; }
@@ -123,6 +126,13 @@ class octetStream
   void store(const vector<int>& v);
   void get(vector<int>& v);
 
+  // Pack or unpack field elements in bulk, with a single copy if
+  // the in-memory layout is the same as the packed format
+  template <class T>
+  void pack(const vector<T>& values);
+  template <class T>
+  void unpack(vector<T>& values);
+
   void consume(octetStream& s,size_t l)
     { s.resize(l);
       consume(s.data,l);
@@ -154,6 +164,9 @@ class octetStream
 
   friend ostream& operator<<(ostream& s,const octetStream& o);
   friend class PRNG;
+  friend class EventLoop;
+  friend class ShmPlayer;
+  friend class ChannelMux;
 };
 
 
@@ -167,14 +180,15 @@ inline void octetStream::resize(size_t l)
 
 inline void octetStream::resize_precise(size_t l)
 {
+  l = BufferPool::capacity(l);
   if (l == mxlen)
     return;
 
-  octet* nd=new octet[l];
+  octet* nd=BufferPool::allocate(l);
   if (data)
     {
       memcpy(nd, data, min(len, l) * sizeof(octet));
-      delete[] data;
+      BufferPool::deallocate(data, mxlen);
     }
   data=nd;
   mxlen=l;
@@ -204,8 +218,9 @@ inline void octetStream::consume(octet* x,const size_t l)
 
 inline void octetStream::Send(int socket_num) const
 {
-  send(socket_num,len,LENGTH_SIZE);
-  send(socket_num,data,len);
+  octet blen[LENGTH_SIZE];
+  encode_length(blen,len,LENGTH_SIZE);
+  send(socket_num,blen,LENGTH_SIZE,data,len);
 }
 
 
@@ -214,7 +229,9 @@ inline void octetStream::Receive(int socket_num)
   size_t nlen=0;
   receive(socket_num,nlen,LENGTH_SIZE);
   len=0;
-  resize_precise(nlen);
+  // keep the buffer if large enough
+  if (nlen > mxlen)
+    resize_precise(nlen);
   len=nlen;
 
   receive(socket_num,data,len);
@@ -238,5 +255,35 @@ inline void octetStream::ReceiveExpected(int socket_num, size_t expected)
   receive(socket_num,data,len);
 }
 
+template <class T>
+inline void octetStream::pack(const vector<T>& values)
+{
+  size_t size = T::size();
+  reserve(values.size() * size);
+  if (sizeof(T) == size)
+    {
+      avx_memcpy(data + len, values.data(), values.size() * size);
+      len += values.size() * size;
+    }
+  else
+    for (auto& value : values)
+      value.pack(*this);
+}
+
+template <class T>
+inline void octetStream::unpack(vector<T>& values)
+{
+  size_t size = T::size();
+  if (sizeof(T) == size)
+    {
+      avx_memcpy(values.data(), consume(values.size() * size),
+          values.size() * size);
+    }
+  else
+    for (auto& value : values)
+      value.unpack(*this);
+}
+
+
 #endif
 
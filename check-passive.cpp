@@ -3,6 +3,7 @@
 #include "Math/gf2n.h"
 #include "Math/gfp.h"
 #include "Math/Setup.h"
+#include "Tools/PrepFile.h"
 
 #include <fstream>
 #include <vector>
@@ -18,6 +19,8 @@ void check_triples(int n_players)
         ss << get_prep_dir(n_players, 128, 128) << "Triples-" << T::type_char() << "-P" << i;
         inputFiles[i].open(ss.str().c_str());
         cout << "Opening file " << ss.str() << endl;
+        PrepFileHeader header;
+        header.read(inputFiles[i]);
     }
 
     int j = 0;
@@ -0,0 +1,97 @@
+// (C) 2018 University of Bristol, Bar-Ilan University. See License.txt
+
+/*
+ * connection-broker.cpp
+ *
+ * Long-running process that connects to the other players once and
+ * lends the connections to Player-Online.x --broker, one job at a time.
+ */
+
+#include "Networking/ConnectionBroker.h"
+#include "Tools/ezOptionParser.h"
+
+#include <iostream>
+#include <string>
+using namespace std;
+
+int main(int argc, const char** argv)
+{
+    ez::ezOptionParser opt;
+
+    opt.syntax = "./connection-broker.x [OPTIONS] <playernum>\n";
+    opt.example = "./connection-broker.x -pn 13000 -h localhost 1\n";
+
+    opt.add(
+          "5000", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Port number base to attempt to start connections from (default: 5000)", // Help description.
+          "-pn", // Flag token.
+          "--portnumbase" // Flag token.
+    );
+    opt.add(
+          "localhost", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Host where Server.x is running to coordinate startup (default: localhost). "
+          "Ignored if --ip-file-name is used.", // Help description.
+          "-h", // Flag token.
+          "--hostname" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Filename containing list of party ip addresses. Alternative to --hostname and running Server.x for startup coordination.", // Help description.
+          "-ip", // Flag token.
+          "--ip-file-name" // Flag token.
+    );
+    opt.add(
+          "", // Default.
+          0, // Required?
+          1, // Number of args expected.
+          0, // Delimiter if expecting multiple args.
+          "Unix domain socket for jobs (default: /tmp/spdz-broker-<port number base>-<playernum>)", // Help description.
+          "-s", // Flag token.
+          "--socket" // Flag token.
+    );
+    opt.parse(argc, argv);
+
+    vector<string*> allArgs(opt.firstArgs);
+    allArgs.insert(allArgs.end(), opt.lastArgs.begin(), opt.lastArgs.end());
+    if (allArgs.size() != 2)
+    {
+        cerr << "ERROR: incorrect number of arguments to connection-broker.x\n";
+        string usage;
+        opt.getUsage(usage);
+        cout << usage;
+        return 1;
+    }
+
+    int playerno = atoi(allArgs[1]->c_str());
+    int pnbase;
+    string hostname, ipFileName, path;
+    opt.get("--portnumbase")->getInt(pnbase);
+    opt.get("--hostname")->getString(hostname);
+    opt.get("--ip-file-name")->getString(ipFileName);
+    opt.get("--socket")->getString(path);
+    if (path.empty())
+        path = ConnectionBroker::default_path(pnbase, playerno);
+
+    Names playerNames;
+    if (ipFileName.size() > 0)
+        playerNames.init(playerno, pnbase, ipFileName);
+    else
+        playerNames.init(playerno, pnbase, Names::DEFAULT_PORT, hostname.c_str());
+    if (playerNames.is_shared_memory())
+    {
+        cerr << "connection-broker.x does not support shared memory" << endl;
+        return 1;
+    }
+
+    ConnectionBroker().serve(path, playerNames);
+    return 1;
+}
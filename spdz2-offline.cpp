@@ -17,6 +17,7 @@ using namespace std;
 #include "FHE/NTL-Subs.h"
 #include "Tools/ezOptionParser.h"
 #include "Tools/mkpath.h"
+#include "Tools/PrepStream.h"
 #include "Math/Setup.h"
 
 class Spdz2
@@ -28,9 +29,10 @@ public:
     bool stop_requested;
     DataSetup setup;
     int prime_length, gf2n_length;
+    long long stream_ahead;
 
     Spdz2() : sec(40), covert(2), stop_requested(false),
-            prime_length(128), gf2n_length(40) {}
+            prime_length(128), gf2n_length(40), stream_ahead(0) {}
 
     void stop()
     {
@@ -71,6 +73,10 @@ public:
         Timer timer;
         timer.start();
         vector<octetStream> os(P.num_players());
+        // inputs go to one file per player, so they are not streamed
+        PrepStreamWriter stream;
+        if (spdz2.stream_ahead and data_type != "inputs")
+            stream.open(producer.output_filename(P.my_num()), spdz2.stream_ahead);
         while (true)
         {
             bool stop = false;
@@ -90,8 +96,15 @@ public:
             cout << "Produced " << total << " " << FD::T::type_string() << " "
                     << data_type << ", " << total / timer.elapsed()
                     << " per second" << endl;
+            if (stream.is_open())
+            {
+                // the consumer might use the output straight away
+                MC.Check(P);
+                stream.wait(&spdz2.stop_requested);
+            }
         }
         MC.Check(P);
+        stream.finish();
         cout << "Finished producing " << FD::T::type_string() << " " << data_type << endl;
         return 0;
     }
@@ -236,6 +249,15 @@ int main(int argc, const char** argv)
             "-c", // Flag token.
             "--covert" // Flag token.
     );
+    opt.add(
+            "0", // Default.
+            0, // Required?
+            1, // Number of args expected.
+            0, // Delimiter if expecting multiple args.
+            "Stream output to an online phase running with --stream-prep, "
+            "staying at most this many MB ahead (default: 0 for no streaming)", // Help description.
+            "--stream" // Flag token.
+    );
     opt.parse(argc, argv);
     if (!opt.isSet("-p"))
     {
@@ -255,6 +277,8 @@ int main(int argc, const char** argv)
     opt.get("-pn")->getInt(portnum_base);
     opt.get("-h")->getString(hostname);
     opt.get("-c")->getInt(spdz2.covert);
+    opt.get("--stream")->getLongLong(spdz2.stream_ahead);
+    spdz2.stream_ahead <<= 20;
 
     if(mkdir_p(PREP_DIR) == -1)
     {